@@ -7,17 +7,60 @@
  *      SPI EEPROM (e.g. 25LC1024 has 24 bit address and 256 byte page).
  *      Use < for redirecting or | for piping from another command. 
  *      (e.g. Elf Membership Card parallel port).
+ *      The next page is prepared while the EEPROM is busy with the write
+ *      cycle of the current page: a file is mapped to memory, a pipe is
+ *      read ahead by a reader thread.
+ *      Several EEPROMs on the SPI0 chip selects are written in one run: 
+ *      each page is sent to the next chip while the others are busy with
+ *      their write cycle, the status registers are polled round-robin.
+ *      A SPI NOR flash (W25Qxx) is detected by the JEDEC ID. The 4 KiB 
+ *      sectors and 64 KiB blocks of the range are erased ahead of the 
+ *      page program, the bytes of the first and last sector outside the 
+ *      range are kept.
+ *      With -M the start, length and CRC32 of the range are recorded in 
+ *      the manifest in the last 128 bytes (see manifest.h), the data ends 
+ *      below the manifest (the last sector of a flash). The entries of 
+ *      an overwritten range are always removed. The check mode reads 
+ *      only the manifest to find out if the image is already programmed.
  * 
  *      http://spyr.ch/twiki/bin/view/Cosmac/MassStorage
  *
  *      synopsis
- *       $ bbin2eeprom [-s hexadr] [-k size] [-e hexadr] [-p page_size] [-a address_bits] [file] 
+ *       $ bbin2eeprom [-s hexadr] [-k size] [-e hexadr] [-p page_size] [-a address_bits] 
+ *                     [-b] [-c] [-x] [-l hexadr] [-g hexadr] [-d slot] [-L] [-I]
+ *                     [-j journal] [-C channels] [-m] [-M] [file] 
  *      The file is read from stdin in or <filename>.
  *      -s start address in hex (0 is default) 
- *      -e end adress in hex (0x1FFFF is default) 
+ *      -e end adress in hex (end of the EEPROM is default, with -M the 
+ *         end below the manifest) 
  *      -p <number>  page size in bytes (256 is default) 
  *      -a <number>  address bits (8, 16, or 24; 24 is default) 
- *      -k <number>  size in Kbits (1024 is default) 
+ *      -k <number>  size in Kbits (1024 is default), the size of a flash 
+ *         is read from the JEDEC ID
+ *      -b boot image, writes the header with entry point and segments
+ *         for the boot loader (see boot_image.h)
+ *      -c boot image with compressed segments
+ *      -x the file is an Intel HEX file, each address range is a segment
+ *      -l load address in hex for a binary file (0x8000 is default)
+ *      -g entry point in hex (load address of the first segment is default)
+ *      -d <number>  boot directory slot 0..15 for the boot image (0 is 
+ *         default), the data switches select the slot at boot. Only the 
+ *         pages of the slot and its directory entry are written.
+ *      -L list the boot directory
+ *      -I initialise the boot directory, all slots are empty (erased). 
+ *         Invalid entries (e.g. the data of a plain image) are ignored 
+ *         by -L and -d.
+ *      -j <file>  page journal, an interrupted run with the same file and
+ *         range continues after the last written page (verified by read 
+ *         back). The journal is removed when all pages are written.
+ *      -C <list>  SPI0 chip selects, comma separated (1 is default, 0,1 
+ *         writes both EEPROMs)
+ *      -m check the manifest, exit status 0 the file (or boot image of 
+ *         the slot) is already programmed, 1 it differs. Nothing is 
+ *         written.
+ *      -M record the range in the manifest, the end of the EEPROM (the 
+ *         last sector of a flash) is reserved. A file that does not fit 
+ *         below the manifest is an error.
  *  @file
  *      bin2eeprom.c
  *  @author
@@ -49,20 +92,66 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef SPI_SIM
+#include "spi_sim.h"
+#else
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
+#endif
 #include "eeprom.h"
+#include "eeprom_io.h"
+#include "boot_image.h"
+#include "manifest.h"
 
 #define START_ADR (0x00000)
 #define END_ADR   (0x1FFFF)
+// SPI0 CE0 and CE1
+#define MAX_CHANNELS (2)
 
 // function prototypes
-int write_page(uint32_t start, uint16_t count);
+uint16_t page_count(uint32_t adr);
+eeprom_page_t *memory_page(eeprom_page_t *page, uint32_t adr);
+void *pipe_reader(void *arg);
+void list_dir(const boot_slot_t *slot);
+void init_dir(void);
+uint64_t fnv1a(const uint8_t *data, uint32_t len);
+int64_t journal_resume(const char *file, uint64_t hash);
+FILE *journal_start(const char *file, uint64_t hash, uint8_t resume);
+int parse_channels(char *list);
+int write_page_all(eeprom_page_t *page);
+void write_cycle_wait_all(void);
+uint32_t flash_erase(uint32_t adr, uint32_t begin, uint32_t end, 
+                     uint8_t blocks);
+void manifest_read_all(void);
+void manifest_write_all(void);
+int manifest_check(uint32_t start, uint32_t len, uint32_t crc);
 
 // global variables
 static FILE *fp;
-static uint8_t end_of_file = FALSE;
+static uint32_t start_adr = START_ADR;
+static uint32_t end_adr = 0;
+// page source: mapped file or boot image, NULL the reader thread reads
+// the pipe
+static const uint8_t *source = NULL;
+static uint32_t source_len;
+static page_queue_t queue;
+// chip selects written in parallel
+static int channel[MAX_CHANNELS] = {CHANNEL};
+static int channels = 1;
+// SPI NOR flash instead of the EEPROM
+static uint8_t flash = FALSE;
+static uint32_t eeprom_size;
+static uint32_t erased_sectors = 0;
+static uint32_t erased_blocks = 0;
+// manifest of the ranges written, with -M the data ends below 
+// manifest_limit
+static uint8_t manifest[MAX_CHANNELS][MANIFEST_SIZE];
+static uint32_t manifest_limit;
 
 uint16_t page_size = PAGE_SIZE;   
 uint8_t address_bits = ADDRESS_BITS;
@@ -70,18 +159,56 @@ uint8_t address_bits = ADDRESS_BITS;
 
 int main(int argc, char *argv[]) {
     int opt;
-    uint32_t start_adr = START_ADR;
-    uint32_t end_adr = 0;
-    int eeprom_fd;
+    int i;
+    int spi_fd[MAX_CHANNELS];
     uint32_t written_bytes = 0;
-    uint32_t start_remainder;
-    uint32_t end_remainder;
-    uint32_t pages;
-    uint32_t page;
+    eeprom_page_t *page;
+    eeprom_page_t entry_page;
+    uint8_t entry_buf[HEADER_SIZE + DIR_SIZE];
+    pthread_t reader;
+    struct stat st;
+    uint32_t adr;
+    unsigned long n;
     uint16_t size = 0;
+    uint8_t boot_mode = FALSE;
+    uint8_t compress_mode = FALSE;
+    uint8_t hex_mode = FALSE;
+    uint16_t load_adr = BOOT_ADR;
+    int32_t entry = -1;
+    int slot_number = 0;
+    uint8_t list_mode = FALSE;
+    uint8_t init_mode = FALSE;
+    int invalid;
+    uint8_t dir[DIR_SIZE];
+    uint8_t other_dir[DIR_SIZE];
+    boot_slot_t slot[DIR_SLOTS];
+    uint32_t image_len = 0;
+    int32_t offset;
+    const char *name = "stdin";
+    const char *journal_file = NULL;
+    FILE *journal = NULL;
+    uint64_t hash = 0;
+    int64_t last_page = -1;
+    int64_t journal_adr = -1;
+    uint8_t verify[PAGE_SIZE];
+    uint32_t pos;
+    uint16_t count;
+    uint8_t verified;
+    uint32_t flash_size;
+    uint8_t id[3];
+    uint32_t erased = 0;
+    uint32_t erase_begin = 0;
+    uint32_t erase_end = 0;
+    uint8_t check_mode = FALSE;
+    uint8_t manifest_mode = FALSE;
+    uint8_t end_default;
+    uint32_t crc = 0;
+    uint32_t data_len = 0;
+    uint32_t data_end;
+    manifest_entry_t manifest_entry;
   
     // parse command line options
-    while ((opt = getopt(argc, argv, "s:e:p:a:k:")) != -1) {
+    while ((opt = getopt(argc, argv, "s:e:p:a:k:bcxl:g:d:LIj:C:mM")) != -1) {
         switch (opt) {
             case 's': 
                 start_adr = strtol(optarg, NULL, 16);
@@ -98,9 +225,50 @@ int main(int argc, char *argv[]) {
             case 'k': 
                 size = strtol(optarg, NULL, 10);
                 break;
+            case 'b':
+                boot_mode = TRUE;
+                break;
+            case 'c':
+                boot_mode = TRUE;
+                compress_mode = TRUE;
+                break;
+            case 'x':
+                hex_mode = TRUE;
+                break;
+            case 'l': 
+                load_adr = strtol(optarg, NULL, 16);
+                break;
+            case 'g': 
+                entry = strtol(optarg, NULL, 16);
+                break;
+            case 'd': 
+                boot_mode = TRUE;
+                slot_number = strtol(optarg, NULL, 10);
+                break;
+            case 'L':
+                list_mode = TRUE;
+                break;
+            case 'I':
+                init_mode = TRUE;
+                break;
+            case 'j':
+                journal_file = optarg;
+                break;
+            case 'C':
+                if (parse_channels(optarg) < 0) {
+                    fprintf(stderr, "Invalid chip selects, choose 0 and/or 1.\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'm':
+                check_mode = TRUE;
+                break;
+            case 'M':
+                manifest_mode = TRUE;
+                break;
             default:
                 fprintf(stderr, 
-                  "Usage: %s [-s <adr>] [-e <adr>] [-p <page_size>] [-a <address_bits>] [-k <size>] [<filename>]\n", 
+                  "Usage: %s [-s <adr>] [-e <adr>] [-p <page_size>] [-a <address_bits>] [-k <size>] [-b] [-c] [-x] [-l <adr>] [-g <adr>] [-d <slot>] [-L] [-I] [-j <journal>] [-C <channels>] [-m] [-M] [<filename>]\n", 
                   argv[0]);
                 exit(EXIT_FAILURE);
         }
@@ -164,9 +332,7 @@ int main(int argc, char *argv[]) {
        exit(EXIT_FAILURE);      
     }
 
-    if (end_adr == 0) {
-      end_adr = size * 1024 / 8 - 1;
-    }
+    eeprom_size = size * 1024 / 8;
 
     if (!(address_bits == 8 | address_bits == 16 | address_bits == 24)) { 
        // invalid number of address bits 
@@ -179,6 +345,92 @@ int main(int argc, char *argv[]) {
        fprintf(stderr, "Invalid page size, valid page sizes: 16, 32,64, or 256.\n");
        exit(EXIT_FAILURE);
     }
+
+    if (slot_number < 0 || slot_number >= DIR_SLOTS) { 
+       fprintf(stderr, "Invalid slot, choose 0 to %d.\n", DIR_SLOTS - 1);
+       exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < channels; i++) {
+        spi_fd[i] = wiringPiSPISetup (channel[i], SPEED);
+        if (spi_fd[i] < 0) {
+            fprintf(stderr, "Cannot open SPI channel %d.\n", channel[i]); 
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // a SPI NOR flash answers the JEDEC ID, an EEPROM does not
+    flash_size = flash_probe(channel[0], id);
+    for (i = 1; i < channels; i++) {
+        if (flash_probe(channel[i], verify) != flash_size) {
+            fprintf(stderr, "Chip select %d is another memory\n", channel[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (flash_size > 0) {
+        flash = TRUE;
+        eeprom_size = flash_size;
+        page_size = FLASH_PAGE_SIZE;
+        address_bits = 24;
+        // wiringPi takes the clock of the channel setup, open it again
+        for (i = 0; i < channels; i++) {
+            close(spi_fd[i]);
+            spi_fd[i] = wiringPiSPISetup (channel[i], FLASH_SPEED);
+            if (spi_fd[i] < 0) {
+                fprintf(stderr, "Cannot open SPI channel %d.\n", channel[i]); 
+                exit(EXIT_FAILURE);
+            }
+        }
+        fprintf(stderr, "flash %02x %02x %02x, %u KiB\n", id[0], id[1], id[2],
+                eeprom_size / 1024);
+    }
+
+    // the manifest is at the end, a flash reserves the last sector
+    manifest_limit = eeprom_size;
+    if (manifest_mode && !check_mode && !list_mode) {
+        manifest_limit = manifest_reserved(eeprom_size, flash);
+        if (manifest_limit == eeprom_size) {
+           fprintf(stderr, "EEPROM too small for the manifest.\n");
+           exit(EXIT_FAILURE);
+        }
+        if (!boot_mode && (start_adr >= manifest_limit || 
+            (end_adr != 0 && end_adr >= manifest_limit))) {
+           fprintf(stderr, "Range in the manifest area, the data ends at "
+                   "0x%05x.\n", manifest_limit - 1);
+           exit(EXIT_FAILURE);
+        }
+    }
+    end_default = end_adr == 0;
+    if (end_default) {
+      end_adr = manifest_limit - 1;
+    }
+
+    if ((boot_mode || list_mode || init_mode) && eeprom_size <= DIR_SIZE) { 
+       fprintf(stderr, "EEPROM too small for the boot directory.\n");
+       exit(EXIT_FAILURE);
+    }
+
+    if (list_mode) {
+        for (i = 0; i < channels; i++) {
+            if (channels > 1) {
+                printf("%schip select %d\n", i > 0 ? "\n" : "", channel[i]);
+            }
+            read_eeprom(channel[i], address_bits, DIR_ADR, dir, DIR_SIZE);
+            invalid = decode_dir(dir, eeprom_size, slot);
+            list_dir(slot);
+            if (invalid > 0) {
+                fprintf(stderr, "%d invalid entries ignored, -I initialises "
+                        "the directory\n", invalid);
+            }
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    if (init_mode) {
+        init_dir();
+        fprintf(stderr, "boot directory initialised\n");
+        exit(EXIT_SUCCESS);
+    }
       
     fp = stdin;
     if (optind < argc) {
@@ -190,96 +442,749 @@ int main(int argc, char *argv[]) {
               argv[optind]);
             exit(EXIT_FAILURE);
         }
+        name = strrchr(argv[optind], '/') ? strrchr(argv[optind], '/') + 1 
+                                          : argv[optind];
     }
 
-    eeprom_fd = wiringPiSPISetup (CHANNEL, SPEED);
-    if (eeprom_fd < 0) {
-        fprintf(stderr, "Cannot open SPI channel.\n"); 
-        exit(EXIT_FAILURE);
+    if (boot_mode) {
+        // write the boot image instead of the file
+        source = boot_file(fp, compress_mode, hex_mode, load_adr, entry, 
+                           &image_len);
+        if (source == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        source_len = image_len;
+    } else if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && 
+               st.st_size > 0) {
+        // regular file, the pages are copied from the mapping
+        source = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+        if (source == MAP_FAILED) {
+            fprintf(stderr, "Cannot map the file\n");
+            exit(EXIT_FAILURE);
+        }
+        source_len = st.st_size;
     }
-    
-    // pages required for EEPROM write operation
-    start_remainder = page_size - (start_adr % page_size);
-    if (start_remainder == page_size) {
-        start_remainder = 0;
+
+    if (boot_mode) {
+        // place the image in the pages of the slot, keep the other slots
+        read_eeprom(channel[0], address_bits, DIR_ADR, dir, DIR_SIZE);
+        for (i = 1; i < channels; i++) {
+            // the slot is at the same offset on all EEPROMs
+            read_eeprom(channel[i], address_bits, DIR_ADR, other_dir, DIR_SIZE);
+            if (memcmp(other_dir, dir, DIR_SIZE) != 0) {
+                fprintf(stderr, 
+                  "Boot directories differ, write chip select %d alone\n", 
+                  channel[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        invalid = decode_dir(dir, eeprom_size, slot);
+        if (invalid > 0) {
+            fprintf(stderr, "%d invalid directory entries ignored, -I "
+                    "initialises the directory\n", invalid);
+        }
+        for (i = 0; i < DIR_SLOTS; i++) {
+            if (slot[i].offset == SLOT_EMPTY) {
+                // a flash programs the whole directory again
+                memset(&dir[i * DIR_ENTRY_SIZE], 0xFF, DIR_ENTRY_SIZE);
+            }
+        }
+        // a flash slot has its own sectors
+        offset = alloc_slot(slot, slot_number, image_len, 
+                            flash ? FLASH_SECTOR : page_size, manifest_limit);
+        if (check_mode) {
+            // the image in the slot is compared
+            offset = slot[slot_number].offset;
+        }
+        if (offset < 0) {
+            fprintf(stderr, "No space left for slot %d\n", slot_number);
+            exit(EXIT_FAILURE);
+        }
+        start_adr = offset;
+        end_adr = offset + image_len - 1;
+        slot[slot_number].offset = offset;
+        slot[slot_number].len = image_len;
+        strncpy(slot[slot_number].name, name, DIR_NAME_SIZE);
+        slot[slot_number].name[DIR_NAME_SIZE] = '\0';
     }
-    end_remainder = (end_adr+1) % page_size;
     
-    if (start_remainder != 0) {
-        // write start remainder page
-        written_bytes = write_page(start_adr, start_remainder);
+    if (manifest_mode && end_default && source != NULL && 
+        source_len > end_adr - start_adr + 1) {
+        fprintf(stderr, "0x%05x bytes do not fit below the manifest, the "
+                "data ends at 0x%05x.\n", source_len, manifest_limit - 1);
+        exit(EXIT_FAILURE);
     }
 
-    pages = ((end_adr+1) - start_adr - start_remainder - end_remainder) / page_size;
-    for (page = 0; page < pages; page++) {
-        // write whole pages
-        if (end_of_file) {
-            break;
+    if (source != NULL) {
+        data_len = source_len;
+        if (data_len > end_adr - start_adr + 1) {
+            data_len = end_adr - start_adr + 1;
+        }
+        crc = crc32_update(0, source, data_len);
+    }
+
+    if (check_mode) {
+        if (source == NULL) {
+            fprintf(stderr, "The check requires a file\n");
+            exit(EXIT_FAILURE);
+        }
+        exit(manifest_check(start_adr, data_len, crc) ? EXIT_SUCCESS 
+                                                      : EXIT_FAILURE);
+    }
+
+    // the entries of the overwritten ranges are removed before the first
+    // page, an interrupted run leaves no stale entry. A range reaching 
+    // the manifest overwrites it, the end of a pipe is not known.
+    data_end = source != NULL ? start_adr + data_len - 1 : end_adr;
+    if (source == NULL && data_end >= eeprom_size - MANIFEST_SIZE) {
+        data_end = eeprom_size - MANIFEST_SIZE - 1;
+    }
+    if (manifest_reserved(eeprom_size, flash) < eeprom_size && 
+        start_adr <= data_end && data_end < eeprom_size - MANIFEST_SIZE) {
+        for (i = 0; i < channels; i++) {
+            manifest_clear(channel[i], address_bits, page_size, eeprom_size, 
+                           flash, manifest[i], start_adr, data_end);
+        }
+    }
+
+    adr = start_adr;
+    if (journal_file != NULL) {
+        if (source == NULL) {
+            fprintf(stderr, "The journal requires a file\n");
+            exit(EXIT_FAILURE);
+        }
+        hash = fnv1a(source, source_len);
+        last_page = journal_resume(journal_file, hash);
+        if (last_page >= start_adr) {
+            // read back the last journaled page
+            adr = last_page;
+            pos = adr - start_adr;
+            count = page_count(adr);
+            if (count > source_len - pos) {
+                count = source_len - pos;
+            }
+            verified = TRUE;
+            for (i = 0; i < channels; i++) {
+                read_eeprom(channel[i], address_bits, adr, verify, count);
+                if (memcmp(verify, &source[pos], count) != 0) {
+                    verified = FALSE;
+                }
+            }
+            if (verified) {
+                adr += count;
+            }
+            fprintf(stderr, "resuming at 0x%05x\n", adr);
+        }
+        journal = journal_start(journal_file, hash, last_page >= start_adr);
+        if (journal == NULL) {
+            fprintf(stderr, "Cannot write journal \"%s\"\n", journal_file);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (flash) {
+        // the sectors are erased ahead of the pages, a file or boot image
+        // erases whole 64 KiB blocks inside its range
+        erase_begin = adr;
+        erase_end = end_adr;
+        if (source != NULL && start_adr + source_len - 1 < end_adr) {
+            erase_end = start_adr + source_len - 1;
         }
-        written_bytes += write_page(start_adr + start_remainder + page * page_size, page_size);
+        erased = adr - adr % FLASH_SECTOR;
     }
 
-    if (end_remainder != 0 && !end_of_file) {
-        // write end remainder page
-        written_bytes += write_page(end_adr - end_remainder + 1, end_remainder);
+    // two page buffers, the next page is filled during the write cycle
+    if (queue_init(&queue, 2, page_size) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (source == NULL) {
+        pthread_create(&reader, NULL, pipe_reader, NULL);
+    }
+
+    for (n = 0; ; n++) {
+        if (source != NULL) {
+            page = memory_page(&queue.page[n % 2], adr);
+        } else {
+            page = queue_get(&queue);
+        }
+        if (page == NULL) {
+            break;
+        }
+        if (source == NULL) {
+            crc = crc32_update(crc, page->data, page->count);
+        }
+        while (flash && erased < page->adr + page->count) {
+            erased = flash_erase(erased, erase_begin, erase_end, 
+                                 source != NULL);
+        }
+        // each chip gets the page when its previous write cycle is 
+        // finished
+        written_bytes += write_page_all(page);
+        if (journal != NULL && journal_adr >= 0) {
+            fprintf(journal, "%05x\n", (unsigned int) journal_adr);
+            fflush(journal);
+        }
+        journal_adr = page->adr;
+        adr = page->adr + page->count;
+        if (source == NULL) {
+            queue_release(&queue);
+        }
+    }
+    write_cycle_wait_all();
+    if (source == NULL) {
+        pthread_join(reader, NULL);
+        if (manifest_mode && end_default && fgetc(fp) != EOF) {
+            fprintf(stderr, "The data does not fit below the manifest, "
+                    "written up to 0x%05x.\n", manifest_limit - 1);
+            exit(EXIT_FAILURE);
+        }
     }
-            
     
     fprintf(stderr, "0x%05x bytes written\n", written_bytes);
+    if (flash) {
+        fprintf(stderr, "%u sectors, %u blocks erased\n", erased_sectors, 
+                erased_blocks);
+    }
     
-    fclose(fp);
+    if (!boot_mode) {
+        // boot_file has closed the file
+        fclose(fp);
+    }
+
+    if (boot_mode && adr == start_adr + image_len) {
+        // the directory entry is written last, the slot switches to 
+        // the new image in one page write
+        entry_page.buf = entry_buf;
+        entry_page.data = &entry_buf[HEADER_SIZE];
+        entry_page.adr = DIR_ADR + slot_number * DIR_ENTRY_SIZE;
+        entry_page.count = DIR_ENTRY_SIZE;
+        encode_dir_entry(&slot[slot_number], entry_page.data);
+        if (flash) {
+            // the directory sector is erased, the whole directory is
+            // programmed again
+            memcpy(&dir[slot_number * DIR_ENTRY_SIZE], entry_page.data, 
+                   DIR_ENTRY_SIZE);
+            memcpy(entry_page.data, dir, DIR_SIZE);
+            entry_page.adr = DIR_ADR;
+            entry_page.count = DIR_SIZE;
+            flash_erase(DIR_ADR, DIR_ADR, DIR_ADR + DIR_SIZE - 1, FALSE);
+        }
+        write_page_all(&entry_page);
+        write_cycle_wait_all();
+        fprintf(stderr, "slot %d at 0x%05x\n", slot_number, start_adr);
+    }
+
+    if (manifest_mode && adr > start_adr) {
+        // the range is complete
+        manifest_entry.start = start_adr;
+        manifest_entry.len = adr - start_adr;
+        manifest_entry.crc = crc;
+        for (i = 0; i < channels; i++) {
+            manifest_add(manifest[i], &manifest_entry);
+        }
+        manifest_write_all();
+        fprintf(stderr, "manifest 0x%05x 0x%05x crc %08x\n", start_adr, 
+                manifest_entry.len, crc);
+    }
+
+    if (journal != NULL) {
+        // all pages written
+        fclose(journal);
+        unlink(journal_file);
+    }
 }
 
-int write_page(uint32_t start, uint16_t count) {
-    uint16_t i;
-    uint8_t data[page_size+4];
-    uint8_t address_bytes;
-        
-    // write enable
-    data[0] = WREN_CMD;
-    wiringPiSPIDataRW(CHANNEL, &data[0], 1) ;      
-    
-    // prepare for write
-    data[0] = WRITE_CMD;
-        
-    if (address_bits == 24) {
-        // 24 bit address
-        data[1] = start >> 16;
-        data[2] = start >> 8 & 0x0000FF;
-        data[3] = start & 0x0000FF;
-        address_bytes = 3;    
-    } else if (address_bits == 16) {
-        data[1] = start >> 8 & 0x0000FF;
-        data[2] = start & 0x0000FF;    
-        address_bytes = 2;    
+/*
+ ** ===================================================================
+ **  Method      :  parse_channels
+ */
+/**
+ *  @brief
+ *      Reads the list of chip selects
+ *  @param
+ *      list        comma separated chip selects (e.g. 0,1)
+ *  @return
+ *      int         number of chip selects, -1 invalid list
+ */
+/* ===================================================================*/
+int parse_channels(char *list) {
+    char *token;
+    char *end;
+    long ch;
+    int i;
+
+    channels = 0;
+    for (token = strtok(list, ","); token != NULL; token = strtok(NULL, ",")) {
+        ch = strtol(token, &end, 10);
+        if (*end != '\0' || ch < 0 || ch >= MAX_CHANNELS) {
+            return -1;
+        }
+        for (i = 0; i < channels; i++) {
+            if (channel[i] == ch) {
+                return -1;
+            }
+        }
+        channel[channels++] = ch;
+    }
+    return channels > 0 ? channels : -1;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  write_page_all
+ */
+/**
+ *  @brief
+ *      Sends the page to all chips. The status registers are polled 
+ *      round-robin, a chip gets the page as soon as its write cycle is 
+ *      finished while the others are still busy. The transfer overwrites
+ *      the buffer with the received bytes, the data is restored for the
+ *      next chip.
+ *  @param
+ *      page        page buffer
+ *  @return
+ *      int         number of data bytes, -1 on error
+ */
+/* ===================================================================*/
+int write_page_all(eeprom_page_t *page) {
+    uint8_t data[PAGE_SIZE];
+    uint8_t pending = (1 << channels) - 1;
+    int result = 0;
+    int i;
+
+    memcpy(data, page->data, page->count);
+    while (pending) {
+        for (i = 0; i < channels; i++) {
+            if ((pending & (1 << i)) && !write_in_process(channel[i])) {
+                memcpy(page->data, data, page->count);
+                if (write_page_start(channel[i], address_bits, page) < 0) {
+                    result = -1;
+                }
+                pending &= ~(1 << i);
+            }
+        }
+    }
+    return result < 0 ? result : page->count;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  write_cycle_wait_all
+ */
+/**
+ *  @brief
+ *      Waits for the write cycle of all chips
+ */
+/* ===================================================================*/
+void write_cycle_wait_all(void) {
+    int i;
+
+    for (i = 0; i < channels; i++) {
+        write_cycle_wait(channel[i]);
+    }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  flash_erase
+ */
+/**
+ *  @brief
+ *      Erases the next sector or block on all chips. A 64 KiB block is 
+ *      used when it is aligned and inside the range. The bytes of a 
+ *      sector outside the range are read before and programmed again 
+ *      after the erase.
+ *  @param
+ *      adr         sector aligned flash address
+ *  @param
+ *      begin       first address of the range
+ *  @param
+ *      end         last address of the range
+ *  @param
+ *      blocks      64 KiB blocks allowed (the end of the data is known)
+ *  @return
+ *      uint32_t    address after the erased sector or block
+ */
+/* ===================================================================*/
+uint32_t flash_erase(uint32_t adr, uint32_t begin, uint32_t end, 
+                     uint8_t blocks) {
+    static uint8_t keep[MAX_CHANNELS][FLASH_SECTOR];
+    uint8_t buf[HEADER_SIZE + FLASH_PAGE_SIZE];
+    eeprom_page_t page;
+    uint32_t len = FLASH_SECTOR;
+    uint8_t cmd = SECTOR_ERASE_CMD;
+    uint8_t outside;
+    uint8_t used;
+    uint32_t a;
+    int i, j;
+
+    if (blocks && adr % FLASH_BLOCK == 0 && adr >= begin && 
+        adr + FLASH_BLOCK - 1 <= end) {
+        len = FLASH_BLOCK;
+        cmd = BLOCK_ERASE_CMD;
+        erased_blocks++;
     } else {
-        // 8 bit
-        data[1] = start & 0x0000FF;    
-        address_bytes = 1;    
+        erased_sectors++;
     }
-    
-    // read data block
-    for (i = 0; i < count; i++) {
-        data[i+4] = fgetc(fp);
-		if( feof(fp) ) {
-            // reached EOF
-            end_of_file = TRUE;
-            break;
+
+    // the first and the last sector may hold data outside the range
+    outside = adr < begin || adr + len - 1 > end;
+    write_cycle_wait_all();
+    for (i = 0; outside && i < channels; i++) {
+        for (a = 0; a < len; a += FLASH_PAGE_SIZE) {
+            read_eeprom(channel[i], address_bits, adr + a, &keep[i][a], 
+                        FLASH_PAGE_SIZE);
+        }
+    }
+    for (i = 0; i < channels; i++) {
+        erase_start(channel[i], cmd, adr);
+    }
+    write_cycle_wait_all();
+
+    page.buf = buf;
+    page.data = &buf[HEADER_SIZE];
+    page.count = FLASH_PAGE_SIZE;
+    for (i = 0; outside && i < channels; i++) {
+        for (a = 0; a < len; a += FLASH_PAGE_SIZE) {
+            memcpy(page.data, &keep[i][a], FLASH_PAGE_SIZE);
+            used = FALSE;
+            for (j = 0; j < FLASH_PAGE_SIZE; j++) {
+                if (adr + a + j >= begin && adr + a + j <= end) {
+                    // written later
+                    page.data[j] = 0xFF;
+                }
+                used |= page.data[j] != 0xFF;
+            }
+            if (used) {
+                // erased pages are not programmed
+                page.adr = adr + a;
+                write_page_start(channel[i], address_bits, &page);
+                write_cycle_wait(channel[i]);
+            }
+        }
+    }
+    return adr + len;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_read_all
+ */
+/**
+ *  @brief
+ *      Reads the manifest of all chips
+ */
+/* ===================================================================*/
+void manifest_read_all(void) {
+    int i;
+
+    for (i = 0; i < channels; i++) {
+        manifest_read(channel[i], address_bits, eeprom_size, manifest[i]);
+    }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_write_all
+ */
+/**
+ *  @brief
+ *      Writes the manifest of all chips
+ */
+/* ===================================================================*/
+void manifest_write_all(void) {
+    int i;
+
+    write_cycle_wait_all();
+    for (i = 0; i < channels; i++) {
+        manifest_write(channel[i], address_bits, page_size, eeprom_size, 
+                       flash, manifest[i]);
+    }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_check
+ */
+/**
+ *  @brief
+ *      Compares the range with the manifest of all chips
+ *  @param
+ *      start       start address of the range
+ *  @param
+ *      len         length of the data
+ *  @param
+ *      crc         CRC32 of the data
+ *  @return
+ *      int         TRUE all chips hold the data
+ */
+/* ===================================================================*/
+int manifest_check(uint32_t start, uint32_t len, uint32_t crc) {
+    manifest_entry_t entry;
+    int i;
+
+    manifest_read_all();
+    for (i = 0; i < channels; i++) {
+        if (manifest_find(manifest[i], start, &entry) < 0 || 
+            entry.len != len || entry.crc != crc) {
+            fprintf(stderr, "0x%05x 0x%05x crc %08x differs\n", start, len, 
+                    crc);
+            return FALSE;
         }
     }
+    fprintf(stderr, "0x%05x 0x%05x crc %08x up to date\n", start, len, crc);
+    return TRUE;
+}
 
-    if (i == 0) {
+/*
+ ** ===================================================================
+ **  Method      :  page_count
+ */
+/**
+ *  @brief
+ *      Number of bytes from the address to the end of the page or the
+ *      end address
+ *  @param
+ *      adr         EEPROM address
+ *  @return
+ *      uint16_t    number of bytes, 0 after the end address
+ */
+/* ===================================================================*/
+uint16_t page_count(uint32_t adr) {
+    uint32_t count = page_size - adr % page_size;
+
+    if (adr > end_adr) {
         return 0;
     }
-    
-    // write page
-    wiringPiSPIDataRW(CHANNEL, &data[0], 1 + address_bytes + i) ;     
-    
-    // wait til operation finished
-    do {
-        data[0] = RDSR_CMD; 
-        wiringPiSPIDataRW(CHANNEL, &data[0], 2);
-    } while ((data[1] & WRITE_IN_PROCESS) == WRITE_IN_PROCESS) ;  
-    
-    return i;   
+    if (count > end_adr + 1 - adr) {
+        count = end_adr + 1 - adr;
+    }
+    return count;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  memory_page
+ */
+/**
+ *  @brief
+ *      Copies the next page from the mapped file or the boot image to the
+ *      page buffer
+ *  @param
+ *      page        page buffer
+ *  @param
+ *      adr         EEPROM address of the page
+ *  @return
+ *      eeprom_page_t* page, NULL end of data
+ */
+/* ===================================================================*/
+eeprom_page_t *memory_page(eeprom_page_t *page, uint32_t adr) {
+    uint32_t pos = adr - start_adr;
+    uint16_t count = page_count(adr);
+
+    if (pos >= source_len || count == 0) {
+        return NULL;
+    }
+    if (count > source_len - pos) {
+        count = source_len - pos;
+    }
+    memcpy(page->data, &source[pos], count);
+    page->adr = adr;
+    page->count = count;
+    return page;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  pipe_reader
+ */
+/**
+ *  @brief
+ *      Reader thread for pipes and terminals, reads the pages ahead
+ *      while the EEPROM is busy
+ *  @param
+ *      arg         not used
+ *  @return
+ *      void*       NULL
+ */
+/* ===================================================================*/
+void *pipe_reader(void *arg) {
+    eeprom_page_t *page;
+    uint32_t adr = start_adr;
+    uint16_t count;
+
+    while ((count = page_count(adr)) > 0) {
+        page = queue_free_page(&queue);
+        page->adr = adr;
+        page->count = fread(page->data, 1, count, fp);
+        if (page->count > 0) {
+            queue_put(&queue, page);
+        }
+        if (page->count < count) {
+            // end of file
+            break;
+        }
+        adr += count;
+    }
+    queue_close(&queue);
+    return NULL;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  fnv1a
+ */
+/**
+ *  @brief
+ *      64 bit FNV-1a hash of the data written
+ *  @param
+ *      data        data
+ *  @param
+ *      len         number of bytes
+ *  @return
+ *      uint64_t    hash
+ */
+/* ===================================================================*/
+uint64_t fnv1a(const uint8_t *data, uint32_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  journal_resume
+ */
+/**
+ *  @brief
+ *      Reads the journal of an interrupted run. The header line has the
+ *      hash, the range and the EEPROM geometry, each following line the
+ *      address of a page whose write cycle has finished.
+ *  @param
+ *      file        journal file
+ *  @param
+ *      hash        hash of the data
+ *  @return
+ *      int64_t     address of the last written page, -1 no journal or
+ *                  another file or range
+ */
+/* ===================================================================*/
+int64_t journal_resume(const char *file, uint64_t hash) {
+    FILE *jf;
+    unsigned long long journal_hash;
+    unsigned int start, end, journal_page_size, bits, adr;
+    int64_t last = -1;
+
+    jf = fopen(file, "r");
+    if (jf == NULL) {
+        return -1;
+    }
+    if (fscanf(jf, "bin2eeprom %llx %x %x %u %u\n", &journal_hash, &start, 
+               &end, &journal_page_size, &bits) == 5 &&
+        journal_hash == hash && start == start_adr && end == end_adr &&
+        journal_page_size == page_size && bits == address_bits) {
+        // a line cut off by a crash has a lower address, these pages
+        // are written again
+        while (fscanf(jf, "%x\n", &adr) == 1) {
+            if (adr >= start_adr && adr <= end_adr) {
+                last = adr;
+            }
+        }
+    }
+    fclose(jf);
+    return last;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  journal_start
+ */
+/**
+ *  @brief
+ *      Opens the journal, a new journal starts with the header line
+ *  @param
+ *      file        journal file
+ *  @param
+ *      hash        hash of the data
+ *  @param
+ *      resume      append to the journal of the interrupted run
+ *  @return
+ *      FILE        journal, NULL on error
+ */
+/* ===================================================================*/
+FILE *journal_start(const char *file, uint64_t hash, uint8_t resume) {
+    FILE *jf;
+
+    if (resume) {
+        return fopen(file, "a");
+    }
+    jf = fopen(file, "w");
+    if (jf != NULL) {
+        fprintf(jf, "bin2eeprom %016llx %05x %05x %u %u\n", 
+                (unsigned long long) hash, start_adr, end_adr, page_size, 
+                address_bits);
+        fflush(jf);
+    }
+    return jf;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  list_dir
+ */
+/**
+ *  @brief
+ *      Prints the used slots of the boot directory
+ *  @param
+ *      slot        DIR_SLOTS entries
+ */
+/* ===================================================================*/
+void list_dir(const boot_slot_t *slot) {
+    int i;
+
+    printf("slot switches offset  length  name\n");
+    for (i = 0; i < DIR_SLOTS; i++) {
+        if (slot[i].offset == SLOT_EMPTY) {
+            continue;
+        }
+        printf("%4d     0x%02x 0x%05x 0x%05x %s\n", i, i, slot[i].offset, 
+               slot[i].len, slot[i].name);
+    }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  init_dir
+ */
+/**
+ *  @brief
+ *      Initialises the boot directory of all chips, all entries are 
+ *      erased (0xFF)
+ */
+/* ===================================================================*/
+void init_dir(void) {
+    uint8_t buf[HEADER_SIZE + PAGE_SIZE];
+    eeprom_page_t page;
+    uint16_t chunk = page_size < DIR_SIZE ? page_size : DIR_SIZE;
+    uint32_t a;
+
+    if (flash) {
+        // the erased sector is the empty directory
+        flash_erase(DIR_ADR, DIR_ADR, DIR_ADR + DIR_SIZE - 1, FALSE);
+        return;
+    }
+    page.buf = buf;
+    page.data = &buf[HEADER_SIZE];
+    page.count = chunk;
+    for (a = 0; a < DIR_SIZE; a += chunk) {
+        memset(page.data, 0xFF, chunk);
+        page.adr = DIR_ADR + a;
+        write_page_all(&page);
+    }
+    write_cycle_wait_all();
 }
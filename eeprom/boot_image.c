@@ -0,0 +1,736 @@
+/**
+ *  @brief
+ *      Boot image format for the EEPROM boot loader.
+ *
+ *      Builds the boot image (entry point and segments, see boot_image.h)
+ *      from a flat binary or the address ranges of an Intel HEX file.
+ *      The segments can be compressed to the token format expanded by
+ *      the 1802 boot loader. The compressor is a greedy LZ77 with hash
+ *      chains, the window is the whole segment. The boot directory
+ *      helpers place the images of several slots in the EEPROM.
+ *
+ *  @file
+ *      boot_image.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "boot_image.h"
+
+#define HASH_BITS       (12)
+#define HASH_SIZE       (1 << HASH_BITS)
+#define CHAIN_DEPTH     (256)
+#define NO_POS          (-1)
+
+static uint32_t hash(const uint8_t *p) {
+  return ((p[0] << 8 ^ p[1] << 4 ^ p[2] ^ p[3] << 2) * 2654435761u)
+    >> (32 - HASH_BITS);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  compress_bound
+ */
+/**
+ *  @brief
+ *      Worst case size of a compressed image (all literals)
+ *  @param
+ *      len         size of the uncompressed data
+ *  @return
+ *      uint32_t    buffer size required for compress_image
+ */
+/* ===================================================================*/
+uint32_t compress_bound(uint32_t len) {
+  return len + len / MAX_LITERAL + 2;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  compress_image
+ */
+/**
+ *  @brief
+ *      Compresses data to the boot image token format (incl. end token)
+ *  @param
+ *      in          uncompressed data
+ *  @param
+ *      len         size of the uncompressed data
+ *  @param
+ *      out         buffer for the compressed image
+ *  @param
+ *      out_size    size of the buffer
+ *  @return
+ *      int         size of the compressed image, -1 buffer too small
+ */
+/* ===================================================================*/
+int compress_image(const uint8_t *in, uint32_t len,
+		   uint8_t *out, uint32_t out_size) {
+  int32_t head[HASH_SIZE];
+  int32_t *prev;
+  uint32_t pos = 0;
+  uint32_t o = 0;
+  uint32_t literal = 0;    // start of the pending literal run
+  uint32_t best_len;
+  uint32_t best_dist;
+  uint32_t n;
+  int32_t cand;
+  int depth;
+  uint32_t i;
+
+  if (out_size < compress_bound(len)) {
+    return -1;
+  }
+  prev = malloc(sizeof(int32_t) * (len + 1));
+  if (prev == NULL) {
+    return -1;
+  }
+  for (i = 0; i < HASH_SIZE; i++) {
+    head[i] = NO_POS;
+  }
+
+  while (pos < len) {
+    best_len = 0;
+    best_dist = 0;
+    if (pos + MIN_MATCH <= len) {
+      // search the hash chain for the longest match
+      cand = head[hash(&in[pos])];
+      for (depth = 0; cand != NO_POS && depth < CHAIN_DEPTH; depth++) {
+	if (pos - cand > MAX_DISTANCE) {
+	  break;
+	}
+	for (n = 0; n < MAX_MATCH && pos + n < len &&
+	       in[cand + n] == in[pos + n]; n++) {
+	  // overlapping matches are fine, the loader copies byte by byte
+	}
+	if (n > best_len) {
+	  best_len = n;
+	  best_dist = pos - cand;
+	  if (n == MAX_MATCH) {
+	    break;
+	  }
+	}
+	cand = prev[cand];
+      }
+    }
+
+    if (best_len >= MIN_MATCH) {
+      // flush pending literals
+      while (literal < pos) {
+	n = pos - literal > MAX_LITERAL ? MAX_LITERAL : pos - literal;
+	out[o++] = n;
+	memcpy(&out[o], &in[literal], n);
+	o += n;
+	literal += n;
+      }
+      out[o++] = TOKEN_MATCH | (best_len - MIN_MATCH);
+      out[o++] = best_dist >> 8;
+      out[o++] = best_dist & 0xFF;
+    } else {
+      best_len = 1;
+    }
+
+    // insert the covered positions into the hash chains
+    for (i = 0; i < best_len; i++, pos++) {
+      if (pos + MIN_MATCH <= len) {
+	uint32_t h = hash(&in[pos]);
+	prev[pos] = head[h];
+	head[h] = pos;
+      }
+    }
+    if (best_len >= MIN_MATCH) {
+      literal = pos;
+    }
+  }
+
+  while (literal < len) {
+    n = len - literal > MAX_LITERAL ? MAX_LITERAL : len - literal;
+    out[o++] = n;
+    memcpy(&out[o], &in[literal], n);
+    o += n;
+    literal += n;
+  }
+  out[o++] = TOKEN_END;
+
+  free(prev);
+  return o;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  expand_tokens
+ */
+/**
+ *  @brief
+ *      Expands tokens up to the end token
+ *  @param
+ *      in          compressed data
+ *  @param
+ *      len         size of the compressed data
+ *  @param
+ *      pos[in,out] position of the first token, after the end token
+ *  @param
+ *      out         memory
+ *  @param
+ *      o           destination address in memory
+ *  @param
+ *      out_size    size of the memory
+ *  @return
+ *      int         address after the last byte, -1 invalid tokens
+ */
+/* ===================================================================*/
+static int expand_tokens(const uint8_t *in, uint32_t len, uint32_t *pos,
+			 uint8_t *out, uint32_t o, uint32_t out_size) {
+  uint32_t i = *pos;
+  uint32_t n;
+  uint32_t dist;
+  uint8_t token;
+
+  while (i < len) {
+    token = in[i++];
+    if (token == TOKEN_END) {
+      *pos = i;
+      return o;
+    }
+    if (token & TOKEN_MATCH) {
+      if (i + 2 > len) {
+	return -1;
+      }
+      n = (token & MAX_LITERAL) + MIN_MATCH;
+      dist = in[i] << 8 | in[i+1];
+      i += 2;
+      if (dist == 0 || dist > o || o + n > out_size) {
+	return -1;
+      }
+      for (; n > 0; n--, o++) {
+	out[o] = out[o - dist];
+      }
+    } else {
+      if (i + token > len || o + token > out_size) {
+	return -1;
+      }
+      memcpy(&out[o], &in[i], token);
+      i += token;
+      o += token;
+    }
+  }
+  // end token missing
+  return -1;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  expand_image
+ */
+/**
+ *  @brief
+ *      Expands a compressed image like the boot loader does
+ *  @param
+ *      in          compressed image
+ *  @param
+ *      len         size of the compressed image
+ *  @param
+ *      out         buffer for the uncompressed data
+ *  @param
+ *      out_size    size of the buffer
+ *  @return
+ *      int         size of the uncompressed data, -1 invalid image
+ */
+/* ===================================================================*/
+int expand_image(const uint8_t *in, uint32_t len,
+		 uint8_t *out, uint32_t out_size) {
+  uint32_t pos = 0;
+
+  return expand_tokens(in, len, &pos, out, 0, out_size);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  boot_image_bound
+ */
+/**
+ *  @brief
+ *      Worst case size of a boot image
+ *  @param
+ *      segment     segments to load
+ *  @param
+ *      segments    number of segments
+ *  @return
+ *      uint32_t    buffer size required for build_boot_image
+ */
+/* ===================================================================*/
+uint32_t boot_image_bound(const boot_segment_t *segment, int segments) {
+  uint32_t size = 3;
+  int i;
+
+  for (i = 0; i < segments; i++) {
+    size += 5 + compress_bound(segment[i].len);
+  }
+  return size;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  build_boot_image
+ */
+/**
+ *  @brief
+ *      Builds the boot image: entry point, segments and end type
+ *  @param
+ *      entry       entry point (start address)
+ *  @param
+ *      segment     segments to load
+ *  @param
+ *      segments    number of segments
+ *  @param
+ *      compress    compressed segments (0 raw)
+ *  @param
+ *      out         buffer for the boot image
+ *  @param
+ *      out_size    size of the buffer
+ *  @return
+ *      int         size of the boot image, -1 buffer too small,
+ *                  -2 segment overlaps the boot loader
+ */
+/* ===================================================================*/
+int build_boot_image(uint16_t entry, const boot_segment_t *segment,
+		     int segments, uint8_t compress,
+		     uint8_t *out, uint32_t out_size) {
+  uint32_t o = 0;
+  int len;
+  int i;
+
+  if (out_size < boot_image_bound(segment, segments)) {
+    return -1;
+  }
+
+  out[o++] = entry >> 8;
+  out[o++] = entry & 0xFF;
+  for (i = 0; i < segments; i++) {
+    if (segment[i].len == 0) {
+      continue;
+    }
+    if (segment[i].adr < LOADER_END || 
+	segment[i].adr + segment[i].len > MEMORY_SIZE) {
+      return -2;
+    }
+    out[o++] = compress ? SEG_COMPRESSED : SEG_RAW;
+    out[o++] = segment[i].adr >> 8;
+    out[o++] = segment[i].adr & 0xFF;
+    if (compress) {
+      len = compress_image(segment[i].data, segment[i].len, 
+			   &out[o], out_size - o);
+      if (len < 0) {
+	return -1;
+      }
+      o += len;
+    } else {
+      out[o++] = segment[i].len >> 8;
+      out[o++] = segment[i].len & 0xFF;
+      memcpy(&out[o], segment[i].data, segment[i].len);
+      o += segment[i].len;
+    }
+  }
+  out[o++] = SEG_END;
+
+  return o;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  load_boot_image
+ */
+/**
+ *  @brief
+ *      Loads a boot image into memory like the boot loader does
+ *  @param
+ *      image       boot image
+ *  @param
+ *      len         size of the boot image (or more)
+ *  @param
+ *      mem         64 KiB memory
+ *  @param
+ *      entry[out]  entry point
+ *  @return
+ *      int         size of the boot image, -1 invalid image
+ */
+/* ===================================================================*/
+int load_boot_image(const uint8_t *image, uint32_t len,
+		    uint8_t *mem, uint16_t *entry) {
+  uint32_t i = 2;
+  uint32_t adr;
+  uint32_t n;
+  uint8_t type;
+
+  if (len < 3) {
+    return -1;
+  }
+  *entry = image[0] << 8 | image[1];
+
+  while (i < len) {
+    type = image[i++];
+    if (type == SEG_END) {
+      return i;
+    }
+    if (i + 2 > len) {
+      return -1;
+    }
+    adr = image[i] << 8 | image[i+1];
+    i += 2;
+    if (type == SEG_RAW) {
+      if (i + 2 > len) {
+	return -1;
+      }
+      n = image[i] << 8 | image[i+1];
+      i += 2;
+      if (i + n > len || adr + n > MEMORY_SIZE) {
+	return -1;
+      }
+      memcpy(&mem[adr], &image[i], n);
+      i += n;
+    } else if (type == SEG_COMPRESSED) {
+      if (expand_tokens(image, len, &i, mem, adr, MEMORY_SIZE) < 0) {
+	return -1;
+      }
+    } else {
+      // the boot loader stops at an unknown segment type
+      return -1;
+    }
+  }
+  return -1;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  read_hex_file
+ */
+/**
+ *  @brief
+ *      Reads an Intel HEX file (data and end of file records) and
+ *      returns the contiguous address ranges as segments
+ *  @param
+ *      fp          Intel HEX file
+ *  @param
+ *      mem         64 KiB memory for the data
+ *  @param
+ *      segment     segments found
+ *  @param
+ *      max         size of the segment array
+ *  @return
+ *      int         number of segments, -1 invalid file, -2 too many
+ *                  segments
+ */
+/* ===================================================================*/
+int read_hex_file(FILE *fp, uint8_t *mem, boot_segment_t *segment, int max) {
+  static uint8_t used[MEMORY_SIZE];
+  char line[600];
+  unsigned int count, adr, type, byte;
+  uint8_t sum;
+  int segments = 0;
+  uint32_t i;
+  uint32_t start;
+
+  memset(used, 0, sizeof(used));
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (line[0] != ':') {
+      // skip empty lines
+      continue;
+    }
+    if (sscanf(line, ":%2x%4x%2x", &count, &adr, &type) != 3 ||
+	strlen(line) < 11 + 2 * count) {
+      return -1;
+    }
+    sum = count + (adr >> 8) + adr + type;
+    for (i = 0; i <= count; i++) {
+      if (sscanf(&line[9 + 2 * i], "%2x", &byte) != 1) {
+	return -1;
+      }
+      sum += byte;
+      if (i < count && type == 0) {
+	mem[(adr + i) & 0xFFFF] = byte;
+	used[(adr + i) & 0xFFFF] = 1;
+      }
+    }
+    if (sum != 0) {
+      // checksum error
+      return -1;
+    }
+    if (type == 1) {
+      // end of file record
+      break;
+    }
+  }
+
+  // contiguous ranges
+  for (i = 0; i < MEMORY_SIZE; i++) {
+    if (!used[i]) {
+      continue;
+    }
+    if (segments == max) {
+      return -2;
+    }
+    start = i;
+    while (i < MEMORY_SIZE && used[i]) {
+      i++;
+    }
+    segment[segments].adr = start;
+    segment[segments].len = i - start;
+    segment[segments].data = &mem[start];
+    segments++;
+  }
+  return segments;
+}
+
+
+/*
+ ** ===================================================================
+ **  Method      :  decode_dir
+ */
+/**
+ *  @brief
+ *      Decodes the boot directory read from the EEPROM. An entry is 
+ *      empty when it is erased or invalid: the image is not past the 
+ *      directory and inside the EEPROM, or the name is not printable 
+ *      with zero padding (e.g. the data of a plain image or zeros).
+ *  @param
+ *      raw         DIR_SIZE bytes at DIR_ADR
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      slot        DIR_SLOTS entries
+ *  @return
+ *      int         number of invalid entries
+ */
+/* ===================================================================*/
+int decode_dir(const uint8_t *raw, uint32_t eeprom_size, boot_slot_t *slot) {
+  int invalid = 0;
+  int valid;
+  int i, j;
+
+  for (i = 0; i < DIR_SLOTS; i++, raw += DIR_ENTRY_SIZE) {
+    slot[i].offset = raw[0] << 16 | raw[1] << 8 | raw[2];
+    slot[i].len = raw[3] << 16 | raw[4] << 8 | raw[5];
+    for (j = 0; j < DIR_NAME_SIZE; j++) {
+      // erased or padding bytes end the name
+      if (raw[6 + j] < ' ' || raw[6 + j] > '~') {
+	break;
+      }
+      slot[i].name[j] = raw[6 + j];
+    }
+    slot[i].name[j] = '\0';
+    valid = slot[i].offset >= DIR_ADR + DIR_SIZE && slot[i].len > 0 &&
+      slot[i].offset + slot[i].len <= eeprom_size;
+    for (; j < DIR_NAME_SIZE; j++) {
+      valid &= raw[6 + j] == 0;
+    }
+    if (raw[0] == 0xFF || !valid) {
+      invalid += raw[0] != 0xFF;
+      slot[i].offset = SLOT_EMPTY;
+      slot[i].len = 0;
+      slot[i].name[0] = '\0';
+    }
+  }
+  return invalid;
+}
+
+
+/*
+ ** ===================================================================
+ **  Method      :  encode_dir_entry
+ */
+/**
+ *  @brief
+ *      Encodes one directory entry
+ *  @param
+ *      slot        directory entry
+ *  @param
+ *      raw         DIR_ENTRY_SIZE bytes
+ */
+/* ===================================================================*/
+void encode_dir_entry(const boot_slot_t *slot, uint8_t *raw) {
+  raw[0] = slot->offset >> 16;
+  raw[1] = slot->offset >> 8;
+  raw[2] = slot->offset;
+  raw[3] = slot->len >> 16;
+  raw[4] = slot->len >> 8;
+  raw[5] = slot->len;
+  memset(&raw[6], 0, DIR_NAME_SIZE);
+  strncpy((char *) &raw[6], slot->name, DIR_NAME_SIZE);
+}
+
+
+/*
+ ** ===================================================================
+ **  Method      :  alloc_slot
+ */
+/**
+ *  @brief
+ *      Finds the first page aligned EEPROM range for the image of a slot
+ *      that does not overlap the directory and the other slots. The old
+ *      image of the slot itself may be overwritten.
+ *  @param
+ *      slot        DIR_SLOTS entries
+ *  @param
+ *      n           slot to write
+ *  @param
+ *      len         size of the boot image
+ *  @param
+ *      page_size   EEPROM page size
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @return
+ *      int32_t     offset of the image, -1 no space left
+ */
+/* ===================================================================*/
+int32_t alloc_slot(const boot_slot_t *slot, int n, uint32_t len,
+		   uint32_t page_size, uint32_t eeprom_size) {
+  uint32_t offset = (DIR_ADR + DIR_SIZE + page_size - 1) / page_size * page_size;
+  uint32_t end;
+  int moved = 1;
+  int i;
+
+  while (moved) {
+    // restart the check after each move
+    moved = 0;
+    for (i = 0; i < DIR_SLOTS; i++) {
+      if (i == n || slot[i].offset == SLOT_EMPTY) {
+	continue;
+      }
+      end = (slot[i].offset + slot[i].len + page_size - 1) / page_size * page_size;
+      if (offset < end && slot[i].offset < offset + len) {
+	offset = end;
+	moved = 1;
+      }
+    }
+  }
+  if (offset + len > eeprom_size) {
+    return -1;
+  }
+  return offset;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  boot_file
+ */
+/**
+ *  @brief
+ *      Reads the whole file and builds the boot image
+ *  @param
+ *      in          binary or Intel HEX file, closed
+ *  @param
+ *      compress    compressed segments
+ *  @param
+ *      hex         the file is an Intel HEX file
+ *  @param
+ *      load_adr    load address of a binary file
+ *  @param
+ *      entry       entry point, -1 load address of the first segment
+ *  @param
+ *      boot_len[out] size of the boot image
+ *  @return
+ *      uint8_t*    boot image, NULL on error
+ */
+/* ===================================================================*/
+uint8_t *boot_file(FILE *in, uint8_t compress, uint8_t hex,
+		   uint16_t load_adr, int32_t entry, uint32_t *boot_len) {
+  static uint8_t data[MEMORY_SIZE + 1];
+  static uint8_t check[MEMORY_SIZE];
+  static boot_segment_t segment[MAX_SEGMENTS];
+  uint8_t *image;
+  uint32_t image_size;
+  int segments;
+  int image_len;
+  uint16_t check_entry;
+  uint32_t len = 0;
+  int i;
+
+  if (hex) {
+    segments = read_hex_file(in, data, segment, MAX_SEGMENTS);
+    if (segments < 0) {
+      fprintf(stderr, "Invalid Intel HEX file or too many segments\n");
+      return NULL;
+    }
+  } else {
+    segment[0].adr = load_adr;
+    segment[0].len = fread(data, 1, MEMORY_SIZE - load_adr + 1, in);
+    segment[0].data = data;
+    segments = 1;
+    if (segment[0].len > MEMORY_SIZE - load_adr) {
+      fprintf(stderr, "File does not fit above 0x%04x\n", load_adr);
+      return NULL;
+    }
+  }
+  fclose(in);
+  if (segments == 0 || segment[0].len == 0) {
+    fprintf(stderr, "Nothing to boot\n");
+    return NULL;
+  }
+  if (entry < 0) {
+    entry = segment[0].adr;
+  }
+
+  image_size = boot_image_bound(segment, segments);
+  image = malloc(image_size);
+  if (image == NULL) {
+    return NULL;
+  }
+  image_len = build_boot_image(entry, segment, segments, compress,
+			       image, image_size);
+  if (image_len == -2) {
+    fprintf(stderr, "Segment overlaps the boot loader (below 0x%04x)\n",
+	    LOADER_END);
+    free(image);
+    return NULL;
+  }
+
+  // load the image like the boot loader and compare
+  memset(check, 0, sizeof(check));
+  if (image_len < 0 ||
+      load_boot_image(image, image_len, check, &check_entry) != image_len ||
+      check_entry != entry) {
+    fprintf(stderr, "Cannot build boot image\n");
+    free(image);
+    return NULL;
+  }
+  for (i = 0; i < segments; i++) {
+    if (memcmp(&check[segment[i].adr], segment[i].data, segment[i].len) != 0) {
+      fprintf(stderr, "Cannot build boot image\n");
+      free(image);
+      return NULL;
+    }
+    fprintf(stderr, "segment 0x%04x-0x%04x\n", segment[i].adr,
+	    segment[i].adr + segment[i].len - 1);
+    len += segment[i].len;
+  }
+  fprintf(stderr, "0x%04x bytes, entry 0x%04x, boot image 0x%04x bytes\n",
+	  len, (unsigned int) entry, image_len);
+
+  *boot_len = image_len;
+  return image;
+}
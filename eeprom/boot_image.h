@@ -0,0 +1,347 @@
+/**
+ *  @brief
+ *      Boot image format for the EEPROM boot loader.
+ *
+ *      The boot directory at EEPROM address 0 has 16 entries of 16 bytes,
+ *      the data switches (bit 0 to 3) select the entry at boot:
+ *
+ *      <offset 23..16> <offset 15..8> <offset 7..0>    offset of the image
+ *      <len 23..16> <len 15..8> <len 7..0>             size of the image
+ *      <name>                                          10 characters
+ *
+ *      An empty slot has the offset 0xFFFFFF (erased EEPROM), the boot
+ *      loader stops. The images start at a page boundary, writing one
+ *      slot does not touch the pages of the other slots.
+ *
+ *      The boot image starts with the entry point followed by the
+ *      segments. Each segment has a type and a load
+ *      address, the loader stops at the end type and jumps to the entry
+ *      point. Only the segments are read, the boot time depends on the
+ *      program size and not on the EEPROM size.
+ *
+ *      <entry hi> <entry lo>
+ *      01 <adr hi> <adr lo> <len hi> <len lo> <data>   raw segment
+ *      02 <adr hi> <adr lo> <tokens> 00                compressed segment
+ *      00                                              end of image
+ *
+ *      The compressed segments use a simple LZ77 scheme that the
+ *      1802 boot loader can expand on the fly while it clocks the bytes
+ *      out of the EEPROM. The segment is a sequence of tokens:
+ *
+ *      00000000                    end of segment
+ *      0nnnnnnn                    n (1..127) literal bytes follow
+ *      1lllllll <dist hi> <dist lo> copy l+4 (4..131) bytes already
+ *                                  written to dest - dist (1..65535)
+ *
+ *      Runs of the same byte (e.g. zeros) are encoded as one literal
+ *      followed by a match with distance 1.
+ *
+ *  @file
+ *      boot_image.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOOT_IMAGE_H_
+#define BOOT_IMAGE_H_
+
+// default load and start address of a binary file
+#define BOOT_ADR        (0x8000)
+// the boot loader and its scratch byte at 0x0100 must not be overwritten
+#define LOADER_END      (0x0101)
+#define MEMORY_SIZE     (0x10000)
+#define MAX_SEGMENTS    (64)
+
+// boot directory
+#define DIR_ADR         (0x000000)
+#define DIR_SLOTS       (16)
+#define DIR_ENTRY_SIZE  (16)
+#define DIR_SIZE        (DIR_SLOTS * DIR_ENTRY_SIZE)
+#define DIR_NAME_SIZE   (10)
+#define SLOT_EMPTY      (0xFFFFFF)
+
+// segment types
+#define SEG_END         (0x00)
+#define SEG_RAW         (0x01)
+#define SEG_COMPRESSED  (0x02)
+
+// compressed boot image tokens
+#define TOKEN_END       (0x00)
+#define TOKEN_MATCH     (0x80)
+#define MAX_LITERAL     (0x7F)
+#define MIN_MATCH       (4)
+#define MAX_MATCH       (0x7F + MIN_MATCH)
+#define MAX_DISTANCE    (0xFFFF)
+
+typedef struct {
+  uint16_t adr;
+  uint32_t len;
+  const uint8_t *data;
+} boot_segment_t;
+
+typedef struct {
+  uint32_t offset;
+  uint32_t len;
+  char name[DIR_NAME_SIZE + 1];
+} boot_slot_t;
+
+/*
+ ** ===================================================================
+ **  Method      :  compress_bound
+ */
+/**
+ *  @brief
+ *      Worst case size of a compressed image (all literals)
+ *  @param
+ *      len         size of the uncompressed data
+ *  @return
+ *      uint32_t    buffer size required for compress_image
+ */
+/* ===================================================================*/
+uint32_t compress_bound(uint32_t len);
+
+/*
+ ** ===================================================================
+ **  Method      :  compress_image
+ */
+/**
+ *  @brief
+ *      Compresses data to the boot image token format (incl. end token)
+ *  @param
+ *      in          uncompressed data
+ *  @param
+ *      len         size of the uncompressed data
+ *  @param
+ *      out         buffer for the compressed image
+ *  @param
+ *      out_size    size of the buffer
+ *  @return
+ *      int         size of the compressed image, -1 buffer too small
+ */
+/* ===================================================================*/
+int compress_image(const uint8_t *in, uint32_t len,
+		   uint8_t *out, uint32_t out_size);
+
+/*
+ ** ===================================================================
+ **  Method      :  expand_image
+ */
+/**
+ *  @brief
+ *      Expands a compressed image like the boot loader does
+ *  @param
+ *      in          compressed image
+ *  @param
+ *      len         size of the compressed image
+ *  @param
+ *      out         buffer for the uncompressed data
+ *  @param
+ *      out_size    size of the buffer
+ *  @return
+ *      int         size of the uncompressed data, -1 invalid image
+ */
+/* ===================================================================*/
+int expand_image(const uint8_t *in, uint32_t len,
+		 uint8_t *out, uint32_t out_size);
+
+/*
+ ** ===================================================================
+ **  Method      :  boot_image_bound
+ */
+/**
+ *  @brief
+ *      Worst case size of a boot image
+ *  @param
+ *      segment     segments to load
+ *  @param
+ *      segments    number of segments
+ *  @return
+ *      uint32_t    buffer size required for build_boot_image
+ */
+/* ===================================================================*/
+uint32_t boot_image_bound(const boot_segment_t *segment, int segments);
+
+/*
+ ** ===================================================================
+ **  Method      :  build_boot_image
+ */
+/**
+ *  @brief
+ *      Builds the boot image: entry point, segments and end type
+ *  @param
+ *      entry       entry point (start address)
+ *  @param
+ *      segment     segments to load
+ *  @param
+ *      segments    number of segments
+ *  @param
+ *      compress    compressed segments (0 raw)
+ *  @param
+ *      out         buffer for the boot image
+ *  @param
+ *      out_size    size of the buffer
+ *  @return
+ *      int         size of the boot image, -1 buffer too small,
+ *                  -2 segment overlaps the boot loader
+ */
+/* ===================================================================*/
+int build_boot_image(uint16_t entry, const boot_segment_t *segment,
+		     int segments, uint8_t compress,
+		     uint8_t *out, uint32_t out_size);
+
+/*
+ ** ===================================================================
+ **  Method      :  load_boot_image
+ */
+/**
+ *  @brief
+ *      Loads a boot image into memory like the boot loader does
+ *  @param
+ *      image       boot image
+ *  @param
+ *      len         size of the boot image (or more)
+ *  @param
+ *      mem         64 KiB memory
+ *  @param
+ *      entry[out]  entry point
+ *  @return
+ *      int         size of the boot image, -1 invalid image
+ */
+/* ===================================================================*/
+int load_boot_image(const uint8_t *image, uint32_t len,
+		    uint8_t *mem, uint16_t *entry);
+
+/*
+ ** ===================================================================
+ **  Method      :  read_hex_file
+ */
+/**
+ *  @brief
+ *      Reads an Intel HEX file (data and end of file records) and
+ *      returns the contiguous address ranges as segments
+ *  @param
+ *      fp          Intel HEX file
+ *  @param
+ *      mem         64 KiB memory for the data
+ *  @param
+ *      segment     segments found
+ *  @param
+ *      max         size of the segment array
+ *  @return
+ *      int         number of segments, -1 invalid file, -2 too many
+ *                  segments
+ */
+/* ===================================================================*/
+int read_hex_file(FILE *fp, uint8_t *mem, boot_segment_t *segment, int max);
+
+/*
+ ** ===================================================================
+ **  Method      :  decode_dir
+ */
+/**
+ *  @brief
+ *      Decodes the boot directory read from the EEPROM. An entry is 
+ *      empty when it is erased or invalid: the image is not past the 
+ *      directory and inside the EEPROM, or the name is not printable 
+ *      with zero padding (e.g. the data of a plain image or zeros).
+ *  @param
+ *      raw         DIR_SIZE bytes at DIR_ADR
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      slot        DIR_SLOTS entries
+ *  @return
+ *      int         number of invalid entries
+ */
+/* ===================================================================*/
+int decode_dir(const uint8_t *raw, uint32_t eeprom_size, boot_slot_t *slot);
+
+/*
+ ** ===================================================================
+ **  Method      :  encode_dir_entry
+ */
+/**
+ *  @brief
+ *      Encodes one directory entry
+ *  @param
+ *      slot        directory entry
+ *  @param
+ *      raw         DIR_ENTRY_SIZE bytes
+ */
+/* ===================================================================*/
+void encode_dir_entry(const boot_slot_t *slot, uint8_t *raw);
+
+/*
+ ** ===================================================================
+ **  Method      :  alloc_slot
+ */
+/**
+ *  @brief
+ *      Finds the first page aligned EEPROM range for the image of a slot
+ *      that does not overlap the directory and the other slots. The old
+ *      image of the slot itself may be overwritten.
+ *  @param
+ *      slot        DIR_SLOTS entries
+ *  @param
+ *      n           slot to write
+ *  @param
+ *      len         size of the boot image
+ *  @param
+ *      page_size   EEPROM page size
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @return
+ *      int32_t     offset of the image, -1 no space left
+ */
+/* ===================================================================*/
+int32_t alloc_slot(const boot_slot_t *slot, int n, uint32_t len,
+		   uint32_t page_size, uint32_t eeprom_size);
+
+/*
+ ** ===================================================================
+ **  Method      :  boot_file
+ */
+/**
+ *  @brief
+ *      Reads the whole file and builds the boot image
+ *  @param
+ *      in          binary or Intel HEX file, closed
+ *  @param
+ *      compress    compressed segments
+ *  @param
+ *      hex         the file is an Intel HEX file
+ *  @param
+ *      load_adr    load address of a binary file
+ *  @param
+ *      entry       entry point, -1 load address of the first segment
+ *  @param
+ *      boot_len[out] size of the boot image
+ *  @return
+ *      uint8_t*    boot image, NULL on error
+ */
+/* ===================================================================*/
+uint8_t *boot_file(FILE *in, uint8_t compress, uint8_t hex,
+		   uint16_t load_adr, int32_t entry, uint32_t *boot_len);
+
+#endif /* BOOT_IMAGE_H_ */
@@ -39,87 +39,206 @@ P7		EQU	7
 		ORG	0H
 		
 ; R0   program counter
-; R1   subroutine pc
+; R1   subroutine pc WRITEBYTE, pointer to the LBR address
 ; R2   stack pointer
-; R5.0 byte (read/write)
-; R6.0 bit counter
-; R4.0 carry bits
-; R7   destination address 
-; R8   length
-; R9   start address
+; R5.0 byte (write)
+; R6   bit counter (write), Rx for OUT
+; R7   destination address, EEPROM address bit 16 to 23
+; R8   segment type, length, EEPROM address bit 0 to 15
+; R9.0 0 directory entry, 1 boot image
+; R10  subroutine pc READBYTE
+; R11  match source address
+;
+; Boot directory at EEPROM address 0, 16 entries of 16 bytes. The
+; data switches (bit 0 to 3) select the entry:
+;   offset bit 16 to 23, 8 to 15, 0 to 7    0FFH: empty slot, stop
+;   length, name                            for bin2eeprom -L only
+;
+; Boot image at the offset (bin2eeprom -b or -c, see boot_image.h):
+;   entry hi, lo
+;   01H, adr hi, lo, len hi, lo, data       raw segment
+;   02H, adr hi, lo, tokens, 00H            compressed segment
+;   00H                                     end of image
+; Tokens of a compressed segment:
+;   01H..7FH                n literal bytes follow
+;   80H..FFH, dist hi, lo   copy (n - 80H + 4) bytes from dest - dist
+;
+; Cycles (machine cycles, 8 clocks each, 2 per instruction)
+;   READBYTE (incl. SEP R10)         62 per byte (avg.)
+;   raw segment byte                 72
+;   literal byte                     72
+;   byte copied by a match           12
+;   token overhead                   72 (literal run), 220 (match)
+; The bit loop (counter in R6, carry via R4) took 168 cycles per
+; byte, the loader with a fixed 32 KiB raw image 172 cycles per byte.
+; READBYTE is unrolled, the loader still fits in page 0 (0000H-00FFH).
+
+SEG_RAW		EQU	01H
+SEG_COMPRESSED	EQU	02H
+MIN_MATCH	EQU	4
 
 START
 		LBR	BOOTLOADER
 BOOTLOADER
-		LDI	080H		; set destination address
-		PHI	R7
-		PHI	R9		; start address
-		LDI	080H		; set length
-		PHI	R8
 		GHI	R0		; D = 00H
-		PLO	R7		; destination address page boundry
-		PLO	R8		; length in pages
-		PLO	R9
-		PHI	R1		; high byte subroutine
+		PHI	R1		; high byte subroutines
+		PHI	R10
+		PHI	R8		; address bit 8 to 15 = 0
+		PLO	R7		; address bit 16 to 23 = 0
+		PLO	R9		; R9.0 = 0, read the directory entry first
 		PLO	R2		; stack pointer = 0100H 
 		LDI	01H
 		PHI	R2
-		PLO	R4		; for the carry          
 		LDI	LOW WRITEBYTE 	; low byte subroutine
 		PLO	R1
+		LDI	LOW READBYTE	; low byte subroutine
+		PLO	R10
+		SEX	R2
+		INP	P4		; data switches select the boot slot
+		SHL			; 16 bytes per directory entry, slot 0 to 15
+		SHL
+		SHL
+		SHL
+		PLO	R8		; address bit 0 to 7
+READCMD		SEX	R0
 		OUT	P1		; deactivate CS to start operation
 		BYTE	00H
 		
 		SEX	R1		; for immediate OUT in subroutine 
 		LDI	03H		; EEPROM read command
 		SEP	R1		; CALL WRITEBYTE
-		GHI	R0		; address bit 16 to 23 = 0
+		GLO	R7		; address bit 16 to 23
 		SEP	R1		; CALL WRITEBYTE, replace by NOP for
 					; 1 to 512 Kibit EEPROMs
-		GHI	R0		; address bit 8 to 15 = 0
+		GHI	R8		; address bit 8 to 15
 		SEP	R1		; CALL WRITEBYTE, replace by NOP for
 					; 1 to 4 Kibit EEPROMs
-		GHI	R0		; address bit 0 to 7 = 0
+		GLO	R8		; address bit 0 to 7
 		SEP	R1		; CALL WRITEBYTE
 
 		SEX	R6		; Rx for OUT
-BLOCKLOOP	GHI	R0		; D = 0
-		PLO	R5 		; reset all bits
-		LDI	0 - 8		; counting up 8 times
-		PLO	R6		; bit counter
-RDBITLOOP	GLO	R4		; set CARRY
-		SHR
-		GLO	R5		; get bits
-		BN2	SETBIT		; branch if bit set (EF2 == 0)
-		SHL			; bit not set
-		SKP			; BR SAVEBIT
-SETBIT  	SHLC			; set bit
-SAVEBIT 	OUT	P2		; CLK for SPI, INC Rx 	
-		PLO	R5		; save bits
-		GLO	R6
-		BNZ	RDBITLOOP
-		GLO	R5		; get byte
+		GLO	R9
+		BNZ	IMAGE		; directory entry read, load the image
+		SEP	R10		; CALL READBYTE, image offset bit 16 to 23
+		PLO	R7
+		XRI	0FFH
+		BZ	STOP		; empty slot
+		SEP	R10		; CALL READBYTE, image offset bit 8 to 15
+		PHI	R8
+		SEP	R10		; CALL READBYTE, image offset bit 0 to 7
+		PLO	R8
+		INC	R9		; R9.0 = 1
+		BR	READCMD		; read the image
+IMAGE		LDI	01H		; set R1 to 0001h
+		PLO	R1
+		SEP	R10		; CALL READBYTE, entry point high byte
+		STR	R1		; store start address
+		INC	R1
+		SEP	R10		; CALL READBYTE, entry point low byte
+		STR	R1
+SEGMENT		SEP	R10		; CALL READBYTE, segment type
+		BZ	DONE		; end of image
+		PLO	R8		; save type
+		SEP	R10		; CALL READBYTE, load address high byte
+		PHI	R7
+		SEP	R10		; CALL READBYTE, load address low byte
+		PLO	R7
+		GLO	R8
+		SMI	SEG_RAW
+		BZ	RAW
+		GLO	R8
+		SMI	SEG_COMPRESSED
+		BZ	TOKEN
+STOP		IDL			; unknown segment type, stop
+RAW		SEP	R10		; CALL READBYTE, length high byte
+		PHI	R8
+		SEP	R10		; CALL READBYTE, length low byte
+		PLO	R8
+RAWLOOP		SEP	R10		; CALL READBYTE
 		STR	R7		; save byte
 		INC	R7		
 		DEC	R8
 		GLO	R8
-		BNZ	BLOCKLOOP
-		SEX	R2		; one page finished
+		BNZ	RAWLOOP
 		GHI	R8
+		BNZ	RAWLOOP
+		BR	SEGMENT
+
+TOKEN		SEP	R10		; CALL READBYTE, get token
+		BZ	SEGMENT		; end of segment
+		PLO	R8		; save token
+		ANI	80H
+		BNZ	MATCH
+LITERAL		SEP	R10		; CALL READBYTE
+		STR	R7		; save byte
+		INC	R7		
+		DEC	R8
+		GLO	R8
+		BNZ	LITERAL
+		BR	TOKEN
+MATCH		SEP	R10		; CALL READBYTE, distance high byte
+		PHI	R11
+		SEP	R10		; CALL READBYTE, distance low byte
+		SEX	R2
+		STR	R2
+		GLO	R7		; source = destination - distance
+		SM
+		PLO	R11
+		GHI	R11
 		STR	R2
-		OUT	P4		; show left pages on LEDs
-		DEC	R2
-		BNZ	BLOCKLOOP-1
-		OUT	P1		; deactivate CS to stop operation
+		GHI	R7
+		SMB
+		PHI	R11
+		SEX	R6		; Rx for OUT
+		GLO	R8		; length = token - 80H + MIN_MATCH
+		ADI	MIN_MATCH - 80H
+		PLO	R8
+COPY		LDA	R11		; copy byte
+		STR	R7
+		INC	R7		
+		DEC	R8
+		GLO	R8
+		BNZ	COPY
+		BR	TOKEN
+DONE		OUT	P1		; deactivate CS to stop operation
 		SEX	R0
-		INC	R8		; set R8 to 0001h
-		GHI	R9		; store start address
-		STR	R8
-		INC	R8
-		GLO	R9
-		STR	R8
 		BR	START
 
+		SEP	R0		; return, D = byte
+READBYTE	GHI	R0		; D = 0, 8 straight bit reads
+		B2	RDBIT7		; bit 7, branch if bit cleared (EF2 == 1)
+		ORI	01H		; set bit
+RDBIT7		OUT	P2		; CLK for SPI, INC Rx
+		SHL
+		B2	RDBIT6		; bit 6, branch if bit cleared (EF2 == 1)
+		ORI	01H		; set bit
+RDBIT6		OUT	P2		; CLK for SPI, INC Rx
+		SHL
+		B2	RDBIT5		; bit 5, branch if bit cleared (EF2 == 1)
+		ORI	01H		; set bit
+RDBIT5		OUT	P2		; CLK for SPI, INC Rx
+		SHL
+		B2	RDBIT4		; bit 4, branch if bit cleared (EF2 == 1)
+		ORI	01H		; set bit
+RDBIT4		OUT	P2		; CLK for SPI, INC Rx
+		SHL
+		B2	RDBIT3		; bit 3, branch if bit cleared (EF2 == 1)
+		ORI	01H		; set bit
+RDBIT3		OUT	P2		; CLK for SPI, INC Rx
+		SHL
+		B2	RDBIT2		; bit 2, branch if bit cleared (EF2 == 1)
+		ORI	01H		; set bit
+RDBIT2		OUT	P2		; CLK for SPI, INC Rx
+		SHL
+		B2	RDBIT1		; bit 1, branch if bit cleared (EF2 == 1)
+		ORI	01H		; set bit
+RDBIT1		OUT	P2		; CLK for SPI, INC Rx
+		SHL
+		B2	RDBIT0		; bit 0, branch if bit cleared (EF2 == 1)
+		ORI	01H		; set bit
+RDBIT0		OUT	P2		; CLK for SPI, INC Rx
+		BR	READBYTE-1
+
 		SEP	R0
 WRITEBYTE	PLO	R5		; save transmit byte
 		LDI	8		; counter 8 bits
@@ -47,6 +47,20 @@
 #define WRSR_CMD    (0x01)
 
 #define WRITE_IN_PROCESS    (0x01)
+
+// SPI NOR flash commands (W25Qxx), READ, WRITE (page program), WREN and 
+// RDSR are the same as for the EEPROM
+#define FAST_READ_CMD       (0x0B)
+#define JEDEC_ID_CMD        (0x9F)
+#define SECTOR_ERASE_CMD    (0x20)
+#define BLOCK_ERASE_CMD     (0xD8)
+
+#define FLASH_SECTOR        (4096)
+#define FLASH_BLOCK         (65536)
+#define FLASH_PAGE_SIZE     (256)
+// FAST_READ block size, below the spidev buffer of 4096 bytes
+#define FLASH_READ_SIZE     (2048)
+#define FLASH_SPEED         (8000000)
  
 #define PAGE_SIZE   (256)
 #define ADDRESS_BITS (24)
@@ -9,6 +9,9 @@
  *      Caution: Overwrite file if it exists. 
  *      Use > for redirecting (save the file) or | for piping to another 
  *      command (e.g. hexdump). 
+ *      A SPI NOR flash (W25Qxx) is detected by the JEDEC ID and read with
+ *      FAST_READ in blocks of 2 KiB at 8 MHz, the whole flash is the 
+ *      default range.
  * 
  *      http://spyr.ch/twiki/bin/view/Cosmac/MassStorage
  *
@@ -51,15 +54,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#ifdef SPI_SIM
+#include "spi_sim.h"
+#else
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
+#endif
 #include "eeprom.h"
+#include "eeprom_io.h"
 
 // function prototypes
 int read_page(uint32_t start, uint16_t count);
 
 // global variables
 static FILE *fp;
+static uint8_t flash = FALSE;
 
 uint16_t page_size = PAGE_SIZE;   
 uint8_t address_bits = ADDRESS_BITS;
@@ -76,6 +85,9 @@ int main(int argc, char *argv[]) {
     uint32_t pages;
     uint32_t page;
     uint16_t size = 0;
+    uint8_t end_set = FALSE;
+    uint32_t flash_size;
+    uint8_t id[3];
     
     // parse command line options
     while ((opt = getopt(argc, argv, "s:e:p:a:k:")) != -1) {
@@ -85,6 +97,7 @@ int main(int argc, char *argv[]) {
                 break; 
             case 'e': 
                 end_adr = strtol(optarg, NULL, 16);
+                end_set = TRUE;
                 break;
             case 'p': 
                 page_size = strtol(optarg, NULL, 10);
@@ -196,6 +209,26 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Cannot open SPI channel\n"); 
         exit(EXIT_FAILURE);
     }
+
+    // a SPI NOR flash answers the JEDEC ID, an EEPROM does not
+    flash_size = flash_probe(CHANNEL, id);
+    if (flash_size > 0) {
+        flash = TRUE;
+        page_size = FLASH_READ_SIZE;
+        address_bits = 24;
+        if (!end_set) {
+            end_adr = flash_size - 1;
+        }
+        // wiringPi takes the clock of the channel setup, open it again
+        close(eeprom_fd);
+        eeprom_fd = wiringPiSPISetup (CHANNEL, FLASH_SPEED);
+        if (eeprom_fd < 0) {
+            fprintf(stderr, "Cannot open SPI channel\n"); 
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stderr, "flash %02x %02x %02x, %u KiB\n", id[0], id[1], id[2],
+                flash_size / 1024);
+    }
     
     // pages required for EEPROM read operation
     start_remainder = page_size - (start_adr % page_size);
@@ -234,6 +267,13 @@ int read_page(uint32_t start, uint16_t count) {
     uint8_t data[page_size+4];
     uint8_t address_bytes;
 
+    if (flash) {
+        // FAST_READ has a dummy byte after the address
+        fast_read(CHANNEL, start, data, count);
+        fwrite(data, 1, count, fp);
+        return count;
+    }
+
     // prepare for read
     data[0] = READ_CMD;
     
@@ -258,8 +298,8 @@ int read_page(uint32_t start, uint16_t count) {
     wiringPiSPIDataRW (CHANNEL, &data[0],  1 + address_bytes + count) ;     
     
     // write data to the file
-    for(i = 4; i < count + 4; i++) {
-        fputc(data[i], fp);
+    for(i = 0; i < count; i++) {
+        fputc(data[1 + address_bytes + i], fp);
     }
     
     return count;
@@ -0,0 +1,498 @@
+/**
+ *  @brief
+ *      SPI EEPROM access shared by the EEPROM tools.
+ *
+ *      Block read, page write without waiting for the write cycle and
+ *      the page queue between a producer thread and the EEPROM writer.
+ *
+ *  @file
+ *      eeprom_io.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef SPI_SIM
+#include "spi_sim.h"
+#else
+#include <wiringPi.h>
+#include <wiringPiSPI.h>
+#endif
+#include "eeprom.h"
+#include "eeprom_io.h"
+
+
+/*
+ ** ===================================================================
+ **  Method      :  eeprom_geometry
+ */
+/**
+ *  @brief
+ *      Page size and address bits of the 25xx EEPROMs
+ *  @param
+ *      size        size in Kibit
+ *  @param
+ *      page_size[out]
+ *  @param
+ *      address_bits[out]
+ *  @return
+ *      int         0 ok, -1 unknown size
+ */
+/* ===================================================================*/
+int eeprom_geometry(uint16_t size, uint16_t *page_size,
+		    uint8_t *address_bits) {
+  switch (size) {
+  case 1:
+  case 2:
+    *address_bits = 8;
+    *page_size = 16;
+    break;
+  case 4:
+  case 8:
+  case 16:
+    *address_bits = 16;
+    *page_size = 16;
+    break;
+  case 32:
+  case 64:
+    *address_bits = 16;
+    *page_size = 32;
+    break;
+  case 128:
+  case 256:
+    *address_bits = 16;
+    *page_size = 64;
+    break;
+  case 512:
+    *address_bits = 16;
+    *page_size = 256;
+    break;
+  case 1024:
+  case 2048:
+    *address_bits = 24;
+    *page_size = 256;
+    break;
+  default:
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  set_header
+ */
+/**
+ *  @brief
+ *      Writes the command and the address right before data
+ *  @param
+ *      data        data, at least HEADER_SIZE bytes after the buffer start
+ *  @param
+ *      cmd         READ_CMD or WRITE_CMD
+ *  @param
+ *      adr         EEPROM address
+ *  @param
+ *      address_bits 8, 16 or 24
+ *  @return
+ *      uint8_t*    start of the header
+ */
+/* ===================================================================*/
+uint8_t *set_header(uint8_t *data, uint8_t cmd, uint32_t adr,
+		    uint8_t address_bits) {
+  uint8_t *p = data;
+  int i;
+
+  for (i = 0; i < address_bits / 8; i++) {
+    // address bytes from low to high in front of the data
+    *--p = adr >> (8 * i);
+  }
+  *--p = cmd;
+  return p;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  read_eeprom
+ */
+/**
+ *  @brief
+ *      Reads a block of the EEPROM
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits 8, 16 or 24
+ *  @param
+ *      start       EEPROM address
+ *  @param
+ *      buffer      buffer for the data
+ *  @param
+ *      count       number of bytes
+ *  @return
+ *      int         number of bytes read, -1 on error
+ */
+/* ===================================================================*/
+int read_eeprom(int channel, uint8_t address_bits, uint32_t start,
+		uint8_t *buffer, uint16_t count) {
+  uint8_t data[HEADER_SIZE + count];
+  uint8_t *header;
+
+  header = set_header(&data[HEADER_SIZE], READ_CMD, start, address_bits);
+  if (wiringPiSPIDataRW(channel, header, &data[HEADER_SIZE] - header + count) < 0) {
+    return -1;
+  }
+  memcpy(buffer, &data[HEADER_SIZE], count);
+  return count;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  write_page_start
+ */
+/**
+ *  @brief
+ *      Sends the write enable and the page, does not wait for the
+ *      write cycle. The page must not cross a page boundary.
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits 8, 16 or 24
+ *  @param
+ *      page        page buffer (the header is written in place)
+ *  @return
+ *      int         number of data bytes, -1 on error
+ */
+/* ===================================================================*/
+int write_page_start(int channel, uint8_t address_bits, eeprom_page_t *page) {
+  uint8_t cmd = WREN_CMD;
+  uint8_t *header;
+
+  if (page->count == 0) {
+    return 0;
+  }
+  wiringPiSPIDataRW(channel, &cmd, 1);
+  header = set_header(page->data, WRITE_CMD, page->adr, address_bits);
+  if (wiringPiSPIDataRW(channel, header, page->data - header + page->count) < 0) {
+    return -1;
+  }
+  return page->count;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  write_in_process
+ */
+/**
+ *  @brief
+ *      Reads the status register once
+ *  @param
+ *      channel     SPI chip select
+ *  @return
+ *      int         TRUE the write cycle is running
+ */
+/* ===================================================================*/
+int write_in_process(int channel) {
+  uint8_t data[2];
+
+  data[0] = RDSR_CMD;
+  data[1] = 0;
+  wiringPiSPIDataRW(channel, &data[0], 2);
+  return (data[1] & WRITE_IN_PROCESS) == WRITE_IN_PROCESS;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  write_cycle_wait
+ */
+/**
+ *  @brief
+ *      Polls the status register until the write cycle is finished
+ *  @param
+ *      channel     SPI chip select
+ *  @return
+ *      unsigned long number of status polls
+ */
+/* ===================================================================*/
+unsigned long write_cycle_wait(int channel) {
+  unsigned long polls = 1;
+
+  while (write_in_process(channel)) {
+    polls++;
+  }
+  return polls;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  flash_probe
+ */
+/**
+ *  @brief
+ *      Reads the JEDEC ID. A 25xx EEPROM does not answer the command.
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      id[out]     manufacturer, memory type and capacity (3 bytes)
+ *  @return
+ *      uint32_t    size of the flash in bytes, 0 no SPI NOR flash
+ */
+/* ===================================================================*/
+uint32_t flash_probe(int channel, uint8_t *id) {
+  uint8_t data[4];
+  int i;
+
+  data[0] = JEDEC_ID_CMD;
+  data[1] = data[2] = data[3] = 0;
+  if (wiringPiSPIDataRW(channel, &data[0], 4) < 0) {
+    return 0;
+  }
+  for (i = 0; i < 3; i++) {
+    id[i] = data[1 + i];
+  }
+  // the capacity is 2^n bytes, 3 address bytes reach 16 MiB
+  if (id[0] == 0x00 || id[0] == 0xFF || id[2] < 17 || id[2] > 24) {
+    return 0;
+  }
+  return 1UL << id[2];
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  fast_read
+ */
+/**
+ *  @brief
+ *      Reads a block of the flash with FAST_READ (24 bit address and a 
+ *      dummy byte)
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      start       flash address
+ *  @param
+ *      buffer      buffer for the data
+ *  @param
+ *      count       number of bytes (up to FLASH_READ_SIZE)
+ *  @return
+ *      int         number of bytes read, -1 on error
+ */
+/* ===================================================================*/
+int fast_read(int channel, uint32_t start, uint8_t *buffer, uint16_t count) {
+  uint8_t data[5 + count];
+
+  data[0] = FAST_READ_CMD;
+  data[1] = start >> 16;
+  data[2] = start >> 8;
+  data[3] = start;
+  data[4] = 0;
+  if (wiringPiSPIDataRW(channel, &data[0], 5 + count) < 0) {
+    return -1;
+  }
+  memcpy(buffer, &data[5], count);
+  return count;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  erase_start
+ */
+/**
+ *  @brief
+ *      Sends the write enable and the sector or block erase, does not 
+ *      wait for the erase cycle
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      cmd         SECTOR_ERASE_CMD or BLOCK_ERASE_CMD
+ *  @param
+ *      adr         flash address in the sector or block
+ *  @return
+ *      int         0 ok, -1 on error
+ */
+/* ===================================================================*/
+int erase_start(int channel, uint8_t cmd, uint32_t adr) {
+  uint8_t data[4];
+
+  data[0] = WREN_CMD;
+  wiringPiSPIDataRW(channel, &data[0], 1);
+  data[0] = cmd;
+  data[1] = adr >> 16;
+  data[2] = adr >> 8;
+  data[3] = adr;
+  if (wiringPiSPIDataRW(channel, &data[0], 4) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_init
+ */
+/**
+ *  @brief
+ *      Allocates the page buffers of the queue
+ *  @param
+ *      q           page queue
+ *  @param
+ *      pages       number of page buffers (2 for double buffering)
+ *  @param
+ *      page_size   EEPROM page size
+ *  @return
+ *      int         0 ok, -1 out of memory
+ */
+/* ===================================================================*/
+int queue_init(page_queue_t *q, int pages, uint16_t page_size) {
+  int i;
+
+  memset(q, 0, sizeof(*q));
+  q->page = calloc(pages, sizeof(eeprom_page_t));
+  if (q->page == NULL) {
+    return -1;
+  }
+  for (i = 0; i < pages; i++) {
+    q->page[i].buf = malloc(HEADER_SIZE + page_size);
+    if (q->page[i].buf == NULL) {
+      return -1;
+    }
+    q->page[i].data = q->page[i].buf + HEADER_SIZE;
+  }
+  q->pages = pages;
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->changed, NULL);
+  return 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_free_page
+ */
+/**
+ *  @brief
+ *      Waits for an empty page buffer (producer)
+ *  @param
+ *      q           page queue
+ *  @return
+ *      eeprom_page_t* empty page buffer
+ */
+/* ===================================================================*/
+eeprom_page_t *queue_free_page(page_queue_t *q) {
+  eeprom_page_t *page;
+
+  pthread_mutex_lock(&q->lock);
+  while (q->produced - q->released == q->pages) {
+    pthread_cond_wait(&q->changed, &q->lock);
+  }
+  page = &q->page[q->produced % q->pages];
+  pthread_mutex_unlock(&q->lock);
+  page->count = 0;
+  return page;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_put
+ */
+/**
+ *  @brief
+ *      Passes a filled page buffer to the consumer (producer)
+ *  @param
+ *      q           page queue
+ *  @param
+ *      page        page buffer from queue_free_page
+ */
+/* ===================================================================*/
+void queue_put(page_queue_t *q, eeprom_page_t *page) {
+  pthread_mutex_lock(&q->lock);
+  q->produced++;
+  pthread_cond_broadcast(&q->changed);
+  pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_close
+ */
+/**
+ *  @brief
+ *      No more pages follow (producer)
+ *  @param
+ *      q           page queue
+ */
+/* ===================================================================*/
+void queue_close(page_queue_t *q) {
+  pthread_mutex_lock(&q->lock);
+  q->closed = 1;
+  pthread_cond_broadcast(&q->changed);
+  pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_get
+ */
+/**
+ *  @brief
+ *      Waits for the next filled page buffer (consumer)
+ *  @param
+ *      q           page queue
+ *  @return
+ *      eeprom_page_t* filled page buffer, NULL queue closed and empty
+ */
+/* ===================================================================*/
+eeprom_page_t *queue_get(page_queue_t *q) {
+  eeprom_page_t *page = NULL;
+
+  pthread_mutex_lock(&q->lock);
+  while (q->consumed == q->produced && !q->closed) {
+    pthread_cond_wait(&q->changed, &q->lock);
+  }
+  if (q->consumed < q->produced) {
+    page = &q->page[q->consumed % q->pages];
+    q->consumed++;
+  }
+  pthread_mutex_unlock(&q->lock);
+  return page;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_release
+ */
+/**
+ *  @brief
+ *      Returns the page buffer from queue_get to the producer (consumer)
+ *  @param
+ *      q           page queue
+ */
+/* ===================================================================*/
+void queue_release(page_queue_t *q) {
+  pthread_mutex_lock(&q->lock);
+  q->released++;
+  pthread_cond_broadcast(&q->changed);
+  pthread_mutex_unlock(&q->lock);
+}
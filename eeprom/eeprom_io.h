@@ -0,0 +1,336 @@
+/**
+ *  @brief
+ *      SPI EEPROM access shared by the EEPROM tools.
+ *
+ *      Reads blocks, starts page writes and waits for the write cycle.
+ *      The page buffers have room for the command and address header in
+ *      front of the data. The header (8, 16 or 24 bit address) is written
+ *      in place right before the data, a page is sent with one transfer
+ *      without copying.
+ *
+ *      The page queue passes filled page buffers from a producer thread
+ *      (e.g. the Elf reader) to the thread writing the EEPROM. The next
+ *      page is filled while the EEPROM is busy with the write cycle of
+ *      the previous one.
+ *
+ *      SPI NOR flash (W25Qxx) has the same page program and status
+ *      register, it is detected by the JEDEC ID and must be erased in 
+ *      4 KiB sectors or 64 KiB blocks before the pages are programmed.
+ *
+ *  @file
+ *      eeprom_io.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EEPROM_IO_H_
+#define EEPROM_IO_H_
+
+// command and up to 24 address bits
+#define HEADER_SIZE     (4)
+
+typedef struct {
+  uint8_t *buf;
+  uint8_t *data;
+  uint32_t adr;
+  uint16_t count;
+} eeprom_page_t;
+
+typedef struct {
+  eeprom_page_t *page;
+  int pages;
+  unsigned long produced;
+  unsigned long consumed;
+  unsigned long released;
+  int closed;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+} page_queue_t;
+
+/*
+ ** ===================================================================
+ **  Method      :  eeprom_geometry
+ */
+/**
+ *  @brief
+ *      Page size and address bits of the 25xx EEPROMs
+ *  @param
+ *      size        size in Kibit
+ *  @param
+ *      page_size[out]
+ *  @param
+ *      address_bits[out]
+ *  @return
+ *      int         0 ok, -1 unknown size
+ */
+/* ===================================================================*/
+int eeprom_geometry(uint16_t size, uint16_t *page_size,
+		    uint8_t *address_bits);
+
+/*
+ ** ===================================================================
+ **  Method      :  set_header
+ */
+/**
+ *  @brief
+ *      Writes the command and the address right before data
+ *  @param
+ *      data        data, at least HEADER_SIZE bytes after the buffer start
+ *  @param
+ *      cmd         READ_CMD or WRITE_CMD
+ *  @param
+ *      adr         EEPROM address
+ *  @param
+ *      address_bits 8, 16 or 24
+ *  @return
+ *      uint8_t*    start of the header
+ */
+/* ===================================================================*/
+uint8_t *set_header(uint8_t *data, uint8_t cmd, uint32_t adr,
+		    uint8_t address_bits);
+
+/*
+ ** ===================================================================
+ **  Method      :  read_eeprom
+ */
+/**
+ *  @brief
+ *      Reads a block of the EEPROM
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits 8, 16 or 24
+ *  @param
+ *      start       EEPROM address
+ *  @param
+ *      buffer      buffer for the data
+ *  @param
+ *      count       number of bytes
+ *  @return
+ *      int         number of bytes read, -1 on error
+ */
+/* ===================================================================*/
+int read_eeprom(int channel, uint8_t address_bits, uint32_t start,
+		uint8_t *buffer, uint16_t count);
+
+/*
+ ** ===================================================================
+ **  Method      :  write_page_start
+ */
+/**
+ *  @brief
+ *      Sends the write enable and the page, does not wait for the
+ *      write cycle. The page must not cross a page boundary.
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits 8, 16 or 24
+ *  @param
+ *      page        page buffer (the header is written in place)
+ *  @return
+ *      int         number of data bytes, -1 on error
+ */
+/* ===================================================================*/
+int write_page_start(int channel, uint8_t address_bits, eeprom_page_t *page);
+
+/*
+ ** ===================================================================
+ **  Method      :  write_in_process
+ */
+/**
+ *  @brief
+ *      Reads the status register once
+ *  @param
+ *      channel     SPI chip select
+ *  @return
+ *      int         TRUE the write cycle is running
+ */
+/* ===================================================================*/
+int write_in_process(int channel);
+
+/*
+ ** ===================================================================
+ **  Method      :  write_cycle_wait
+ */
+/**
+ *  @brief
+ *      Polls the status register until the write cycle is finished
+ *  @param
+ *      channel     SPI chip select
+ *  @return
+ *      unsigned long number of status polls
+ */
+/* ===================================================================*/
+unsigned long write_cycle_wait(int channel);
+
+/*
+ ** ===================================================================
+ **  Method      :  flash_probe
+ */
+/**
+ *  @brief
+ *      Reads the JEDEC ID. A 25xx EEPROM does not answer the command.
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      id[out]     manufacturer, memory type and capacity (3 bytes)
+ *  @return
+ *      uint32_t    size of the flash in bytes, 0 no SPI NOR flash
+ */
+/* ===================================================================*/
+uint32_t flash_probe(int channel, uint8_t *id);
+
+/*
+ ** ===================================================================
+ **  Method      :  fast_read
+ */
+/**
+ *  @brief
+ *      Reads a block of the flash with FAST_READ (24 bit address and a 
+ *      dummy byte)
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      start       flash address
+ *  @param
+ *      buffer      buffer for the data
+ *  @param
+ *      count       number of bytes (up to FLASH_READ_SIZE)
+ *  @return
+ *      int         number of bytes read, -1 on error
+ */
+/* ===================================================================*/
+int fast_read(int channel, uint32_t start, uint8_t *buffer, uint16_t count);
+
+/*
+ ** ===================================================================
+ **  Method      :  erase_start
+ */
+/**
+ *  @brief
+ *      Sends the write enable and the sector or block erase, does not 
+ *      wait for the erase cycle
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      cmd         SECTOR_ERASE_CMD or BLOCK_ERASE_CMD
+ *  @param
+ *      adr         flash address in the sector or block
+ *  @return
+ *      int         0 ok, -1 on error
+ */
+/* ===================================================================*/
+int erase_start(int channel, uint8_t cmd, uint32_t adr);
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_init
+ */
+/**
+ *  @brief
+ *      Allocates the page buffers of the queue
+ *  @param
+ *      q           page queue
+ *  @param
+ *      pages       number of page buffers (2 for double buffering)
+ *  @param
+ *      page_size   EEPROM page size
+ *  @return
+ *      int         0 ok, -1 out of memory
+ */
+/* ===================================================================*/
+int queue_init(page_queue_t *q, int pages, uint16_t page_size);
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_free_page
+ */
+/**
+ *  @brief
+ *      Waits for an empty page buffer (producer)
+ *  @param
+ *      q           page queue
+ *  @return
+ *      eeprom_page_t* empty page buffer
+ */
+/* ===================================================================*/
+eeprom_page_t *queue_free_page(page_queue_t *q);
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_put
+ */
+/**
+ *  @brief
+ *      Passes a filled page buffer to the consumer (producer)
+ *  @param
+ *      q           page queue
+ *  @param
+ *      page        page buffer from queue_free_page
+ */
+/* ===================================================================*/
+void queue_put(page_queue_t *q, eeprom_page_t *page);
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_close
+ */
+/**
+ *  @brief
+ *      No more pages follow (producer)
+ *  @param
+ *      q           page queue
+ */
+/* ===================================================================*/
+void queue_close(page_queue_t *q);
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_get
+ */
+/**
+ *  @brief
+ *      Waits for the next filled page buffer (consumer)
+ *  @param
+ *      q           page queue
+ *  @return
+ *      eeprom_page_t* filled page buffer, NULL queue closed and empty
+ */
+/* ===================================================================*/
+eeprom_page_t *queue_get(page_queue_t *q);
+
+/*
+ ** ===================================================================
+ **  Method      :  queue_release
+ */
+/**
+ *  @brief
+ *      Returns the page buffer from queue_get to the producer (consumer)
+ *  @param
+ *      q           page queue
+ */
+/* ===================================================================*/
+void queue_release(page_queue_t *q);
+
+#endif /* EEPROM_IO_H_ */
@@ -0,0 +1,401 @@
+/**
+ *  @brief
+ *      elf2eeprom - Copies the Elf memory directly to a boot slot of the EEPROM.
+ *
+ *      Reads the Elf memory in load mode (like elf2bin) and writes it as
+ *      boot image with one raw segment to a slot of the boot directory
+ *      (like bin2eeprom -d). The Elf is read by a reader thread, the next
+ *      page is read over GPIO while the EEPROM is busy with the write cycle
+ *      of the previous page. The total time is close to the GPIO read time.
+ *      When the EEPROM holds a manifest (bin2eeprom -M) the slot ends 
+ *      below it, the manifest entries of the overwritten range are 
+ *      removed before the first page.
+ *
+ *      The EEPROM is connected to SPI0 CE0. The SPI0 pins (GPIO 8 to 11)
+ *      are data switch outputs of the Elf interface (see raspi_gpio.h),
+ *      which are not used while the Elf memory is read. They are switched
+ *      to SPI after the port initialisation and back to outputs at the end.
+ *
+ *      http://spyr.ch/twiki/bin/view/Cosmac/MassStorage
+ *
+ *      synopsis
+ *       $ elf2eeprom [-s hexadr] [-e hexadr] [-g hexadr] [-d slot] [-k size]
+ *                    [-w] [-r]
+ *      -s start address in hex (0x8000 is default)
+ *      -e end adress in hex (0xFFFF is default)
+ *      -g entry point in hex (start address is default)
+ *      -d <number>  boot directory slot 0..15 (0 is default)
+ *      -k <number>  EEPROM size in Kbits (1024 is default)
+ *      -w write enable
+ *      -r run mode
+ *  @file
+ *      elf2eeprom.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <wiringPi.h>
+#include <wiringPiSPI.h>
+#include "eeprom.h"
+#include "eeprom_io.h"
+#include "boot_image.h"
+#include "manifest.h"
+// Elf memory range of raspi_gpio.h
+#undef START_ADR
+#undef END_ADR
+#include "raspi_gpio.h"
+
+#define ELF_CHANNEL     (0)
+#define PAGE_BUFFERS    (4)
+// BCM2835 function select ALT0 (SPI0)
+#define FSEL_ALT0       (4)
+// raw segment header and end type
+#define IMAGE_OVERHEAD  (8)
+
+typedef struct {
+    page_queue_t queue;
+    uint16_t start_adr;
+    uint16_t end_adr;
+    uint16_t entry;
+    uint32_t offset;
+    uint16_t page_size;
+    eeprom_page_t *page;
+    double read_time;
+} reader_t;
+
+// function prototypes
+void *elf_reader(void *arg);
+void put_byte(reader_t *r, uint32_t *adr, uint8_t byte);
+void spi_pins(int spi);
+double seconds(void);
+
+uint16_t page_size = PAGE_SIZE;
+uint8_t address_bits = ADDRESS_BITS;
+
+
+int main(int argc, char *argv[]) {
+    int opt;
+    reader_t reader;
+    pthread_t thread;
+    eeprom_page_t *page;
+    eeprom_page_t entry_page;
+    uint8_t entry_buf[HEADER_SIZE + DIR_ENTRY_SIZE];
+    uint8_t dir[DIR_SIZE];
+    uint8_t manifest[MANIFEST_SIZE];
+    boot_slot_t slot[DIR_SLOTS];
+    uint32_t image_len;
+    uint32_t written_bytes = 0;
+    int32_t offset;
+    int32_t entry = -1;
+    int slot_number = 0;
+    uint16_t size = 1024;
+    uint32_t eeprom_size;
+    uint32_t manifest_limit;
+    uint8_t run_mode = FALSE;
+    uint8_t write_mode = FALSE;
+    unsigned long polls = 0;
+    double start_time;
+
+    memset(&reader, 0, sizeof(reader));
+    reader.start_adr = BOOT_ADR;
+    reader.end_adr = END_ADR;
+
+    // parse command line options
+    while ((opt = getopt(argc, argv, "s:e:g:d:k:wr")) != -1) {
+        switch (opt) {
+            case 's':
+                reader.start_adr = strtol(optarg, NULL, 16);
+                break;
+            case 'e':
+                reader.end_adr = strtol(optarg, NULL, 16);
+                break;
+            case 'g':
+                entry = strtol(optarg, NULL, 16);
+                break;
+            case 'd':
+                slot_number = strtol(optarg, NULL, 10);
+                break;
+            case 'k':
+                size = strtol(optarg, NULL, 10);
+                break;
+            case 'w':
+                write_mode = TRUE;
+                break;
+            case 'r':
+                run_mode = TRUE;
+                break;
+            default:
+                fprintf(stderr,
+                  "Usage: %s [-s <adr>] [-e <adr>] [-g <adr>] [-d <slot>] [-k <size>] [-w] [-r]\n",
+                  argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (eeprom_geometry(size, &page_size, &address_bits) != 0) {
+       fprintf(stderr, "Invalid size. Known sizes: 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048 Kibit\n");
+       exit(EXIT_FAILURE);
+    }
+    eeprom_size = size * 1024 / 8;
+    if (eeprom_size <= DIR_SIZE) {
+       fprintf(stderr, "EEPROM too small for the boot directory.\n");
+       exit(EXIT_FAILURE);
+    }
+    if (slot_number < 0 || slot_number >= DIR_SLOTS) {
+       fprintf(stderr, "Invalid slot, choose 0 to %d.\n", DIR_SLOTS - 1);
+       exit(EXIT_FAILURE);
+    }
+    if (reader.start_adr < LOADER_END || reader.end_adr < reader.start_adr) {
+       fprintf(stderr, "Invalid range, the boot loader uses 0x0000-0x%04x\n",
+               LOADER_END - 1);
+       exit(EXIT_FAILURE);
+    }
+    reader.entry = entry < 0 ? reader.start_adr : entry;
+    reader.page_size = page_size;
+    image_len = reader.end_adr - reader.start_adr + 1 + IMAGE_OVERHEAD;
+
+    if (init_port_mode() != 0) {
+        // can't init ports
+        exit(EXIT_FAILURE);
+    }
+    if (init_port_level() != 0) {
+        // can't init ports
+        exit(EXIT_FAILURE);
+    }
+    if (wiringPiSPISetup(ELF_CHANNEL, SPEED) < 0) {
+        fprintf(stderr, "Cannot open SPI channel.\n");
+        exit(EXIT_FAILURE);
+    }
+    spi_pins(TRUE);
+
+    // a manifest of bin2eeprom -M is kept
+    manifest_limit = eeprom_size;
+    if (manifest_reserved(eeprom_size, FALSE) < eeprom_size) {
+        manifest_read(ELF_CHANNEL, address_bits, eeprom_size, manifest);
+        if (manifest_entries(manifest) > 0) {
+            manifest_limit = manifest_reserved(eeprom_size, FALSE);
+        }
+    }
+
+    // place the image in the pages of the slot, keep the other slots
+    read_eeprom(ELF_CHANNEL, address_bits, DIR_ADR, dir, DIR_SIZE);
+    if (decode_dir(dir, eeprom_size, slot) > 0) {
+        fprintf(stderr, "Invalid directory entries ignored, bin2eeprom -I "
+                "initialises the directory\n");
+    }
+    offset = alloc_slot(slot, slot_number, image_len, page_size,
+                        manifest_limit);
+    if (offset < 0) {
+        fprintf(stderr, "No space left for slot %d\n", slot_number);
+        spi_pins(FALSE);
+        exit(EXIT_FAILURE);
+    }
+    reader.offset = offset;
+    if (manifest_limit < eeprom_size) {
+        manifest_clear(ELF_CHANNEL, address_bits, page_size, eeprom_size, 
+                       FALSE, manifest, offset, offset + image_len - 1);
+    }
+
+    if (queue_init(&reader.queue, PAGE_BUFFERS, page_size) != 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // read
+    digitalWrite(WRITE_N, 1);
+    // load
+    digitalWrite(WAIT_N, 0);
+    digitalWrite(CLEAR_N, 0);
+    usleep(100);
+    // reset
+    digitalWrite(WAIT_N, 1);
+    usleep(100);
+    digitalWrite(WAIT_N, 0);
+    usleep(100);
+
+    start_time = seconds();
+    pthread_create(&thread, NULL, elf_reader, &reader);
+
+    // write the pages while the reader reads the next one
+    while ((page = queue_get(&reader.queue)) != NULL) {
+        polls += write_cycle_wait(ELF_CHANNEL);
+        written_bytes += write_page_start(ELF_CHANNEL, address_bits, page);
+        queue_release(&reader.queue);
+    }
+    polls += write_cycle_wait(ELF_CHANNEL);
+    pthread_join(thread, NULL);
+
+    // the directory entry is written last
+    slot[slot_number].offset = offset;
+    slot[slot_number].len = image_len;
+    snprintf(slot[slot_number].name, sizeof(slot[slot_number].name),
+             "elf%04x", reader.start_adr);
+    entry_page.buf = entry_buf;
+    entry_page.data = &entry_buf[HEADER_SIZE];
+    entry_page.adr = DIR_ADR + slot_number * DIR_ENTRY_SIZE;
+    entry_page.count = DIR_ENTRY_SIZE;
+    encode_dir_entry(&slot[slot_number], entry_page.data);
+    write_page_start(ELF_CHANNEL, address_bits, &entry_page);
+    write_cycle_wait(ELF_CHANNEL);
+    spi_pins(FALSE);
+
+    if (write_mode) {
+        // write enable
+        digitalWrite(WRITE_N, 0);
+    } else {
+        // read
+        digitalWrite(WRITE_N, 1);
+    }
+    if (run_mode) {
+        // run
+        digitalWrite(WAIT_N, 1);
+        // reset
+        usleep(100);
+        digitalWrite(CLEAR_N, 1);
+    }
+
+    fprintf(stderr, "0x%05x bytes written, slot %d at 0x%05x\n",
+            written_bytes, slot_number, offset);
+    fprintf(stderr, "%.2f s total, %.2f s GPIO read, %lu status polls\n",
+            seconds() - start_time, reader.read_time, polls);
+    exit(EXIT_SUCCESS);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  elf_reader
+ */
+/**
+ *  @brief
+ *      Reader thread, reads the Elf memory in load mode and fills the
+ *      page buffers with the boot image
+ *  @param
+ *      arg         reader_t
+ *  @return
+ *      void*       NULL
+ */
+/* ===================================================================*/
+void *elf_reader(void *arg) {
+    reader_t *r = arg;
+    uint32_t adr = r->offset;
+    uint32_t len = r->end_adr - r->start_adr + 1;
+    double start_time = seconds();
+    uint32_t i;
+
+    put_byte(r, &adr, r->entry >> 8);
+    put_byte(r, &adr, r->entry & 0xFF);
+    put_byte(r, &adr, SEG_RAW);
+    put_byte(r, &adr, r->start_adr >> 8);
+    put_byte(r, &adr, r->start_adr & 0xFF);
+    put_byte(r, &adr, len >> 8);
+    put_byte(r, &adr, len & 0xFF);
+
+    for (i = 0; i <= r->end_adr; i++) {
+        // in clock
+        digitalWrite(IN_N, 0);
+        usleep(100);
+        digitalWrite(IN_N, 1);
+        usleep(100);
+        if (i >= r->start_adr) {
+            put_byte(r, &adr, read_byte());
+        }
+    }
+    put_byte(r, &adr, SEG_END);
+
+    if (r->page != NULL) {
+        // last partial page
+        queue_put(&r->queue, r->page);
+    }
+    r->read_time = seconds() - start_time;
+    queue_close(&r->queue);
+    return NULL;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  put_byte
+ */
+/**
+ *  @brief
+ *      Adds a byte to the current page buffer, a full page is passed
+ *      to the EEPROM writer
+ *  @param
+ *      r           reader
+ *  @param
+ *      adr         EEPROM address of the byte, incremented
+ *  @param
+ *      byte        data
+ */
+/* ===================================================================*/
+void put_byte(reader_t *r, uint32_t *adr, uint8_t byte) {
+    if (r->page == NULL) {
+        r->page = queue_free_page(&r->queue);
+        r->page->adr = *adr;
+    }
+    r->page->data[r->page->count++] = byte;
+    (*adr)++;
+    if (*adr % r->page_size == 0) {
+        queue_put(&r->queue, r->page);
+        r->page = NULL;
+    }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  spi_pins
+ */
+/**
+ *  @brief
+ *      Switches the data switch outputs shared with SPI0
+ *  @param
+ *      spi         TRUE SPI0 function, FALSE outputs
+ */
+/* ===================================================================*/
+void spi_pins(int spi) {
+    if (spi) {
+        pinModeAlt(OUTPUT_7, FSEL_ALT0);    // CE0
+        pinModeAlt(OUTPUT_4, FSEL_ALT0);    // MISO
+        pinModeAlt(OUTPUT_3, FSEL_ALT0);    // MOSI
+        pinModeAlt(OUTPUT_6, FSEL_ALT0);    // SCLK
+    } else {
+        pinMode(OUTPUT_7, OUTPUT);
+        pinMode(OUTPUT_4, OUTPUT);
+        pinMode(OUTPUT_3, OUTPUT);
+        pinMode(OUTPUT_6, OUTPUT);
+    }
+}
+
+double seconds(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
@@ -0,0 +1,560 @@
+/**
+ *  @brief
+ *      elfboot - Boots the Elf from the Raspberry Pi without an EEPROM.
+ *
+ *      The Raspberry Pi takes the place of the SPI EEPROM of the DB25
+ *      boot loader (bootloader-db25.asm). The loader clocks the EEPROM
+ *      with OUT 4 (bit 7 MOSI, bit 6 CLK, bit 5 CS) and reads MISO with
+ *      EF4. The output port is read by the GPIO inputs, MISO is driven on
+ *      the IN line (EF4), see raspi_gpio.h. No EEPROM has to be programmed
+ *      to try a new program: the image is served from the file.
+ *
+ *      The loader samples EF4 about 10 us after the falling CLK edge. A
+ *      GPIO interrupt through the kernel takes longer than that, so the
+ *      levels are polled in a busy loop on a real-time thread with locked
+ *      memory. The SPI protocol is decoded by a bit level EEPROM state
+ *      machine (see spi_slave.h) which is fed on every CS or CLK change.
+ *
+ *      The loader with OUT 1/OUT 2 and EF2 (bootloader.asm) talks to the
+ *      EEPROM on the card, those signals are not on the DB25 connector.
+ *
+ *      The Elf is reset and started in run mode, the loader at 0000H
+ *      reads the slot selected by the data switches.
+ *
+ *      http://spyr.ch/twiki/bin/view/Cosmac/MassStorage
+ *
+ *      synopsis
+ *       $ elfboot [-k size] [-b] [-c] [-x] [-l hexadr] [-g hexadr]
+ *                 [-d slot] [-f] [-t] file
+ *      The file is an EEPROM image (e.g. from eeprom2bin) or a program
+ *      with -b, -c or -x.
+ *      -k <number>  EEPROM size in Kbits (1024 is default), selects the
+ *         address bits of the loader (NOPs for the smaller EEPROMs)
+ *      -b boot image, the file is a binary, each slot of the directory
+ *         points to the boot image
+ *      -c boot image with compressed segments
+ *      -x the file is an Intel HEX file, each address range is a segment
+ *      -l load address in hex for a binary file (0x8000 is default)
+ *      -g entry point in hex (load address of the first segment is default)
+ *      -d <number>  data switches select the boot slot 0..15 (0 is default)
+ *      -f serve the image for every boot until interrupted
+ *      -t self test, the bit sequence of the boot loader is simulated
+ *         instead of the GPIO pins
+ *  @file
+ *      elfboot.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <wiringPi.h>
+#include "eeprom.h"
+#include "eeprom_io.h"
+#include "boot_image.h"
+#include "spi_slave.h"
+// Elf memory range of raspi_gpio.h
+#undef START_ADR
+#undef END_ADR
+#include "raspi_gpio.h"
+
+// OUT 4 bits of the DB25 loader
+#define PORT_MOSI       (0x80)
+#define PORT_CLK        (0x40)
+#define PORT_CS         (0x20)
+
+// function prototypes
+uint8_t *load_file(FILE *in, uint32_t size);
+uint8_t *virtual_eeprom(const uint8_t *image, uint32_t image_len,
+                        uint32_t size);
+unsigned long serve(spi_slave_t *s, int forever);
+int self_test(spi_slave_t *s, int slot_number);
+int loader_port(spi_slave_t *s, uint8_t out);
+void loader_write(spi_slave_t *s, uint8_t byte);
+uint8_t loader_read(spi_slave_t *s);
+void loader_command(spi_slave_t *s, uint32_t adr);
+double seconds(void);
+
+uint8_t loader_miso = 1;
+unsigned long loader_outs = 0;
+
+
+int main(int argc, char *argv[]) {
+    int opt;
+    FILE *fp;
+    spi_slave_t slave;
+    uint8_t *mem;
+    uint8_t *image;
+    uint32_t image_len;
+    uint32_t eeprom_size;
+    uint16_t page_size;
+    uint8_t address_bits;
+    uint16_t size = 1024;
+    uint16_t load_adr = BOOT_ADR;
+    int32_t entry = -1;
+    int slot_number = 0;
+    uint8_t boot_mode = FALSE;
+    uint8_t compress_mode = FALSE;
+    uint8_t hex_mode = FALSE;
+    uint8_t forever = FALSE;
+    uint8_t test_mode = FALSE;
+    unsigned long boots;
+    double start_time;
+
+    // parse command line options
+    while ((opt = getopt(argc, argv, "k:bcxl:g:d:ft")) != -1) {
+        switch (opt) {
+            case 'k':
+                size = strtol(optarg, NULL, 10);
+                break;
+            case 'b':
+                boot_mode = TRUE;
+                break;
+            case 'c':
+                boot_mode = TRUE;
+                compress_mode = TRUE;
+                break;
+            case 'x':
+                boot_mode = TRUE;
+                hex_mode = TRUE;
+                break;
+            case 'l':
+                load_adr = strtol(optarg, NULL, 16);
+                break;
+            case 'g':
+                entry = strtol(optarg, NULL, 16);
+                break;
+            case 'd':
+                slot_number = strtol(optarg, NULL, 10);
+                break;
+            case 'f':
+                forever = TRUE;
+                break;
+            case 't':
+                test_mode = TRUE;
+                break;
+            default:
+                fprintf(stderr,
+                  "Usage: %s [-k <size>] [-b] [-c] [-x] [-l <adr>] [-g <adr>] [-d <slot>] [-f] [-t] file\n",
+                  argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (eeprom_geometry(size, &page_size, &address_bits) != 0) {
+       fprintf(stderr, "Invalid size. Known sizes: 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048 Kibit\n");
+       exit(EXIT_FAILURE);
+    }
+    eeprom_size = size * 1024 / 8;
+    if (eeprom_size <= DIR_SIZE) {
+       fprintf(stderr, "EEPROM too small for the boot directory.\n");
+       exit(EXIT_FAILURE);
+    }
+    if (slot_number < 0 || slot_number >= DIR_SLOTS) {
+       fprintf(stderr, "Invalid slot, choose 0 to %d.\n", DIR_SLOTS - 1);
+       exit(EXIT_FAILURE);
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "No file\n");
+        exit(EXIT_FAILURE);
+    }
+    fp = fopen(argv[optind], "rb");
+    if (fp == NULL) {
+        perror(argv[optind]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (boot_mode) {
+        // boot_file closes the file
+        image = boot_file(fp, compress_mode, hex_mode, load_adr, entry,
+                          &image_len);
+        if (image == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        mem = virtual_eeprom(image, image_len, eeprom_size);
+        free(image);
+    } else {
+        mem = load_file(fp, eeprom_size);
+        fclose(fp);
+    }
+    if (mem == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    spi_slave_init(&slave, mem, eeprom_size, address_bits);
+
+    if (test_mode) {
+        exit(self_test(&slave, slot_number) == 0 ? EXIT_SUCCESS
+                                                 : EXIT_FAILURE);
+    }
+
+    if (init_port_mode() != 0) {
+        // can't init ports
+        exit(EXIT_FAILURE);
+    }
+    if (init_port_level() != 0) {
+        // can't init ports
+        exit(EXIT_FAILURE);
+    }
+    // the data switches select the slot, MISO idle
+    write_byte(slot_number);
+    digitalWrite(IN_N, 1);
+    // the loader writes the memory
+    digitalWrite(WRITE_N, 0);
+    // run (init_port_level leaves the Elf in reset)
+    digitalWrite(WAIT_N, 1);
+    usleep(100);
+    digitalWrite(CLEAR_N, 1);
+
+    fprintf(stderr, "Waiting for the boot loader, slot %d\n", slot_number);
+    start_time = seconds();
+    boots = serve(&slave, forever);
+    digitalWrite(IN_N, 1);
+
+    fprintf(stderr, "%lu boot(s), %lu READ commands, %lu bytes, %.2f s\n",
+            boots, slave.reads, slave.bytes, seconds() - start_time);
+    exit(EXIT_SUCCESS);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  load_file
+ */
+/**
+ *  @brief
+ *      Reads an EEPROM image, the rest of the EEPROM is erased (0xFF)
+ *  @param
+ *      in          EEPROM image
+ *  @param
+ *      size        EEPROM size in bytes
+ *  @return
+ *      uint8_t*    EEPROM content, NULL on error
+ */
+/* ===================================================================*/
+uint8_t *load_file(FILE *in, uint32_t size) {
+    uint8_t *mem;
+    size_t len;
+
+    mem = malloc(size + 1);
+    if (mem == NULL) {
+        return NULL;
+    }
+    memset(mem, 0xFF, size);
+    len = fread(mem, 1, size + 1, in);
+    if (len > size) {
+        fprintf(stderr, "File is larger than the EEPROM (-k)\n");
+        free(mem);
+        return NULL;
+    }
+    return mem;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  virtual_eeprom
+ */
+/**
+ *  @brief
+ *      Builds the EEPROM content with the boot image behind the
+ *      directory, every slot points to the image
+ *  @param
+ *      image       boot image
+ *  @param
+ *      image_len   size of the boot image
+ *  @param
+ *      size        EEPROM size in bytes
+ *  @return
+ *      uint8_t*    EEPROM content, NULL on error
+ */
+/* ===================================================================*/
+uint8_t *virtual_eeprom(const uint8_t *image, uint32_t image_len,
+                        uint32_t size) {
+    boot_slot_t slot;
+    uint8_t *mem;
+    int i;
+
+    if (DIR_SIZE + image_len > size) {
+        fprintf(stderr, "Boot image does not fit in the EEPROM (-k)\n");
+        return NULL;
+    }
+    mem = malloc(size);
+    if (mem == NULL) {
+        return NULL;
+    }
+    memset(mem, 0xFF, size);
+    memset(&slot, 0, sizeof(slot));
+    slot.offset = DIR_SIZE;
+    slot.len = image_len;
+    strncpy(slot.name, "elfboot", DIR_NAME_SIZE);
+    for (i = 0; i < DIR_SLOTS; i++) {
+        encode_dir_entry(&slot, &mem[DIR_ADR + i * DIR_ENTRY_SIZE]);
+    }
+    memcpy(&mem[DIR_SIZE], image, image_len);
+    return mem;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  serve
+ */
+/**
+ *  @brief
+ *      Answers the boot loader on the GPIO pins. The loop polls CS and
+ *      CLK, MOSI is read only on a change. A boot is complete when CS
+ *      goes inactive after the second READ command (directory entry and
+ *      boot image).
+ *  @param
+ *      s           slave
+ *  @param
+ *      forever     TRUE serve the next boot, until interrupted
+ *  @return
+ *      unsigned long number of boots
+ */
+/* ===================================================================*/
+unsigned long serve(spi_slave_t *s, int forever) {
+    unsigned long boots = 0;
+    unsigned long reads = 0;
+    int cs = 1;
+    int clk = 0;
+    int new_cs;
+    int new_clk;
+    int miso = 1;
+    int level = 1;
+
+    // no page faults and no other task between two edges
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        perror("mlockall");
+    }
+    if (piHiPri(99) != 0) {
+        fprintf(stderr, "No real-time priority, run as root\n");
+    }
+
+    for (;;) {
+        new_cs = digitalRead(INPUT_5);
+        new_clk = digitalRead(INPUT_6);
+        if (new_cs == cs && new_clk == clk) {
+            continue;
+        }
+        miso = spi_slave_clock(s, new_cs, new_clk, digitalRead(INPUT_7));
+        if (miso != level) {
+            digitalWrite(IN_N, miso);
+            level = miso;
+        }
+        if (new_cs && !cs && s->reads - reads >= 2) {
+            reads = s->reads;
+            boots++;
+            fprintf(stderr, "Boot %lu, %lu bytes\n", boots, s->bytes);
+            if (!forever) {
+                break;
+            }
+        }
+        cs = new_cs;
+        clk = new_clk;
+    }
+    return boots;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  self_test
+ */
+/**
+ *  @brief
+ *      Boots from the slave with the bit sequence of the DB25 loader and
+ *      compares the loaded memory with the image in the EEPROM content
+ *  @param
+ *      s           slave
+ *  @param
+ *      slot_number boot slot (data switches)
+ *  @return
+ *      int         0 ok, -1 error
+ */
+/* ===================================================================*/
+int self_test(spi_slave_t *s, int slot_number) {
+    static uint8_t elf_mem[MEMORY_SIZE];
+    static uint8_t check_mem[MEMORY_SIZE];
+    uint8_t entry_raw[DIR_ENTRY_SIZE];
+    boot_slot_t slot;
+    uint8_t *image;
+    uint16_t entry;
+    uint16_t check_entry;
+    uint32_t i;
+    int len;
+
+    // directory entry, like the loader (only the offset) and the length
+    loader_command(s, DIR_ADR + slot_number * DIR_ENTRY_SIZE);
+    for (i = 0; i < DIR_ENTRY_SIZE; i++) {
+        entry_raw[i] = loader_read(s);
+    }
+    if (entry_raw[0] == 0xFF) {
+        fprintf(stderr, "Slot %d is empty\n", slot_number);
+        return -1;
+    }
+    memset(&slot, 0, sizeof(slot));
+    slot.offset = (uint32_t) entry_raw[0] << 16 | entry_raw[1] << 8 |
+                  entry_raw[2];
+    slot.len = (uint32_t) entry_raw[3] << 16 | entry_raw[4] << 8 |
+               entry_raw[5];
+    if (slot.len == 0 || slot.offset + slot.len > s->size) {
+        fprintf(stderr, "Invalid directory entry of slot %d\n", slot_number);
+        return -1;
+    }
+
+    // boot image
+    image = malloc(slot.len);
+    if (image == NULL) {
+        return -1;
+    }
+    loader_command(s, slot.offset);
+    for (i = 0; i < slot.len; i++) {
+        image[i] = loader_read(s);
+    }
+    loader_port(s, PORT_CS);
+
+    len = load_boot_image(image, slot.len, elf_mem, &entry);
+    free(image);
+    if (len < 0 ||
+        load_boot_image(&s->mem[slot.offset], slot.len, check_mem,
+                        &check_entry) != len ||
+        entry != check_entry ||
+        memcmp(elf_mem, check_mem, sizeof(elf_mem)) != 0) {
+        fprintf(stderr, "Self test failed\n");
+        return -1;
+    }
+    fprintf(stderr, "Slot %d at 0x%05x, entry 0x%04x, 0x%04x bytes, "
+            "%lu READ commands, %lu OUT 4\n",
+            slot_number, slot.offset, entry, len, s->reads, loader_outs);
+    return 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  loader_port
+ */
+/**
+ *  @brief
+ *      OUT 4 of the boot loader, the EF4 level is latched
+ *  @param
+ *      s           slave
+ *  @param
+ *      out         port byte
+ *  @return
+ *      int         MISO level
+ */
+/* ===================================================================*/
+int loader_port(spi_slave_t *s, uint8_t out) {
+    loader_outs++;
+    loader_miso = spi_slave_clock(s, (out & PORT_CS) != 0,
+                                  (out & PORT_CLK) != 0,
+                                  (out & PORT_MOSI) != 0);
+    return loader_miso;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  loader_write
+ */
+/**
+ *  @brief
+ *      WRITEBYTE of the boot loader: data bit with clock off, clock on,
+ *      clock off
+ *  @param
+ *      s           slave
+ *  @param
+ *      byte        data
+ */
+/* ===================================================================*/
+void loader_write(spi_slave_t *s, uint8_t byte) {
+    uint8_t out;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        out = byte & 0x80 ? PORT_MOSI : 0;
+        loader_port(s, out);
+        loader_port(s, out | PORT_CLK);
+        loader_port(s, out);
+        byte <<= 1;
+    }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  loader_read
+ */
+/**
+ *  @brief
+ *      READBYTE of the boot loader: EF4 is sampled before the clock on
+ *  @param
+ *      s           slave
+ *  @return
+ *      uint8_t     data
+ */
+/* ===================================================================*/
+uint8_t loader_read(spi_slave_t *s) {
+    uint8_t byte = 0;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        byte = byte << 1 | loader_miso;
+        loader_port(s, PORT_CLK);
+        loader_port(s, 0);
+    }
+    return byte;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  loader_command
+ */
+/**
+ *  @brief
+ *      READCMD of the boot loader: CS cycle, READ command and address
+ *  @param
+ *      s           slave
+ *  @param
+ *      adr         EEPROM address
+ */
+/* ===================================================================*/
+void loader_command(spi_slave_t *s, uint32_t adr) {
+    int i;
+
+    loader_port(s, PORT_CS);
+    loader_port(s, 0);
+    loader_write(s, READ_CMD);
+    for (i = s->address_bits - 8; i >= 0; i -= 8) {
+        loader_write(s, adr >> i);
+    }
+}
+
+double seconds(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
@@ -0,0 +1,375 @@
+/**
+ *  @brief
+ *      Image manifest in the last bytes of the EEPROM.
+ *
+ *      CRC32 and the entries of the manifest (see manifest.h), read and
+ *      write of the manifest of a chip.
+ *
+ *  @file
+ *      manifest.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "eeprom.h"
+#include "eeprom_io.h"
+#include "manifest.h"
+
+#define CRC32_POLY      (0xEDB88320)
+
+static uint32_t crc_table[256];
+
+static void decode_entry(const uint8_t *raw, manifest_entry_t *entry) {
+  entry->start = raw[1] << 16 | raw[2] << 8 | raw[3];
+  entry->len = raw[4] << 16 | raw[5] << 8 | raw[6];
+  entry->crc = (uint32_t) raw[7] << 24 | raw[8] << 16 | raw[9] << 8 | raw[10];
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  crc32_update
+ */
+/**
+ *  @brief
+ *      CRC32 (IEEE 802.3, like zlib), start with crc 0
+ *  @param
+ *      crc         CRC of the previous data
+ *  @param
+ *      data        data
+ *  @param
+ *      len         number of bytes
+ *  @return
+ *      uint32_t    CRC including the data
+ */
+/* ===================================================================*/
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len) {
+  uint32_t c;
+  uint32_t i;
+  int k;
+
+  if (crc_table[1] == 0) {
+    for (i = 0; i < 256; i++) {
+      c = i;
+      for (k = 0; k < 8; k++) {
+	c = c & 1 ? CRC32_POLY ^ c >> 1 : c >> 1;
+      }
+      crc_table[i] = c;
+    }
+  }
+  crc = ~crc;
+  for (i = 0; i < len; i++) {
+    crc = crc_table[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+  }
+  return ~crc;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_find
+ */
+/**
+ *  @brief
+ *      Looks up the entry of the range starting at an address
+ *  @param
+ *      raw         MANIFEST_SIZE bytes read from the EEPROM
+ *  @param
+ *      start       start address of the range
+ *  @param
+ *      entry[out]  the entry found
+ *  @return
+ *      int         0 found, -1 no entry
+ */
+/* ===================================================================*/
+int manifest_find(const uint8_t *raw, uint32_t start, manifest_entry_t *entry) {
+  int i;
+
+  for (i = 0; i < MANIFEST_ENTRIES; i++, raw += MANIFEST_ENTRY_SIZE) {
+    if (raw[0] != MANIFEST_TAG) {
+      continue;
+    }
+    decode_entry(raw, entry);
+    if (entry->start == start) {
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_entries
+ */
+/**
+ *  @brief
+ *      Counts the entries. Each entry is erased (0xFF) or an entry with
+ *      the tag and erased padding, other bytes are no manifest (e.g. the
+ *      data of a write without manifest).
+ *  @param
+ *      raw         MANIFEST_SIZE bytes read from the EEPROM
+ *  @return
+ *      int         number of entries, -1 no manifest
+ */
+/* ===================================================================*/
+int manifest_entries(const uint8_t *raw) {
+  int entries = 0;
+  int i, j;
+
+  for (i = 0; i < MANIFEST_ENTRIES; i++, raw += MANIFEST_ENTRY_SIZE) {
+    for (j = raw[0] == MANIFEST_TAG ? 11 : 0; j < MANIFEST_ENTRY_SIZE; j++) {
+      if (raw[j] != 0xFF) {
+        return -1;
+      }
+    }
+    if (raw[0] == MANIFEST_TAG) {
+      entries++;
+    }
+  }
+  return entries;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_remove
+ */
+/**
+ *  @brief
+ *      Erases the entries of all ranges overlapping an address range
+ *  @param
+ *      raw         MANIFEST_SIZE bytes
+ *  @param
+ *      start       first address
+ *  @param
+ *      end         last address
+ *  @return
+ *      int         number of entries erased
+ */
+/* ===================================================================*/
+int manifest_remove(uint8_t *raw, uint32_t start, uint32_t end) {
+  manifest_entry_t entry;
+  int removed = 0;
+  int i;
+
+  for (i = 0; i < MANIFEST_ENTRIES; i++, raw += MANIFEST_ENTRY_SIZE) {
+    if (raw[0] != MANIFEST_TAG) {
+      continue;
+    }
+    decode_entry(raw, &entry);
+    if (entry.start <= end && start < entry.start + entry.len) {
+      memset(raw, 0xFF, MANIFEST_ENTRY_SIZE);
+      removed++;
+    }
+  }
+  return removed;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_add
+ */
+/**
+ *  @brief
+ *      Stores an entry, replaces the overlapping entries. When the 
+ *      manifest is full the first entry is dropped.
+ *  @param
+ *      raw         MANIFEST_SIZE bytes
+ *  @param
+ *      entry       new entry
+ */
+/* ===================================================================*/
+void manifest_add(uint8_t *raw, const manifest_entry_t *entry) {
+  uint8_t *p;
+  int i;
+
+  manifest_remove(raw, entry->start, entry->start + entry->len - 1);
+  for (i = 0; i < MANIFEST_ENTRIES; i++) {
+    if (raw[i * MANIFEST_ENTRY_SIZE] != MANIFEST_TAG) {
+      break;
+    }
+  }
+  if (i == MANIFEST_ENTRIES) {
+    memmove(raw, raw + MANIFEST_ENTRY_SIZE, MANIFEST_SIZE - MANIFEST_ENTRY_SIZE);
+    i = MANIFEST_ENTRIES - 1;
+  }
+  p = raw + i * MANIFEST_ENTRY_SIZE;
+  memset(p, 0xFF, MANIFEST_ENTRY_SIZE);
+  p[0] = MANIFEST_TAG;
+  p[1] = entry->start >> 16;
+  p[2] = entry->start >> 8;
+  p[3] = entry->start;
+  p[4] = entry->len >> 16;
+  p[5] = entry->len >> 8;
+  p[6] = entry->len;
+  p[7] = entry->crc >> 24;
+  p[8] = entry->crc >> 16;
+  p[9] = entry->crc >> 8;
+  p[10] = entry->crc;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_reserved
+ */
+/**
+ *  @brief
+ *      First address reserved for the manifest, the data ends below.
+ *      A flash reserves the last sector (erased for each write).
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      flash       SPI NOR flash
+ *  @return
+ *      uint32_t    first reserved address, eeprom_size too small for a 
+ *                  manifest
+ */
+/* ===================================================================*/
+uint32_t manifest_reserved(uint32_t eeprom_size, uint8_t flash) {
+  if (eeprom_size < 2 * MANIFEST_SIZE) {
+    return eeprom_size;
+  }
+  return flash ? eeprom_size - FLASH_SECTOR : eeprom_size - MANIFEST_SIZE;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_read
+ */
+/**
+ *  @brief
+ *      Reads the manifest of a chip
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits EEPROM address bits
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      raw[out]    MANIFEST_SIZE bytes
+ *  @return
+ *      int         number of bytes read, -1 on error
+ */
+/* ===================================================================*/
+int manifest_read(int channel, uint8_t address_bits, uint32_t eeprom_size,
+                  uint8_t *raw) {
+  return read_eeprom(channel, address_bits, eeprom_size - MANIFEST_SIZE, raw,
+                     MANIFEST_SIZE);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_write
+ */
+/**
+ *  @brief
+ *      Writes the manifest of a chip, the sector of a flash is erased
+ *      first
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits EEPROM address bits
+ *  @param
+ *      page_size   EEPROM page size
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      flash       SPI NOR flash
+ *  @param
+ *      raw         MANIFEST_SIZE bytes
+ */
+/* ===================================================================*/
+void manifest_write(int channel, uint8_t address_bits, uint16_t page_size,
+                    uint32_t eeprom_size, uint8_t flash, const uint8_t *raw) {
+  uint8_t buf[HEADER_SIZE + MANIFEST_SIZE];
+  eeprom_page_t page;
+  uint16_t chunk = page_size < MANIFEST_SIZE ? page_size : MANIFEST_SIZE;
+  uint32_t a;
+
+  write_cycle_wait(channel);
+  if (flash) {
+    erase_start(channel, SECTOR_ERASE_CMD, eeprom_size - FLASH_SECTOR);
+    write_cycle_wait(channel);
+  }
+  page.buf = buf;
+  page.data = &buf[HEADER_SIZE];
+  page.count = chunk;
+  for (a = 0; a < MANIFEST_SIZE; a += chunk) {
+    memcpy(page.data, &raw[a], chunk);
+    page.adr = eeprom_size - MANIFEST_SIZE + a;
+    write_page_start(channel, address_bits, &page);
+    write_cycle_wait(channel);
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_clear
+ */
+/**
+ *  @brief
+ *      Reads the manifest of a chip and erases the entries of the ranges
+ *      overlapping an address range. The manifest is written back when
+ *      an entry was erased, bytes that are no manifest are not written
+ *      (raw is cleared). Called before the first page of the range
+ *      is written, an interrupted run leaves no stale entry.
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits EEPROM address bits
+ *  @param
+ *      page_size   EEPROM page size
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      flash       SPI NOR flash
+ *  @param
+ *      raw[out]    MANIFEST_SIZE bytes, the manifest of the chip
+ *  @param
+ *      start       first address
+ *  @param
+ *      end         last address
+ *  @return
+ *      int         number of entries erased
+ */
+/* ===================================================================*/
+int manifest_clear(int channel, uint8_t address_bits, uint16_t page_size,
+                   uint32_t eeprom_size, uint8_t flash, uint8_t *raw,
+                   uint32_t start, uint32_t end) {
+  uint32_t limit = manifest_reserved(eeprom_size, flash);
+  int removed;
+
+  manifest_read(channel, address_bits, eeprom_size, raw);
+  if (manifest_entries(raw) < 0) {
+    // other data, a new manifest starts empty
+    memset(raw, 0xFF, MANIFEST_SIZE);
+    return 0;
+  }
+  removed = manifest_remove(raw, start, end < limit ? end : limit - 1);
+  if (removed > 0) {
+    manifest_write(channel, address_bits, page_size, eeprom_size, flash, raw);
+  }
+  return removed;
+}
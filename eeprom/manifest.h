@@ -0,0 +1,248 @@
+/**
+ *  @brief
+ *      Image manifest in the last bytes of the EEPROM.
+ *
+ *      bin2eeprom records the start address, the length and the CRC32 of
+ *      each range it writes. A check reads only the manifest and compares
+ *      it with the file, an unchanged image is neither written nor read
+ *      back. The manifest has 8 entries of 16 bytes:
+ *
+ *      'M' <start 23..0> <len 23..0> <crc32 31..0> <5 bytes FF>
+ *
+ *      Erased entries start with FF. The manifest is at the end of the
+ *      EEPROM (the last sector of a flash is reserved for it), a range
+ *      overlapping the manifest has no entry.
+ *
+ *  @file
+ *      manifest.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MANIFEST_H_
+#define MANIFEST_H_
+
+#define MANIFEST_ENTRIES    (8)
+#define MANIFEST_ENTRY_SIZE (16)
+#define MANIFEST_SIZE       (MANIFEST_ENTRIES * MANIFEST_ENTRY_SIZE)
+#define MANIFEST_TAG        ('M')
+
+typedef struct {
+  uint32_t start;
+  uint32_t len;
+  uint32_t crc;
+} manifest_entry_t;
+
+/*
+ ** ===================================================================
+ **  Method      :  crc32_update
+ */
+/**
+ *  @brief
+ *      CRC32 (IEEE 802.3, like zlib), start with crc 0
+ *  @param
+ *      crc         CRC of the previous data
+ *  @param
+ *      data        data
+ *  @param
+ *      len         number of bytes
+ *  @return
+ *      uint32_t    CRC including the data
+ */
+/* ===================================================================*/
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len);
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_find
+ */
+/**
+ *  @brief
+ *      Looks up the entry of the range starting at an address
+ *  @param
+ *      raw         MANIFEST_SIZE bytes read from the EEPROM
+ *  @param
+ *      start       start address of the range
+ *  @param
+ *      entry[out]  the entry found
+ *  @return
+ *      int         0 found, -1 no entry
+ */
+/* ===================================================================*/
+int manifest_find(const uint8_t *raw, uint32_t start, manifest_entry_t *entry);
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_entries
+ */
+/**
+ *  @brief
+ *      Counts the entries. Each entry is erased (0xFF) or an entry with
+ *      the tag and erased padding, other bytes are no manifest (e.g. the
+ *      data of a write without manifest).
+ *  @param
+ *      raw         MANIFEST_SIZE bytes read from the EEPROM
+ *  @return
+ *      int         number of entries, -1 no manifest
+ */
+/* ===================================================================*/
+int manifest_entries(const uint8_t *raw);
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_remove
+ */
+/**
+ *  @brief
+ *      Erases the entries of all ranges overlapping an address range
+ *  @param
+ *      raw         MANIFEST_SIZE bytes
+ *  @param
+ *      start       first address
+ *  @param
+ *      end         last address
+ *  @return
+ *      int         number of entries erased
+ */
+/* ===================================================================*/
+int manifest_remove(uint8_t *raw, uint32_t start, uint32_t end);
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_add
+ */
+/**
+ *  @brief
+ *      Stores an entry, replaces the overlapping entries. When the 
+ *      manifest is full the first entry is dropped.
+ *  @param
+ *      raw         MANIFEST_SIZE bytes
+ *  @param
+ *      entry       new entry
+ */
+/* ===================================================================*/
+void manifest_add(uint8_t *raw, const manifest_entry_t *entry);
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_reserved
+ */
+/**
+ *  @brief
+ *      First address reserved for the manifest, the data ends below.
+ *      A flash reserves the last sector (erased for each write).
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      flash       SPI NOR flash
+ *  @return
+ *      uint32_t    first reserved address, eeprom_size too small for a 
+ *                  manifest
+ */
+/* ===================================================================*/
+uint32_t manifest_reserved(uint32_t eeprom_size, uint8_t flash);
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_read
+ */
+/**
+ *  @brief
+ *      Reads the manifest of a chip
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits EEPROM address bits
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      raw[out]    MANIFEST_SIZE bytes
+ *  @return
+ *      int         number of bytes read, -1 on error
+ */
+/* ===================================================================*/
+int manifest_read(int channel, uint8_t address_bits, uint32_t eeprom_size,
+                  uint8_t *raw);
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_write
+ */
+/**
+ *  @brief
+ *      Writes the manifest of a chip, the sector of a flash is erased
+ *      first
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits EEPROM address bits
+ *  @param
+ *      page_size   EEPROM page size
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      flash       SPI NOR flash
+ *  @param
+ *      raw         MANIFEST_SIZE bytes
+ */
+/* ===================================================================*/
+void manifest_write(int channel, uint8_t address_bits, uint16_t page_size,
+                    uint32_t eeprom_size, uint8_t flash, const uint8_t *raw);
+
+/*
+ ** ===================================================================
+ **  Method      :  manifest_clear
+ */
+/**
+ *  @brief
+ *      Reads the manifest of a chip and erases the entries of the ranges
+ *      overlapping an address range. The manifest is written back when
+ *      an entry was erased, bytes that are no manifest are not written
+ *      (raw is cleared). Called before the first page of the range
+ *      is written, an interrupted run leaves no stale entry.
+ *  @param
+ *      channel     SPI chip select
+ *  @param
+ *      address_bits EEPROM address bits
+ *  @param
+ *      page_size   EEPROM page size
+ *  @param
+ *      eeprom_size EEPROM size in bytes
+ *  @param
+ *      flash       SPI NOR flash
+ *  @param
+ *      raw[out]    MANIFEST_SIZE bytes, the manifest of the chip
+ *  @param
+ *      start       first address
+ *  @param
+ *      end         last address
+ *  @return
+ *      int         number of entries erased
+ */
+/* ===================================================================*/
+int manifest_clear(int channel, uint8_t address_bits, uint16_t page_size,
+                   uint32_t eeprom_size, uint8_t flash, uint8_t *raw,
+                   uint32_t start, uint32_t end);
+
+#endif /* MANIFEST_H_ */
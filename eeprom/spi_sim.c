@@ -0,0 +1,452 @@
+/**
+ *  @brief
+ *      Software stand-in for the wiringPi SPI layer with a 25xx SPI EEPROM
+ *      behind it.
+ *
+ *      Implements READ, WRITE, WREN, WRDI, RDSR and WRSR of the Microchip
+ *      25xx family: write enable latch, block protect bits, page wrap
+ *      for writes, wrap at the end of the memory for reads and the
+ *      write-in-process bit for the write cycle time. While a write cycle
+ *      is in process only RDSR is accepted (like the real chip).
+ *      With EEPROM_SIM_FLASH it is a W25Qxx SPI NOR flash with JEDEC ID,
+ *      FAST_READ, sector and block erase.
+ *
+ *      Each transfer takes as long as the real SPI transfer at the given
+ *      clock speed, the write cycle runs in real time. Therefore the
+ *      transfer time of the tools can be measured with time(1).
+ *
+ *  @file
+ *      spi_sim.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "eeprom.h"
+#include "spi_sim.h"
+#include "sim_bench.h"
+
+#define CHANNELS        2
+#define DEFAULT_IMAGE   "eeprom-ce%d.bin"
+#define DEFAULT_TWC     5000
+// W25Q typical page program and erase times
+#define FLASH_TPP       700
+#define FLASH_TSE       45000
+#define FLASH_TBE       150000
+
+// status register bits
+#define WRITE_ENABLE_LATCH  (0x02)
+#define BLOCK_PROTECT       (0x0C)
+
+typedef struct {
+  uint8_t *mem;
+  uint32_t size;
+  uint16_t page_size;
+  uint8_t address_bits;
+  uint8_t status;
+  uint8_t flash;
+  uint8_t id[3];
+  int speed;
+  int fd;
+  struct timespec busy_until;
+  // statistics
+  unsigned long transfers;
+  unsigned long bytes;
+  unsigned long write_cycles;
+  unsigned long erases;
+  unsigned long status_polls;
+  unsigned long ignored;
+} sim_eeprom_t;
+
+static sim_eeprom_t eeprom[CHANNELS];
+static long write_cycle_us = DEFAULT_TWC;
+static int print_stats = FALSE;
+static struct timespec start_time;
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_bench_t *bench = NULL;
+static uint64_t data_time = 0;
+
+
+static long long ns_since(const struct timespec *t) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - t->tv_sec) * 1000000000LL + (now.tv_nsec - t->tv_nsec);
+}
+
+static void add_us(struct timespec *t, long us) {
+  clock_gettime(CLOCK_MONOTONIC, t);
+  t->tv_nsec += us * 1000L;
+  t->tv_sec += t->tv_nsec / 1000000000L;
+  t->tv_nsec %= 1000000000L;
+}
+
+static int write_in_process(sim_eeprom_t *e) {
+  return ns_since(&e->busy_until) < 0;
+}
+
+static void exit_stats(void) {
+  int ch;
+
+  for (ch = 0; ch < CHANNELS; ch++) {
+    if (eeprom[ch].mem == NULL) {
+      continue;
+    }
+    msync(eeprom[ch].mem, eeprom[ch].size, MS_SYNC);
+    if (print_stats) {
+      fprintf(stderr,
+	      "spi_sim ce%d: %lu transfers, %lu bytes, %lu write cycles, "
+	      "%lu erases, %lu status polls, %lu ignored, %.3f s\n",
+	      ch, eeprom[ch].transfers, eeprom[ch].bytes,
+	      eeprom[ch].write_cycles, eeprom[ch].erases, eeprom[ch].status_polls,
+	      eeprom[ch].ignored, ns_since(&start_time) / 1e9);
+    }
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  protected
+ */
+/**
+ *  @brief
+ *      Checks the address against the block protect bits
+ *      (BP1:BP0 01 upper 1/4, 10 upper 1/2, 11 all)
+ */
+/* ===================================================================*/
+static int protected(sim_eeprom_t *e, uint32_t adr) {
+  if (e->flash) {
+    // the flash protection bits are not simulated
+    return FALSE;
+  }
+  switch ((e->status & BLOCK_PROTECT) >> 2) {
+  case 1:
+    return adr >= e->size - e->size / 4;
+  case 2:
+    return adr >= e->size / 2;
+  case 3:
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static void set_geometry(sim_eeprom_t *e, uint32_t kibit) {
+  e->size = kibit * 1024 / 8;
+  if (kibit <= 2) {
+    e->address_bits = 8;
+    e->page_size = 16;
+  } else if (kibit <= 16) {
+    e->address_bits = 16;
+    e->page_size = 16;
+  } else if (kibit <= 64) {
+    e->address_bits = 16;
+    e->page_size = 32;
+  } else if (kibit <= 256) {
+    e->address_bits = 16;
+    e->page_size = 64;
+  } else if (kibit <= 512) {
+    e->address_bits = 16;
+    e->page_size = 256;
+  } else {
+    e->address_bits = 24;
+    e->page_size = 256;
+  }
+}
+
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiSPISetup
+ */
+/**
+ *  @brief
+ *      Opens (creates) and maps the EEPROM image for the channel
+ *  @param
+ *      channel     chip select 0 or 1
+ *  @param
+ *      speed       SPI clock in Hz, used for the transfer timing
+ *  @return
+ *      int         file descriptor of the image, -1 on error
+ */
+/* ===================================================================*/
+int wiringPiSPISetup(int channel, int speed) {
+  sim_eeprom_t *e;
+  char filename[256];
+  const char *env;
+  struct stat st;
+  uint32_t kibit = 1024;
+  unsigned long id;
+
+  if (channel < 0 || channel >= CHANNELS || speed <= 0) {
+    return -1;
+  }
+  e = &eeprom[channel];
+  env = getenv("EEPROM_SIM_IMAGE");
+  snprintf(filename, sizeof(filename), env ? env : DEFAULT_IMAGE, channel);
+  if (e->mem != NULL) {
+    // opened again with another clock, like spidev a new descriptor,
+    // the mapping stays
+    e->speed = speed;
+    e->fd = open(filename, O_RDWR);
+    return e->fd;
+  }
+
+  if ((env = getenv("EEPROM_SIM_SIZE")) != NULL) {
+    kibit = strtol(env, NULL, 10);
+  }
+  if ((env = getenv("EEPROM_SIM_TWC")) != NULL) {
+    write_cycle_us = strtol(env, NULL, 10);
+  }
+  print_stats = getenv("EEPROM_SIM_STATS") != NULL;
+  set_geometry(e, kibit);
+  if ((env = getenv("EEPROM_SIM_FLASH")) != NULL) {
+    id = strtoul(env, NULL, 16);
+    e->flash = TRUE;
+    e->id[0] = id >> 16;
+    e->id[1] = id >> 8;
+    e->id[2] = id;
+    e->size = 1UL << (e->id[2] & 0x1F);
+    e->address_bits = 24;
+    e->page_size = FLASH_PAGE_SIZE;
+    if (getenv("EEPROM_SIM_TWC") == NULL) {
+      write_cycle_us = FLASH_TPP;
+    }
+  }
+  e->speed = speed;
+
+  e->fd = open(filename, O_RDWR | O_CREAT, 0644);
+  if (e->fd < 0 || fstat(e->fd, &st) < 0) {
+    return -1;
+  }
+  if (st.st_size < e->size && ftruncate(e->fd, e->size) < 0) {
+    return -1;
+  }
+  e->mem = mmap(NULL, e->size, PROT_READ | PROT_WRITE, MAP_SHARED, e->fd, 0);
+  if (e->mem == MAP_FAILED) {
+    e->mem = NULL;
+    return -1;
+  }
+  if (st.st_size < e->size) {
+    // new cells are erased
+    memset(e->mem + st.st_size, 0xFF, e->size - st.st_size);
+  }
+
+  if (start_time.tv_sec == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    atexit(exit_stats);
+    bench = sim_bench_open("spi");
+  }
+  return e->fd;
+}
+
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiSPIDataRW
+ */
+/**
+ *  @brief
+ *      Full duplex transfer, one chip select cycle. The buffer is
+ *      overwritten with the bytes clocked out of the EEPROM.
+ *  @param
+ *      channel     chip select 0 or 1
+ *  @param
+ *      data        transmit and receive buffer
+ *  @param
+ *      len         number of bytes
+ *  @return
+ *      int         len, -1 on error
+ */
+/* ===================================================================*/
+int wiringPiSPIDataRW(int channel, unsigned char *data, int len) {
+  sim_eeprom_t *e;
+  struct timespec transfer;
+  long long transfer_ns;
+  uint32_t adr = 0;
+  uint32_t page;
+  int address_bytes;
+  int data_bytes = -1;
+  int i;
+  uint8_t cmd;
+  uint64_t now;
+
+  if (channel < 0 || channel >= CHANNELS || eeprom[channel].mem == NULL) {
+    return -1;
+  }
+  if (len <= 0) {
+    return len;
+  }
+  e = &eeprom[channel];
+  address_bytes = e->address_bits / 8;
+
+  // the bus is busy for the whole transfer, the write cycles of
+  // different chips run in parallel
+  pthread_mutex_lock(&bus_lock);
+  transfer_ns = (long long) len * 8 * 1000000000LL / e->speed;
+  transfer.tv_sec = transfer_ns / 1000000000LL;
+  transfer.tv_nsec = transfer_ns % 1000000000LL;
+  nanosleep(&transfer, NULL);
+
+  e->transfers++;
+  e->bytes += len;
+  cmd = data[0];
+  data[0] = 0xFF;
+
+  if (cmd == RDSR_CMD) {
+    e->status_polls++;
+    for (i = 1; i < len; i++) {
+      data[i] = e->status | (write_in_process(e) ? WRITE_IN_PROCESS : 0);
+    }
+    pthread_mutex_unlock(&bus_lock);
+    return len;
+  }
+
+  if (write_in_process(e)) {
+    // only RDSR is accepted during the write cycle
+    e->ignored++;
+    memset(data, 0xFF, len);
+    pthread_mutex_unlock(&bus_lock);
+    return len;
+  }
+
+  if (cmd == READ_CMD || cmd == WRITE_CMD || (e->flash && 
+      (cmd == FAST_READ_CMD || cmd == SECTOR_ERASE_CMD || 
+       cmd == BLOCK_ERASE_CMD))) {
+    for (i = 1; i <= address_bytes && i < len; i++) {
+      adr = adr << 8 | data[i];
+      data[i] = 0xFF;
+    }
+    adr %= e->size;
+  }
+
+  switch (cmd) {
+  case WREN_CMD:
+    e->status |= WRITE_ENABLE_LATCH;
+    break;
+  case WRDI_CMD:
+    e->status &= ~WRITE_ENABLE_LATCH;
+    break;
+  case WRSR_CMD:
+    if (len > 1 && (e->status & WRITE_ENABLE_LATCH)) {
+      e->status = data[1] & BLOCK_PROTECT;
+      e->write_cycles++;
+      add_us(&e->busy_until, write_cycle_us);
+    }
+    data[1] = 0xFF;
+    break;
+  case READ_CMD:
+    // sequential read wraps at the end of the memory
+    for (i = 1 + address_bytes; i < len; i++) {
+      data[i] = e->mem[adr];
+      adr = (adr + 1) % e->size;
+    }
+    data_bytes = len - 1 - address_bytes;
+    break;
+  case FAST_READ_CMD:
+    if (!e->flash) {
+      e->ignored++;
+      memset(data, 0xFF, len);
+      break;
+    }
+    // a dummy byte after the address
+    for (i = 2 + address_bytes; i < len; i++) {
+      data[i] = e->mem[adr];
+      adr = (adr + 1) % e->size;
+    }
+    data_bytes = len - 2 - address_bytes;
+    break;
+  case JEDEC_ID_CMD:
+    memset(data, 0xFF, len);
+    if (!e->flash) {
+      e->ignored++;
+      break;
+    }
+    for (i = 1; i < len && i <= 3; i++) {
+      data[i] = e->id[i - 1];
+    }
+    break;
+  case SECTOR_ERASE_CMD:
+  case BLOCK_ERASE_CMD:
+    if (!e->flash || !(e->status & WRITE_ENABLE_LATCH) || 
+	len < 1 + address_bytes) {
+      e->ignored++;
+      memset(data, 0xFF, len);
+    } else {
+      page = cmd == SECTOR_ERASE_CMD ? FLASH_SECTOR : FLASH_BLOCK;
+      memset(e->mem + adr - adr % page, 0xFF, page);
+      e->erases++;
+      add_us(&e->busy_until, cmd == SECTOR_ERASE_CMD ? FLASH_TSE : FLASH_TBE);
+    }
+    e->status &= ~WRITE_ENABLE_LATCH;
+    break;
+  case WRITE_CMD:
+    if (!(e->status & WRITE_ENABLE_LATCH) || len <= 1 + address_bytes) {
+      e->ignored++;
+    } else {
+      // the address counter wraps at the page boundary
+      page = adr - adr % e->page_size;
+      for (i = 1 + address_bytes; i < len; i++) {
+	if (e->flash) {
+	  // programming only clears bits, the sector must be erased
+	  e->mem[adr] &= data[i];
+	} else if (!protected(e, adr)) {
+	  e->mem[adr] = data[i];
+	}
+	data[i] = 0xFF;
+	adr = page + (adr + 1) % e->page_size;
+      }
+      e->write_cycles++;
+      add_us(&e->busy_until, write_cycle_us);
+      data_bytes = len - 1 - address_bytes;
+    }
+    e->status &= ~WRITE_ENABLE_LATCH;
+    break;
+  default:
+    e->ignored++;
+    memset(data, 0xFF, len);
+    break;
+  }
+
+  if (bench != NULL && data_bytes >= 0) {
+    // a data transfer (page) is an operation, the latency is the time
+    // since the last one (includes the write cycle and the status polls)
+    now = sim_bench_now();
+    sim_bench_op(bench, data_time ? now - data_time : transfer_ns,
+		 data_bytes);
+    data_time = now;
+  }
+
+  pthread_mutex_unlock(&bus_lock);
+  return len;
+}
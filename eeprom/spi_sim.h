@@ -0,0 +1,100 @@
+/**
+ *  @brief
+ *      Software stand-in for the wiringPi SPI layer with a 25xx SPI EEPROM
+ *      behind it.
+ *
+ *      Link spi_sim.o instead of -lwiringPi and compile the tools with
+ *      -DSPI_SIM to run bin2eeprom and eeprom2bin on any Linux machine.
+ *      The EEPROM content is a memory mapped image file, one per chip
+ *      select. The simulator is configured with environment variables:
+ *
+ *      EEPROM_SIM_IMAGE    image file name, %d is replaced by the channel
+ *                          ("eeprom-ce%d.bin" is default)
+ *      EEPROM_SIM_SIZE     size in Kibit (1024 is default), selects the
+ *                          page size and address bits like the -k option
+ *      EEPROM_SIM_TWC      write cycle time in us (5000 is default)
+ *      EEPROM_SIM_STATS    print transfer statistics to stderr at exit
+ *      EEPROM_SIM_FLASH    JEDEC ID in hex (e.g. ef4018 for a W25Q128), 
+ *                          simulates a SPI NOR flash instead of the EEPROM:
+ *                          page program (only clears bits), 4 KiB sector 
+ *                          and 64 KiB block erase, FAST_READ and JEDEC ID.
+ *                          The write cycle is 700 us, the erase 45 ms
+ *                          (sector) and 150 ms (block).
+ *
+ *      With SIM_BENCH set (see ../tools/sim_bench.h) each data transfer
+ *      (READ, FAST_READ or page WRITE) is recorded as operation "spi",
+ *      the latency is the time since the last data transfer.
+ *
+ *  @file
+ *      spi_sim.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPI_SIM_H_
+#define SPI_SIM_H_
+
+#ifndef TRUE
+#define TRUE    (1==1)
+#define FALSE   (!TRUE)
+#endif
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiSPISetup
+ */
+/**
+ *  @brief
+ *      Opens (creates) and maps the EEPROM image for the channel
+ *  @param
+ *      channel     chip select 0 or 1
+ *  @param
+ *      speed       SPI clock in Hz, used for the transfer timing
+ *  @return
+ *      int         file descriptor of the image, -1 on error
+ */
+/* ===================================================================*/
+int wiringPiSPISetup(int channel, int speed);
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiSPIDataRW
+ */
+/**
+ *  @brief
+ *      Full duplex transfer, one chip select cycle. The buffer is
+ *      overwritten with the bytes clocked out of the EEPROM.
+ *  @param
+ *      channel     chip select 0 or 1
+ *  @param
+ *      data        transmit and receive buffer
+ *  @param
+ *      len         number of bytes
+ *  @return
+ *      int         len, -1 on error
+ */
+/* ===================================================================*/
+int wiringPiSPIDataRW(int channel, unsigned char *data, int len);
+
+#endif /* SPI_SIM_H_ */
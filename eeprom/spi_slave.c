@@ -0,0 +1,146 @@
+/**
+ *  @brief
+ *      Bit level SPI slave of a 25xx EEPROM (READ command only).
+ *
+ *      Used by elfboot to answer the boot loader with the GPIO pins of
+ *      the Raspberry Pi instead of an EEPROM chip.
+ *
+ *  @file
+ *      spi_slave.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "eeprom.h"
+#include "spi_slave.h"
+
+
+/*
+ ** ===================================================================
+ **  Method      :  spi_slave_init
+ */
+/**
+ *  @brief
+ *      Initialises the slave, CS inactive
+ *  @param
+ *      s           slave
+ *  @param
+ *      mem         EEPROM content
+ *  @param
+ *      size        EEPROM size in bytes
+ *  @param
+ *      address_bits 8, 16 or 24
+ */
+/* ===================================================================*/
+void spi_slave_init(spi_slave_t *s, const uint8_t *mem, uint32_t size,
+		    uint8_t address_bits) {
+  memset(s, 0, sizeof(*s));
+  s->mem = mem;
+  s->size = size;
+  s->address_bits = address_bits;
+  s->state = SLAVE_IDLE;
+  s->cs = 1;
+  s->miso = 1;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  spi_slave_clock
+ */
+/**
+ *  @brief
+ *      Updates the state with the current levels, edges are detected
+ *      against the levels of the previous call
+ *  @param
+ *      s           slave
+ *  @param
+ *      cs          chip select level (1 inactive)
+ *  @param
+ *      clk         clock level
+ *  @param
+ *      mosi        data level from the master
+ *  @return
+ *      int         MISO level (1 while CS is inactive)
+ */
+/* ===================================================================*/
+int spi_slave_clock(spi_slave_t *s, int cs, int clk, int mosi) {
+  if (cs) {
+    // cancel the command, MISO released (pulled up)
+    s->state = SLAVE_IDLE;
+    s->cs = 1;
+    s->clk = clk;
+    s->miso = 1;
+    return s->miso;
+  }
+  if (s->state == SLAVE_IDLE) {
+    s->state = SLAVE_CMD;
+    s->bits = 0;
+    s->shift = 0;
+  }
+  s->cs = 0;
+
+  if (clk && !s->clk) {
+    // rising edge, MOSI is valid
+    switch (s->state) {
+      case SLAVE_CMD:
+	s->shift = s->shift << 1 | (mosi != 0);
+	if (++s->bits == 8) {
+	  if (s->shift == READ_CMD) {
+	    s->state = SLAVE_ADR;
+	    s->reads++;
+	  } else {
+	    s->state = SLAVE_IGNORE;
+	    s->ignored++;
+	  }
+	  s->bits = 0;
+	  s->shift = 0;
+	}
+	break;
+      case SLAVE_ADR:
+	s->shift = s->shift << 1 | (mosi != 0);
+	if (++s->bits == s->address_bits) {
+	  s->adr = s->shift % s->size;
+	  s->state = SLAVE_DATA;
+	  s->bits = 0;
+	}
+	break;
+    }
+  } else if (!clk && s->clk && s->state == SLAVE_DATA) {
+    // falling edge, next data bit out
+    if (s->bits == 8) {
+      s->adr = (s->adr + 1) % s->size;
+      s->bits = 0;
+    }
+    if (s->bits == 0) {
+      s->bytes++;
+    }
+    s->miso = s->mem[s->adr] >> (7 - s->bits) & 1;
+    s->bits++;
+  }
+  s->clk = clk;
+  return s->miso;
+}
@@ -0,0 +1,108 @@
+/**
+ *  @brief
+ *      Bit level SPI slave of a 25xx EEPROM (READ command only).
+ *
+ *      The state machine is fed with the levels of CS, CLK and MOSI
+ *      whenever one of them may have changed and returns the MISO level.
+ *      SPI mode 0: MOSI is shifted in on the rising CLK edge, MISO is
+ *      shifted out on the falling edge, the first data bit right after
+ *      the last address bit. CS high cancels the command. The data of a
+ *      READ command wraps around at the end of the memory like the
+ *      EEPROM does.
+ *
+ *  @file
+ *      spi_slave.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPI_SLAVE_H_
+#define SPI_SLAVE_H_
+
+// states
+#define SLAVE_IDLE      (0)     // CS high
+#define SLAVE_CMD       (1)     // command byte
+#define SLAVE_ADR       (2)     // address bits
+#define SLAVE_DATA      (3)     // data bytes
+#define SLAVE_IGNORE    (4)     // unknown command, until CS high
+
+typedef struct {
+  const uint8_t *mem;
+  uint32_t size;
+  uint8_t address_bits;
+  uint8_t state;
+  uint8_t cs;
+  uint8_t clk;
+  uint8_t miso;
+  uint8_t bits;
+  uint32_t shift;
+  uint32_t adr;
+  unsigned long reads;          // READ commands
+  unsigned long bytes;          // data bytes shifted out
+  unsigned long ignored;        // other commands
+} spi_slave_t;
+
+/*
+ ** ===================================================================
+ **  Method      :  spi_slave_init
+ */
+/**
+ *  @brief
+ *      Initialises the slave, CS inactive
+ *  @param
+ *      s           slave
+ *  @param
+ *      mem         EEPROM content
+ *  @param
+ *      size        EEPROM size in bytes
+ *  @param
+ *      address_bits 8, 16 or 24
+ */
+/* ===================================================================*/
+void spi_slave_init(spi_slave_t *s, const uint8_t *mem, uint32_t size,
+		    uint8_t address_bits);
+
+/*
+ ** ===================================================================
+ **  Method      :  spi_slave_clock
+ */
+/**
+ *  @brief
+ *      Updates the state with the current levels, edges are detected
+ *      against the levels of the previous call
+ *  @param
+ *      s           slave
+ *  @param
+ *      cs          chip select level (1 inactive)
+ *  @param
+ *      clk         clock level
+ *  @param
+ *      mosi        data level from the master
+ *  @return
+ *      int         MISO level (1 while CS is inactive)
+ */
+/* ===================================================================*/
+int spi_slave_clock(spi_slave_t *s, int cs, int clk, int mosi);
+
+#endif /* SPI_SLAVE_H_ */
@@ -0,0 +1,333 @@
+/**
+ *  @brief
+ *      Runs a tool built with the stand-ins (gpio_sim, microdot_sim,
+ *      spi_sim) and reports the operations recorded by the stand-ins as
+ *      one JSON object per run.
+ *
+ *      The tool is started with SIM_BENCH set to a temporary file, the
+ *      stand-ins append their results at exit (see sim_bench.h). The
+ *      output line has the benchmark name, the size, the exit status, the
+ *      wall time of the run and an object per stand-in with ops/s,
+ *      bytes/s and the latency percentiles, e.g.
+ *
+ *      {"bench": "elf2bin", "size": 4096, "status": 0, "wall_s": 1.380,
+ *       "gpio": {"ops": 4096, "bytes": 4096, "seconds": 1.363,
+ *       "ops_per_s": 3005.1, "bytes_per_s": 3005.1, "latency_us":
+ *       {"p50": 321.3, "p95": 378.9, "p99": 641.0, "max": 5102.7}}}
+ *
+ *      The lines of several runs can be compared across builds.
+ *      make bench (tools and eeprom) runs all benchmarks.
+ *
+ *   	synopsis
+ *       $ bench [-n <name>] [-s <size>] [-i <file>] [-d <us>] [-o <file>] [-v]
+ *               <command> [<args>]
+ *
+ *     -n name
+ *        name of the benchmark (the command is default)
+ *     -s size
+ *        size of the run (bytes, address or keys) for the report
+ *     -i file
+ *        stdin of the command (/dev/null is default)
+ *     -d us
+ *        the stdin file is written byte by byte with this delay (keys)
+ *     -o file
+ *        the JSON line is appended to the file (stdout is default)
+ *     -v
+ *        verbose, the output of the command is shown on stderr
+ *  @file
+ *      bench.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_LINE_LENGTH 1024
+
+void usage_exit(int err_number, const char *str);
+uint64_t nanoseconds(void);
+int feed_input(int fd, FILE *fp, long delay_us);
+void print_result(FILE *out, const char *name, long size, int status,
+		  double wall, FILE *sim);
+
+int main(int argc, char *argv[]) {
+  char sim_fn[] = "/tmp/sim-bench-XXXXXX";
+  const char *name = NULL;
+  const char *input_fn = NULL;
+  const char *output_fn = NULL;
+  long size = 0;
+  long delay_us = 0;
+  uint64_t start;
+  double wall;
+  int status;
+  int fd;
+  int in_fd;
+  int null_fd;
+  int input_pipe[2];
+  FILE *input = NULL;
+  FILE *sim;
+  FILE *out;
+  pid_t pid;
+
+  uint8_t verbose_mode = false;
+  int opt;
+
+  // parse command line options
+  while ((opt = getopt(argc, argv, "+n:s:i:d:o:v")) != -1) {
+    switch (opt) {
+    case 'n':
+      name = optarg;
+      break;
+    case 's':
+      size = strtol(optarg, NULL, 0);
+      break;
+    case 'i':
+      input_fn = optarg;
+      break;
+    case 'd':
+      delay_us = strtol(optarg, NULL, 10);
+      break;
+    case 'o':
+      output_fn = optarg;
+      break;
+    case 'v':
+      verbose_mode = true;
+      break;
+    default:
+      usage_exit(EXIT_FAILURE, argv[0]);
+      break;
+    }
+  }
+  if (optind >= argc) {
+    // the command is missing
+    usage_exit(EXIT_FAILURE, argv[0]);
+  }
+  if (name == NULL) {
+    name = argv[optind];
+  }
+
+  fd = mkstemp(sim_fn);
+  if (fd < 0) {
+    perror(sim_fn);
+    exit(EXIT_FAILURE);
+  }
+  close(fd);
+  setenv("SIM_BENCH", sim_fn, 1);
+
+  // stdin of the command: file, paced pipe or nothing
+  in_fd = -1;
+  input_pipe[1] = -1;
+  if (input_fn != NULL) {
+    input = fopen(input_fn, "r");
+    if (input == NULL) {
+      perror(input_fn);
+      unlink(sim_fn);
+      exit(EXIT_FAILURE);
+    }
+    if (delay_us > 0) {
+      if (pipe(input_pipe) < 0) {
+	perror("pipe");
+	unlink(sim_fn);
+	exit(EXIT_FAILURE);
+      }
+      in_fd = input_pipe[0];
+    } else {
+      in_fd = fileno(input);
+    }
+  }
+  null_fd = open("/dev/null", O_RDWR);
+  signal(SIGPIPE, SIG_IGN);
+
+  start = nanoseconds();
+  pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    unlink(sim_fn);
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    dup2(in_fd >= 0 ? in_fd : null_fd, STDIN_FILENO);
+    dup2(verbose_mode ? STDERR_FILENO : null_fd, STDOUT_FILENO);
+    if (!verbose_mode) {
+      dup2(null_fd, STDERR_FILENO);
+    }
+    if (input_pipe[1] >= 0) {
+      close(input_pipe[1]);
+    }
+    execvp(argv[optind], &argv[optind]);
+    _exit(127);
+  }
+  if (input_pipe[1] >= 0) {
+    close(input_pipe[0]);
+    feed_input(input_pipe[1], input, delay_us);
+    close(input_pipe[1]);
+  }
+  waitpid(pid, &status, 0);
+  wall = (nanoseconds() - start) / 1e9;
+  status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  if (input != NULL) {
+    fclose(input);
+  }
+
+  out = stdout;
+  if (output_fn != NULL) {
+    out = fopen(output_fn, "a");
+    if (out == NULL) {
+      perror(output_fn);
+      unlink(sim_fn);
+      exit(EXIT_FAILURE);
+    }
+  }
+  sim = fopen(sim_fn, "r");
+  print_result(out, name, size, status, wall, sim);
+  if (sim != NULL) {
+    fclose(sim);
+  }
+  unlink(sim_fn);
+  if (out != stdout) {
+    fclose(out);
+  }
+  if (status != 0) {
+    fprintf(stderr, "%s: %s exit status %d\n", argv[0], name, status);
+  }
+  exit(status == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void usage_exit(int err_number, const char *str) {
+  fprintf(stderr, "\
+Usage: %s [-n <name>] [-s <size>] [-i <file>] [-d <us>] [-o <file>] [-v] <command> [<args>]\n\
+-n name of the benchmark\n\
+-s size of the run\n\
+-i stdin of the command\n\
+-d delay between the stdin bytes in us\n\
+-o append the JSON line to the file\n\
+-v verbose, output of the command\n",
+	  str);
+  exit(err_number);
+}
+
+uint64_t nanoseconds(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  feed_input
+ */
+/**
+ *  @brief
+ *      Writes the file byte by byte to the command (e.g. keys)
+ *  @param
+ *      fd          write end of the stdin pipe of the command
+ *  @param
+ *      fp          input file
+ *  @param
+ *      delay_us    delay between the bytes
+ *  @return
+ *      int         number of bytes written
+ */
+/* ===================================================================*/
+int feed_input(int fd, FILE *fp, long delay_us) {
+  int c;
+  int n = 0;
+  char byte;
+
+  while ((c = fgetc(fp)) != EOF) {
+    byte = c;
+    if (write(fd, &byte, 1) != 1) {
+      // the command has ended
+      break;
+    }
+    n++;
+    usleep(delay_us);
+  }
+  return n;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  print_result
+ */
+/**
+ *  @brief
+ *      Prints the JSON line of a run, the objects of the stand-ins
+ *      {"sim": "<name>", ...} become "<name>": {...}
+ *  @param
+ *      out         output file
+ *  @param
+ *      name        name of the benchmark
+ *  @param
+ *      size        size of the run
+ *  @param
+ *      status      exit status of the command
+ *  @param
+ *      wall        wall time of the run in s
+ *  @param
+ *      sim         results of the stand-ins, NULL none
+ */
+/* ===================================================================*/
+void print_result(FILE *out, const char *name, long size, int status,
+		  double wall, FILE *sim) {
+  char line[MAX_LINE_LENGTH];
+  char *sim_name;
+  char *rest;
+  size_t n;
+
+  fprintf(out, "{\"bench\": \"%s\", \"size\": %ld, \"status\": %d, "
+	  "\"wall_s\": %.6f", name, size, status, wall);
+  while (sim != NULL && fgets(line, sizeof(line), sim) != NULL) {
+    // strip the newline and the end of the object
+    n = strlen(line);
+    if (n > 0 && line[n - 1] == '\n') {
+      line[--n] = '\0';
+    }
+    if (n == 0 || line[n - 1] != '}' ||
+	strncmp(line, "{\"sim\": \"", 9) != 0) {
+      continue;
+    }
+    line[--n] = '\0';
+    sim_name = line + 9;
+    rest = strchr(sim_name, '"');
+    if (rest == NULL || strncmp(rest, "\", ", 3) != 0) {
+      continue;
+    }
+    *rest = '\0';
+    rest += 3;
+    fprintf(out, ", \"%s\": {%s}", sim_name, rest);
+  }
+  fprintf(out, "}\n");
+}
@@ -8,12 +8,21 @@
  *      http://spyr.ch/twiki/bin/view/Cosmac/RaspiElf
  *
  *   	synopsis
- *	$ bin2elf [-s <hexadr>] [-e <hexadr>] [<filename>]
+ *	$ bin2elf [-s <hexadr>] [-e <hexadr>] [-w] [-r] [--stats] [<filename>]
+ *	$ bin2elf -m <pinmap> [-s <hexadr>] [-e <hexadr>] [-w] [-r] [--stats]
+ *	          [<filename> ...]
  * 	    The file is read from stdin in or <filename>.
  * 	    -s start address in hex
  * 	    -e end adress in hex
  * 	    -w write enable
  * 	    -r run mode
+ * 	    --stats transfer statistics (IN strobe histogram, time in
+ * 	            GPIO, sleep and file I/O, bytes/s, progress with ETA)
+ * 	    -m farm mode, all boards of the pin map (see farm_gpio.h) are
+ * 	       written in lockstep, one file per board or one file (or
+ * 	       stdin) for all boards. A board stops writing (read mode) at
+ * 	       the end of its file. Boards with a shared WRITE line need
+ * 	       files of the same size.
  *  @file
  *      bin2elf.c
  *  @author
@@ -46,9 +55,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#ifdef GPIO_SIM
+#include "gpio_sim.h"
+#else
 #include <wiringPi.h>
+#endif
 #include "raspi_gpio.h"
+#include "transfer_stats.h"
+#include "farm_gpio.h"
 
+int farm_bin2elf(const char *map_fn, int files, char *fn[],
+		 uint16_t start_adr, uint16_t end_adr, uint8_t write_mode,
+		 uint8_t run_mode, uint8_t stats_mode);
 
 int main(int argc, char *argv[]) {
   int i;
@@ -59,9 +79,18 @@ int main(int argc, char *argv[]) {
   uint16_t start_adr = START_ADR;
   uint16_t end_adr = END_ADR;
   FILE *fp;
+  uint64_t t;
+  uint32_t total;
+  struct stat st;
+  uint8_t stats_mode = FALSE;
+  const char *map_fn = NULL;
+  static const struct option long_options[] = {
+    {"stats", no_argument, NULL, 'S'},
+    {NULL, 0, NULL, 0}
+  };
     
   // parse command line options
-  while ((opt = getopt(argc, argv, "s:e:wr")) != -1) {
+  while ((opt = getopt_long(argc, argv, "s:e:wrm:", long_options, NULL)) != -1) {
     switch (opt) {
     case 's': 
       start_adr = strtol(optarg, NULL, 16);
@@ -75,14 +104,28 @@ int main(int argc, char *argv[]) {
     case 'r':
       run_mode = TRUE;
       break;
+    case 'S':
+      stats_mode = TRUE;
+      break;
+    case 'm':
+      map_fn = optarg;
+      break;
     default:
       fprintf(stderr, 
-	      "Usage: %s [-s <adr>] [-e <adr>] [-w] [-r] [<filename>]\n", 
-	      argv[0]);
+	      "Usage: %s [-s <adr>] [-e <adr>] [-w] [-r] [--stats] [<filename>]\n"
+	      "       %s -m <pinmap> [-s <adr>] [-e <adr>] [-w] [-r] [--stats] "
+	      "[<filename> ...]\n", 
+	      argv[0], argv[0]);
       exit(EXIT_FAILURE);
     }
   }
 
+  if (map_fn != NULL) {
+    // several boards in lockstep
+    exit(farm_bin2elf(map_fn, argc - optind, &argv[optind], start_adr,
+		      end_adr, write_mode, run_mode, stats_mode));
+  }
+
   fp = stdin;
   if (optind < argc) {
     // there is a filename parameter, use it instead of stdin
@@ -114,34 +157,44 @@ int main(int argc, char *argv[]) {
   usleep(100);
   digitalWrite(WAIT_N, 0);
   usleep(100);
+
+  if (stats_mode) {
+    // a file has a known size, a pipe not (no ETA)
+    total = 0;
+    if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)) {
+      total = end_adr + 1 - start_adr;
+      if (st.st_size < total) {
+	total = st.st_size;
+      }
+      total += start_adr;
+    }
+    stats_init(total);
+  }
     
   // read
   digitalWrite(WRITE_N, 1);
   for (i = 0; i < start_adr; i++) {
     // count up to the start address
-    digitalWrite(IN_N, 0);
-    usleep(100);
-    digitalWrite(IN_N, 1);        
-    usleep(100);
+    in_clock();
   }
     
   // write enable
   digitalWrite(WRITE_N, 0);
    
   int j = 0;
+  t = stats_time();
   while ((data = fgetc(fp)) != EOF) {
+    t = stats_add(STATS_FILE, t);
     write_byte(data);
+    stats_add(STATS_GPIO, t);
     j++;
         
-    // in clock
-    digitalWrite(IN_N, 0);
-    usleep(100);
-    digitalWrite(IN_N, 1);
-    usleep(100);
+    in_clock();
   
     if (++i > end_adr) {
       break;
     }
+    t = stats_time();
   }
     
   if (write_mode) {
@@ -160,6 +213,7 @@ int main(int argc, char *argv[]) {
     digitalWrite(CLEAR_N, 1);    
   }
     
+  stats_print(j);
   fprintf(stderr, "0x%04x bytes written\n", j);
     
   fclose(fp);
@@ -167,4 +221,209 @@ int main(int argc, char *argv[]) {
   exit(0);
 }
 
+/*
+ ** ===================================================================
+ **  Method      :  farm_bin2elf
+ */
+/**
+ *  @brief
+ *      Writes the files to all boards of the pin map in lockstep, the
+ *      data of all boards is set with one write per byte and all boards
+ *      share the IN strobe
+ *  @param
+ *      map_fn      file name of the pin map
+ *  @param
+ *      files       number of files, 0 stdin
+ *  @param
+ *      fn          file names, one for all boards or one per board
+ *  @param
+ *      start_adr   start address
+ *  @param
+ *      end_adr     end address
+ *  @param
+ *      write_mode  write enable at the end
+ *  @param
+ *      run_mode    run at the end
+ *  @param
+ *      stats_mode  transfer statistics
+ *  @return
+ *      int         EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* ===================================================================*/
+int farm_bin2elf(const char *map_fn, int files, char *fn[],
+		 uint16_t start_adr, uint16_t end_adr, uint8_t write_mode,
+		 uint8_t run_mode, uint8_t stats_mode) {
+  FILE *fp[MAX_BOARDS];
+  uint32_t size[MAX_BOARDS];
+  uint32_t bytes[MAX_BOARDS];
+  uint8_t data[MAX_BOARDS];
+  uint32_t active;
+  uint32_t total;
+  uint32_t sum;
+  uint64_t t;
+  struct stat st;
+  int boards;
+  int shared;
+  int c;
+  int b;
+  int k;
+  int i;
+
+  boards = farm_load_map(map_fn);
+  if (boards < 0) {
+    return EXIT_FAILURE;
+  }
+  if (files > 1 && files != boards) {
+    fprintf(stderr, "%d files for %d boards\n", files, boards);
+    return EXIT_FAILURE;
+  }
+  // one file (or stdin) is read once for all boards
+  shared = files <= 1;
+
+  total = 0;
+  for (b = 0; b < boards; b++) {
+    if (files == 0) {
+      fp[b] = stdin;
+    } else if (shared && b > 0) {
+      fp[b] = fp[0];
+    } else {
+      fp[b] = fopen(fn[b], "r");
+      if (fp[b] == NULL) {
+	fprintf(stderr, 
+		"Cannot open file \"%s\"\n", 
+		fn[b]);
+	return EXIT_FAILURE;
+      }
+    }
+    // a file has a known size, a pipe not
+    size[b] = 0;
+    if (fstat(fileno(fp[b]), &st) == 0 && S_ISREG(st.st_mode)) {
+      size[b] = end_adr + 1 - start_adr;
+      if (st.st_size < size[b]) {
+	size[b] = st.st_size;
+      }
+    }
+    if (size[b] > total) {
+      total = size[b];
+    }
+    bytes[b] = 0;
+  }
+
+  for (b = 0; b < boards && !shared; b++) {
+    for (k = b + 1; k < boards; k++) {
+      if (farm_board(b)->line[FARM_WRITE] == farm_board(k)->line[FARM_WRITE]
+	  && size[b] != size[k]) {
+	// the shorter file can't stop writing
+	fprintf(stderr, 
+		"Boards %d and %d share the WRITE line, "
+		"\"%s\" and \"%s\" need the same size\n", 
+		b, k, fn[b], fn[k]);
+	return EXIT_FAILURE;
+      }
+    }
+  }
+
+  if (farm_init() != 0) {
+    // can't init ports
+    return EXIT_FAILURE;
+  }
+
+  // load
+  farm_line(FARM_WAIT, 0);
+  farm_line(FARM_CLEAR, 0);
+  usleep(100);
+  // reset
+  farm_line(FARM_WAIT, 1);
+  usleep(100);
+  farm_line(FARM_WAIT, 0);
+  usleep(100);
 
+  stats_in_line(farm_in);
+  if (stats_mode) {
+    stats_init(total == 0 ? 0 : start_adr + total);
+  }
+
+  // read
+  farm_line(FARM_WRITE, 1);
+  for (i = 0; i < start_adr; i++) {
+    // count up to the start address
+    in_clock();
+  }
+
+  // write enable
+  farm_line(FARM_WRITE, 0);
+
+  active = (1UL << boards) - 1;
+  while (i <= end_adr) {
+    t = stats_time();
+    for (b = 0; b < boards; b++) {
+      if (!(active & (1UL << b))) {
+	continue;
+      }
+      if (shared && b > 0) {
+	data[b] = data[0];
+	continue;
+      }
+      c = fgetc(fp[b]);
+      if (c == EOF) {
+	// end of the file, the board reads from now on
+	active &= ~(1UL << b);
+	farm_board_line(b, FARM_WRITE, 1);
+	if (shared) {
+	  active = 0;
+	}
+	continue;
+      }
+      data[b] = c;
+    }
+    t = stats_add(STATS_FILE, t);
+    if (active == 0) {
+      break;
+    }
+    if (farm_write_bytes(data, active) != 0) {
+      fprintf(stderr, 
+	      "0x%04x: boards with shared data lines get different data\n", 
+	      i);
+      break;
+    }
+    stats_add(STATS_GPIO, t);
+
+    in_clock();
+    for (b = 0; b < boards; b++) {
+      if (active & (1UL << b)) {
+	bytes[b]++;
+      }
+    }
+    i++;
+  }
+
+  if (write_mode) {
+    // write enable
+    farm_line(FARM_WRITE, 0);
+  } else {
+    // read (disable write)
+    farm_line(FARM_WRITE, 1);
+  }
+
+  if (run_mode) {
+    // run
+    farm_line(FARM_WAIT, 1);
+    // reset
+    usleep(100);
+    farm_line(FARM_CLEAR, 1);
+  }
+
+  sum = 0;
+  for (b = 0; b < boards; b++) {
+    sum += bytes[b];
+  }
+  stats_print(sum);
+  for (b = 0; b < boards; b++) {
+    fprintf(stderr, "board %d: 0x%04x bytes written\n", b, bytes[b]);
+    if (!shared || b == 0) {
+      fclose(fp[b]);
+    }
+  }
+
+  return active == 0 || i > end_adr ? EXIT_SUCCESS : EXIT_FAILURE;
+}
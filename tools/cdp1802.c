@@ -0,0 +1,483 @@
+/**
+ *  @brief
+ *      CDP1802 instruction set emulator (library).
+ *
+ *      The 256 opcodes are decoded once by cdp1802_init into a table of
+ *      the function of the instruction group, the N field (register,
+ *      port or branch condition) and the machine cycles. cdp1802_run
+ *      fetches the opcode and calls the function from the table, there
+ *      is no decoding in the loop. Writes to the code (e.g. a branch
+ *      address) need no invalidation, only the opcode is decoded.
+ *
+ *  @file
+ *      cdp1802.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "cdp1802.h"
+
+#define R(n)    (cpu->r[n])
+#define M(a)    (cpu->memory[(uint16_t) (a)])
+#define IMM()   (M(R(cpu->p)++))
+
+typedef void (*op_t)(cdp1802_t *cpu, int n);
+
+// decoded opcode
+typedef struct {
+  op_t op;
+  uint8_t n;
+  uint8_t cycles;
+} decode_t;
+
+static decode_t decode[256];
+static int decoded = 0;
+
+
+// flag of the branch condition N (bits 0 to 2): 0 true, 1 Q, 2 D zero,
+// 3 DF, 4 to 7 EF1 to EF4
+static int flag(const cdp1802_t *cpu, int n) {
+  switch (n & 7) {
+  case 0:
+    return 1;
+  case 1:
+    return cpu->q;
+  case 2:
+    return cpu->d == 0;
+  case 3:
+    return cpu->df;
+  default:
+    return (cpu->ef >> ((n & 7) - 4)) & 1;
+  }
+}
+
+// D = a + b + carry, DF is the carry out (no borrow for the subtractions)
+static void add(cdp1802_t *cpu, uint8_t a, uint8_t b, int carry) {
+  unsigned int sum = a + b + carry;
+
+  cpu->d = sum;
+  cpu->df = sum >> 8;
+}
+
+static void set_q(cdp1802_t *cpu, uint8_t q) {
+  if (cpu->q != q) {
+    cpu->q = q;
+    if (cpu->q_changed != NULL) {
+      cpu->q_changed(cpu, q);
+    }
+  }
+}
+
+// 0N
+
+static void op_idl(cdp1802_t *cpu, int n) {
+  (void) n;
+  cpu->state = CDP1802_IDLE;
+}
+
+static void op_ldn(cdp1802_t *cpu, int n) {
+  cpu->d = M(R(n));
+}
+
+// 1N, 2N
+
+static void op_inc(cdp1802_t *cpu, int n) {
+  R(n)++;
+}
+
+static void op_dec(cdp1802_t *cpu, int n) {
+  R(n)--;
+}
+
+// 3N short branch, N bit 3 inverts the condition (38 is SKP)
+
+static void op_branch(cdp1802_t *cpu, int n) {
+  if (flag(cpu, n) ^ (n >> 3)) {
+    R(cpu->p) = (R(cpu->p) & 0xFF00) | M(R(cpu->p));
+  } else {
+    R(cpu->p)++;
+  }
+}
+
+// 4N, 5N
+
+static void op_lda(cdp1802_t *cpu, int n) {
+  cpu->d = M(R(n)++);
+}
+
+static void op_str(cdp1802_t *cpu, int n) {
+  M(R(n)) = cpu->d;
+}
+
+// 6N
+
+static void op_irx(cdp1802_t *cpu, int n) {
+  (void) n;
+  R(cpu->x)++;
+}
+
+static void op_out(cdp1802_t *cpu, int n) {
+  uint8_t data = M(R(cpu->x)++);
+
+  if (cpu->out != NULL) {
+    cpu->out(cpu, n, data);
+  }
+}
+
+static void op_inp(cdp1802_t *cpu, int n) {
+  uint8_t data = 0xFF;
+
+  if (cpu->in != NULL) {
+    data = cpu->in(cpu, n);
+  }
+  M(R(cpu->x)) = data;
+  cpu->d = data;
+}
+
+static void op_illegal(cdp1802_t *cpu, int n) {
+  (void) n;
+  cpu->state = CDP1802_ILLEGAL;
+}
+
+// 7N
+
+static void op_ret(cdp1802_t *cpu, int n) {
+  uint8_t xp = M(R(cpu->x)++);
+
+  cpu->x = xp >> 4;
+  cpu->p = xp & 0x0F;
+  // RET 1, DIS 0
+  cpu->ie = n == 0;
+}
+
+static void op_ldxa(cdp1802_t *cpu, int n) {
+  (void) n;
+  cpu->d = M(R(cpu->x)++);
+}
+
+static void op_stxd(cdp1802_t *cpu, int n) {
+  (void) n;
+  M(R(cpu->x)--) = cpu->d;
+}
+
+static void op_adc(cdp1802_t *cpu, int n) {
+  (void) n;
+  add(cpu, M(R(cpu->x)), cpu->d, cpu->df);
+}
+
+static void op_sdb(cdp1802_t *cpu, int n) {
+  (void) n;
+  add(cpu, M(R(cpu->x)), ~cpu->d, cpu->df);
+}
+
+static void op_shrc(cdp1802_t *cpu, int n) {
+  uint8_t df = cpu->d & 1;
+
+  (void) n;
+  cpu->d = (cpu->d >> 1) | (cpu->df << 7);
+  cpu->df = df;
+}
+
+static void op_smb(cdp1802_t *cpu, int n) {
+  (void) n;
+  add(cpu, cpu->d, ~M(R(cpu->x)), cpu->df);
+}
+
+static void op_sav(cdp1802_t *cpu, int n) {
+  (void) n;
+  M(R(cpu->x)) = cpu->t;
+}
+
+static void op_mark(cdp1802_t *cpu, int n) {
+  (void) n;
+  cpu->t = (cpu->x << 4) | cpu->p;
+  M(R(2)) = cpu->t;
+  cpu->x = cpu->p;
+  R(2)--;
+}
+
+static void op_q(cdp1802_t *cpu, int n) {
+  // REQ 0xA, SEQ 0xB
+  set_q(cpu, n & 1);
+}
+
+static void op_adci(cdp1802_t *cpu, int n) {
+  (void) n;
+  add(cpu, IMM(), cpu->d, cpu->df);
+}
+
+static void op_sdbi(cdp1802_t *cpu, int n) {
+  (void) n;
+  add(cpu, IMM(), ~cpu->d, cpu->df);
+}
+
+static void op_shlc(cdp1802_t *cpu, int n) {
+  uint8_t df = cpu->d >> 7;
+
+  (void) n;
+  cpu->d = (cpu->d << 1) | cpu->df;
+  cpu->df = df;
+}
+
+static void op_smbi(cdp1802_t *cpu, int n) {
+  (void) n;
+  add(cpu, cpu->d, ~IMM(), cpu->df);
+}
+
+// 8N to BN
+
+static void op_glo(cdp1802_t *cpu, int n) {
+  cpu->d = R(n);
+}
+
+static void op_ghi(cdp1802_t *cpu, int n) {
+  cpu->d = R(n) >> 8;
+}
+
+static void op_plo(cdp1802_t *cpu, int n) {
+  R(n) = (R(n) & 0xFF00) | cpu->d;
+}
+
+static void op_phi(cdp1802_t *cpu, int n) {
+  R(n) = (R(n) & 0x00FF) | (cpu->d << 8);
+}
+
+// CN long branch (C0 to C3, C8 to CB) and long skip, N bit 3 inverts
+
+static void op_long_branch(cdp1802_t *cpu, int n) {
+  uint16_t adr;
+
+  if (flag(cpu, n & 3) ^ (n >> 3)) {
+    adr = M(R(cpu->p)) << 8;
+    R(cpu->p) = adr | M(R(cpu->p) + 1);
+  } else {
+    R(cpu->p) += 2;
+  }
+}
+
+static void op_nop(cdp1802_t *cpu, int n) {
+  (void) cpu;
+  (void) n;
+}
+
+static void op_long_skip(cdp1802_t *cpu, int n) {
+  // C5 to C7 skip on the false flag, CC (LSIE) and CD to CF on the true
+  int skip = (n & 3) ? flag(cpu, n & 3) : cpu->ie;
+
+  if (skip ^ !(n & 8)) {
+    R(cpu->p) += 2;
+  }
+}
+
+// DN, EN
+
+static void op_sep(cdp1802_t *cpu, int n) {
+  cpu->p = n;
+}
+
+static void op_sex(cdp1802_t *cpu, int n) {
+  cpu->x = n;
+}
+
+// FN, N bit 3 is the immediate operand (except F8 LDI and FE SHL)
+
+static void op_ldx(cdp1802_t *cpu, int n) {
+  cpu->d = (n & 8) ? IMM() : M(R(cpu->x));
+}
+
+static void op_or(cdp1802_t *cpu, int n) {
+  cpu->d |= (n & 8) ? IMM() : M(R(cpu->x));
+}
+
+static void op_and(cdp1802_t *cpu, int n) {
+  cpu->d &= (n & 8) ? IMM() : M(R(cpu->x));
+}
+
+static void op_xor(cdp1802_t *cpu, int n) {
+  cpu->d ^= (n & 8) ? IMM() : M(R(cpu->x));
+}
+
+static void op_add(cdp1802_t *cpu, int n) {
+  add(cpu, (n & 8) ? IMM() : M(R(cpu->x)), cpu->d, 0);
+}
+
+static void op_sd(cdp1802_t *cpu, int n) {
+  add(cpu, (n & 8) ? IMM() : M(R(cpu->x)), ~cpu->d, 1);
+}
+
+static void op_shr(cdp1802_t *cpu, int n) {
+  (void) n;
+  cpu->df = cpu->d & 1;
+  cpu->d >>= 1;
+}
+
+static void op_sm(cdp1802_t *cpu, int n) {
+  add(cpu, cpu->d, ~((n & 8) ? IMM() : M(R(cpu->x))), 1);
+}
+
+static void op_shl(cdp1802_t *cpu, int n) {
+  (void) n;
+  cpu->df = cpu->d >> 7;
+  cpu->d <<= 1;
+}
+
+static const op_t op_7n[16] = {
+  op_ret, op_ret, op_ldxa, op_stxd, op_adc, op_sdb, op_shrc, op_smb,
+  op_sav, op_mark, op_q, op_q, op_adci, op_sdbi, op_shlc, op_smbi
+};
+
+static const op_t op_fn[16] = {
+  op_ldx, op_or, op_and, op_xor, op_add, op_sd, op_shr, op_sm,
+  op_ldx, op_or, op_and, op_xor, op_add, op_sd, op_shl, op_sm
+};
+
+static const op_t op_group[16] = {
+  op_ldn, op_inc, op_dec, op_branch, op_lda, op_str, op_out, NULL,
+  op_glo, op_ghi, op_plo, op_phi, op_long_branch, op_sep, op_sex, NULL
+};
+
+static void decode_init(void) {
+  int opcode;
+  int i;
+  int n;
+
+  for (opcode = 0; opcode < 256; opcode++) {
+    i = opcode >> 4;
+    n = opcode & 0x0F;
+    decode[opcode].n = n;
+    decode[opcode].cycles = 2;
+    switch (i) {
+    case 0x6:
+      if (n == 0) {
+	decode[opcode].op = op_irx;
+      } else if (n == 8) {
+	decode[opcode].op = op_illegal;
+      } else {
+	decode[opcode].op = (n & 8) ? op_inp : op_out;
+	decode[opcode].n = n & 7;
+      }
+      break;
+    case 0x7:
+      decode[opcode].op = op_7n[n];
+      break;
+    case 0xC:
+      decode[opcode].cycles = 3;
+      if (n == 4) {
+	decode[opcode].op = op_nop;
+      } else if ((n & 7) >= 4) {
+	decode[opcode].op = op_long_skip;
+      } else {
+	decode[opcode].op = op_long_branch;
+      }
+      break;
+    case 0xF:
+      decode[opcode].op = op_fn[n];
+      break;
+    default:
+      decode[opcode].op = op_group[i];
+      break;
+    }
+  }
+  decode[0x00].op = op_idl;
+  decoded = 1;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  cdp1802_init
+ */
+/**
+ *  @brief
+ *      Initialises the emulator (decode table, no callbacks) and resets
+ *      the CPU
+ *  @param
+ *      cpu         emulator state
+ *  @param
+ *      memory      CDP1802_MEMORY_SIZE bytes
+ */
+/* ===================================================================*/
+void cdp1802_init(cdp1802_t *cpu, uint8_t *memory) {
+  if (!decoded) {
+    decode_init();
+  }
+  memset(cpu, 0, sizeof(*cpu));
+  cpu->memory = memory;
+  cdp1802_reset(cpu);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  cdp1802_reset
+ */
+/**
+ *  @brief
+ *      Reset: X, P, Q and R0 are 0, IE is 1, the counters are cleared
+ *  @param
+ *      cpu         emulator state
+ */
+/* ===================================================================*/
+void cdp1802_reset(cdp1802_t *cpu) {
+  cpu->x = 0;
+  cpu->p = 0;
+  cpu->r[0] = 0;
+  cpu->ie = 1;
+  set_q(cpu, 0);
+  cpu->state = CDP1802_RUN;
+  cpu->cycles = 0;
+  cpu->instructions = 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  cdp1802_run
+ */
+/**
+ *  @brief
+ *      Executes instructions
+ *  @param
+ *      cpu         emulator state
+ *  @param
+ *      n           maximum number of instructions
+ *  @return
+ *      cdp1802_state_t CDP1802_RUN after n instructions, CDP1802_IDLE
+ *                  (IDL) or CDP1802_ILLEGAL (0x68), R(P) points behind
+ *                  the instruction
+ */
+/* ===================================================================*/
+cdp1802_state_t cdp1802_run(cdp1802_t *cpu, uint32_t n) {
+  const decode_t *dc;
+  uint32_t i;
+
+  cpu->state = CDP1802_RUN;
+  for (i = 0; i < n && cpu->state == CDP1802_RUN; i++) {
+    dc = &decode[M(R(cpu->p)++)];
+    // cycles before the call, the callbacks see the time of the cycle
+    cpu->cycles += dc->cycles;
+    dc->op(cpu, dc->n);
+  }
+  cpu->instructions += i;
+  return cpu->state;
+}
@@ -0,0 +1,132 @@
+/**
+ *  @brief
+ *      CDP1802 instruction set emulator (library), e.g. for elfemu.
+ *
+ *      The emulator executes the 1802 instructions (not the 1804/1805/
+ *      1806 extensions) on a 64 KiB memory. The opcodes are decoded once
+ *      into a table with the function, the N field and the machine
+ *      cycles of each instruction, a step is a table lookup and a call.
+ *      The I/O of the system is done with callbacks: OUT, INP and the
+ *      changes of Q. The EF lines are bits in the state, EF1 is bit 0.
+ *      A flag is true when its line is active (the line is low on the
+ *      chip), B1 to B4 branch on a true flag.
+ *
+ *      A machine cycle is 8 clocks, an instruction takes 2 machine
+ *      cycles, the long branches and skips (Cx) 3. IDL stops the run
+ *      (there is no DMA or interrupt source), as does the undefined
+ *      opcode 0x68.
+ *
+ *  @file
+ *      cdp1802.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CDP1802_H_
+#define CDP1802_H_
+
+#include <stdint.h>
+
+#define CDP1802_MEMORY_SIZE     0x10000
+#define CDP1802_CLOCKS          8       // clocks per machine cycle
+
+// state of a run
+typedef enum {
+  CDP1802_RUN,
+  CDP1802_IDLE,
+  CDP1802_ILLEGAL
+} cdp1802_state_t;
+
+typedef struct cdp1802 cdp1802_t;
+
+struct cdp1802 {
+  uint16_t r[16];
+  uint8_t d;
+  uint8_t df;
+  uint8_t p;
+  uint8_t x;
+  uint8_t t;
+  uint8_t ie;
+  uint8_t q;
+  uint8_t ef;                   // EF1 bit 0 to EF4 bit 3, 1 is true
+  cdp1802_state_t state;
+  uint8_t *memory;              // CDP1802_MEMORY_SIZE bytes
+  uint64_t cycles;              // machine cycles since the reset
+  uint64_t instructions;        // instructions since the reset
+  // system, NULL none (OUT ignored, INP reads 0xff)
+  void (*out)(cdp1802_t *cpu, int port, uint8_t data);
+  uint8_t (*in)(cdp1802_t *cpu, int port);
+  void (*q_changed)(cdp1802_t *cpu, int q);
+  void *user;
+};
+
+/*
+ ** ===================================================================
+ **  Method      :  cdp1802_init
+ */
+/**
+ *  @brief
+ *      Initialises the emulator (decode table, no callbacks) and resets
+ *      the CPU
+ *  @param
+ *      cpu         emulator state
+ *  @param
+ *      memory      CDP1802_MEMORY_SIZE bytes
+ */
+/* ===================================================================*/
+void cdp1802_init(cdp1802_t *cpu, uint8_t *memory);
+
+/*
+ ** ===================================================================
+ **  Method      :  cdp1802_reset
+ */
+/**
+ *  @brief
+ *      Reset: X, P, Q and R0 are 0, IE is 1, the counters are cleared
+ *  @param
+ *      cpu         emulator state
+ */
+/* ===================================================================*/
+void cdp1802_reset(cdp1802_t *cpu);
+
+/*
+ ** ===================================================================
+ **  Method      :  cdp1802_run
+ */
+/**
+ *  @brief
+ *      Executes instructions
+ *  @param
+ *      cpu         emulator state
+ *  @param
+ *      n           maximum number of instructions
+ *  @return
+ *      cdp1802_state_t CDP1802_RUN after n instructions, CDP1802_IDLE
+ *                  (IDL) or CDP1802_ILLEGAL (0x68), R(P) points behind
+ *                  the instruction
+ */
+/* ===================================================================*/
+cdp1802_state_t cdp1802_run(cdp1802_t *cpu, uint32_t n);
+
+#endif /* CDP1802_H_ */
@@ -41,7 +41,9 @@
  * 
  *     -s hexadr
  *         start address in hex (0 is default). Pre increment to the 
- *         start address before the data is read and written. 
+ *         start address before the data is read and written. With load
+ *         the Elf is set to load mode and reset (R0 = 0) first, the
+ *         memory is read (not written) while counting.
  *     -i
  *         post increment. The IN is set active for > 100 us after the 
  *         data is read and written 
@@ -81,8 +83,13 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#ifdef GPIO_SIM
+#include "gpio_sim.h"
+#else
 #include <wiringPi.h>
+#endif
 #include "raspi_gpio.h"
 
 typedef enum {LOAD_CMD, RUN_CMD, WAIT_CMD, RESET_CMD, READ_CMD, 
@@ -102,6 +109,7 @@ int main(int argc, char *argv[]) {
   uint16_t start_adr = START_ADR;
   command_t cmd;
   uint8_t switch_value;
+  int write_level = 1;
     
   // parse command line options
   while ((opt = getopt(argc, argv, "s:inv")) != -1) {
@@ -176,12 +184,28 @@ int main(int argc, char *argv[]) {
     
   usleep(1000);
 
+  if (start_mode && cmd == LOAD_CMD) {
+    // load, reset and count in read mode (R0 is the start address)
+    write_level = digitalRead(WRITE_N);
+    digitalWrite(WRITE_N, 1);
+    digitalWrite(WAIT_N, 0);
+    digitalWrite(CLEAR_N, 0);
+    usleep(100);
+    digitalWrite(WAIT_N, 1);
+    usleep(100);
+    digitalWrite(WAIT_N, 0);
+    usleep(100);
+  }
+
   if (start_mode) {
     for (i = 0; i < start_adr; i++) {
       // count up to the start address
       digitalWrite(IN_N, 0);
       digitalWrite(IN_N, 1);        
     }    
+    if (cmd == LOAD_CMD) {
+      digitalWrite(WRITE_N, write_level);
+    }
   }
 	
   switch (cmd) {
@@ -8,7 +8,9 @@
  *      http://spyr.ch/twiki/bin/view/Cosmac/RaspiElf
  *
  *   	synopsis
- *      $ elf2bin [-s <hexadr>] [-e <hexadr>] [-w] [-r] [<filename>]
+ *      $ elf2bin [-s <hexadr>] [-e <hexadr>] [-w] [-r] [--stats] [<filename>]
+ *      $ elf2bin -m <pinmap> [-s <hexadr>] [-e <hexadr>] [-w] [-r] [--stats]
+ *                <filename> ...
  *          The generated data is written to the standard output stream or to
  *          <filename>. Caution: Overwrite file if it exists.  
  *          Use  > for redirecting (save the file) or | for piping to 
@@ -17,6 +19,11 @@
  *          -e end adress in hex
  *          -w read enable
  *          -r run mode
+ *          --stats transfer statistics (IN strobe histogram, time in
+ *                  GPIO, sleep and file I/O, bytes/s, progress with ETA)
+ *          -m farm mode, all boards of the pin map (see farm_gpio.h) are
+ *             read in lockstep, one file per board (boards with leds=none
+ *             too, their file is filled with 0xff)
  *  
  *  @file 
  *      elf2bin.c
@@ -50,9 +57,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
+#ifdef GPIO_SIM
+#include "gpio_sim.h"
+#else
 #include <wiringPi.h>
+#endif
 #include "raspi_gpio.h"
+#include "transfer_stats.h"
+#include "farm_gpio.h"
 
+int farm_elf2bin(const char *map_fn, int files, char *fn[],
+		 uint16_t start_adr, uint16_t end_adr, uint8_t write_mode,
+		 uint8_t run_mode, uint8_t stats_mode);
 
 int main(int argc, char *argv[]) {
   int i;
@@ -63,9 +80,16 @@ int main(int argc, char *argv[]) {
   uint16_t start_adr = START_ADR;
   uint16_t end_adr = END_ADR;
   FILE *fp;
+  uint64_t t;
+  uint8_t stats_mode = FALSE;
+  const char *map_fn = NULL;
+  static const struct option long_options[] = {
+    {"stats", no_argument, NULL, 'S'},
+    {NULL, 0, NULL, 0}
+  };
     
   // parse command line options
-  while ((opt = getopt(argc, argv, "s:e:wr")) != -1) {
+  while ((opt = getopt_long(argc, argv, "s:e:wrm:", long_options, NULL)) != -1) {
     switch (opt) {
     case 's': 
       start_adr = strtol(optarg, NULL, 16);
@@ -79,13 +103,27 @@ int main(int argc, char *argv[]) {
     case 'r':
       run_mode = TRUE;
       break;
+    case 'S':
+      stats_mode = TRUE;
+      break;
+    case 'm':
+      map_fn = optarg;
+      break;
     default:
       fprintf(stderr, 
-	      "Usage: %s [-s <adr>] [-e <adr>] [-w] [-r] [<filename>]\n", 
-	      argv[0]);
+	      "Usage: %s [-s <adr>] [-e <adr>] [-w] [-r] [--stats] [<filename>]\n"
+	      "       %s -m <pinmap> [-s <adr>] [-e <adr>] [-w] [-r] [--stats] "
+	      "<filename> ...\n", 
+	      argv[0], argv[0]);
       exit(EXIT_FAILURE);
     }
   }
+
+  if (map_fn != NULL) {
+    // several boards in lockstep
+    exit(farm_elf2bin(map_fn, argc - optind, &argv[optind], start_adr,
+		      end_adr, write_mode, run_mode, stats_mode));
+  }
     
   fp = stdout;
   if (optind < argc) {
@@ -123,17 +161,20 @@ int main(int argc, char *argv[]) {
   usleep(100);
   digitalWrite(WAIT_N, 0);
   usleep(100);
+
+  if (stats_mode) {
+    stats_init(end_adr + 1);
+  }
     
   int j = 0;
   for(i = 0; i <= end_adr; i++) {
-    // in clock
-    digitalWrite(IN_N, 0);
-    usleep(100);
-    digitalWrite(IN_N, 1);
-    usleep(100);        
+    in_clock();
     if (i >= start_adr) {
+      t = stats_time();
       data = read_byte();
+      t = stats_add(STATS_GPIO, t);
       fputc(data, fp);
+      stats_add(STATS_FILE, t);
       j++;
     }
   }
@@ -154,12 +195,137 @@ int main(int argc, char *argv[]) {
     digitalWrite(CLEAR_N, 1);    
   }
     
-  fprintf(stderr, "0x%04x bytes read\n", j);
-	
+  t = stats_time();
   fclose(fp);
+  stats_add(STATS_FILE, t);
+
+  stats_print(j);
+  fprintf(stderr, "0x%04x bytes read\n", j);
 	
   exit (0);
 
 }
 
+/*
+ ** ===================================================================
+ **  Method      :  farm_elf2bin
+ */
+/**
+ *  @brief
+ *      Reads all boards of the pin map in lockstep to the files, all
+ *      boards share the IN strobe and the LED ports are read with one
+ *      read per byte
+ *  @param
+ *      map_fn      file name of the pin map
+ *  @param
+ *      files       number of files
+ *  @param
+ *      fn          file names, one per board
+ *  @param
+ *      start_adr   start address
+ *  @param
+ *      end_adr     end address
+ *  @param
+ *      write_mode  write enable at the end
+ *  @param
+ *      run_mode    run at the end
+ *  @param
+ *      stats_mode  transfer statistics
+ *  @return
+ *      int         EXIT_SUCCESS or EXIT_FAILURE
+ */
+/* ===================================================================*/
+int farm_elf2bin(const char *map_fn, int files, char *fn[],
+		 uint16_t start_adr, uint16_t end_adr, uint8_t write_mode,
+		 uint8_t run_mode, uint8_t stats_mode) {
+  FILE *fp[MAX_BOARDS];
+  uint8_t data[MAX_BOARDS];
+  uint64_t t;
+  int boards;
+  int b;
+  int i;
+  int j;
+
+  boards = farm_load_map(map_fn);
+  if (boards < 0) {
+    return EXIT_FAILURE;
+  }
+  if (files != boards) {
+    fprintf(stderr, "%d files for %d boards\n", files, boards);
+    return EXIT_FAILURE;
+  }
+  for (b = 0; b < boards; b++) {
+    fp[b] = fopen(fn[b], "w");
+    if (fp[b] == NULL) {
+      fprintf(stderr, 
+	      "Cannot open file \"%s\"\n", 
+	      fn[b]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (farm_init() != 0) {
+    // can't init ports
+    return EXIT_FAILURE;
+  }
+
+  // read
+  farm_line(FARM_WRITE, 1);
 
+  // load
+  farm_line(FARM_WAIT, 0);
+  farm_line(FARM_CLEAR, 0);
+  usleep(100);
+  // reset
+  farm_line(FARM_WAIT, 1);
+  usleep(100);
+  farm_line(FARM_WAIT, 0);
+  usleep(100);
+
+  stats_in_line(farm_in);
+  if (stats_mode) {
+    stats_init(end_adr + 1);
+  }
+
+  j = 0;
+  for (i = 0; i <= end_adr; i++) {
+    in_clock();
+    if (i >= start_adr) {
+      t = stats_time();
+      farm_read_bytes(data);
+      t = stats_add(STATS_GPIO, t);
+      for (b = 0; b < boards; b++) {
+	fputc(data[b], fp[b]);
+      }
+      stats_add(STATS_FILE, t);
+      j++;
+    }
+  }
+
+  if (write_mode) {
+    // write enable
+    farm_line(FARM_WRITE, 0);
+  } else {
+    // read
+    farm_line(FARM_WRITE, 1);
+  }
+
+  if (run_mode) {
+    // run
+    farm_line(FARM_WAIT, 1);
+    // reset
+    usleep(100);
+    farm_line(FARM_CLEAR, 1);
+  }
+
+  t = stats_time();
+  for (b = 0; b < boards; b++) {
+    fclose(fp[b]);
+  }
+  stats_add(STATS_FILE, t);
+
+  stats_print(j * boards);
+  fprintf(stderr, "0x%04x bytes read from %d boards\n", j, boards);
+
+  return EXIT_SUCCESS;
+}
@@ -4,10 +4,28 @@
  *      shows address and data on micro dot pHAT display.
  *
  *      The console (stdin) can be used as keyboard or the EV_KEY events from USB keypad 
- *      (e.g. /dev/input/event0). 
+ *      (e.g. /dev/input/event0). The main loop waits with epoll for the keys and a 
+ *      timerfd which samples the LEDs every 20 ms. All pending keys are read at once.
+ *
+ *      The Elf can only step its address (R0) forward in LOAD mode, going back means
+ *      a reset and counting up again. The memory is therefore read into a cache on 
+ *      the first access, a window of 256 bytes in one sweep. Browsing is served from
+ *      the cache (P on the console steps back), the written bytes are stored in the
+ *      cache too. The cache is cleared when the Elf runs or the switches were used.
+ *
+ *      The display is written by its own thread at a fixed refresh rate. The main
+ *      loop posts the latest frame (six characters and the decimal points) to a 
+ *      single slot mailbox, a 64 bit word which is stored and loaded atomically. 
+ *      A slow I2C transfer does not delay the keys and the display is not 
+ *      blocked by a burst of keys, frames in between are skipped.
  *
  *      Synopsis
- *        $ elfdisplay [-v] [<device-filename>]
+ *        $ elfdisplay [-v] [-l] [<device-filename>]
+ *
+ *      -l measures the latency from the key event (kernel time stamp of the event
+ *      device) to the end of the GPIO action and to the end of the display update.
+ *      The percentiles per key type are printed at exit (Q, Ctrl-C or SIGTERM).
+ *      test-latency drives elfdisplay with a virtual keypad (uinput).
  *
  *      The decimal points are used to display the modes:
  *
@@ -93,23 +111,108 @@
 #include <time.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
+#ifdef GPIO_SIM
+#include "gpio_sim.h"
+#else
 #include <wiringPi.h>
+#endif
 #include <linux/input.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/ioctl.h>
+#include <signal.h>
 #include "raspi_gpio.h"
 #include "microdot_phat_hex.h"
 
 typedef enum {LOAD, RUN, WAIT, ADDRESS, SWITCH} elf_mode_t;
 
+// a message stays 0.5 s (loops of 20 ms)
+#define MESSAGE_LOOPS 25
+
+// display refresh period
+#define DISPLAY_PERIOD_NS 20000000L
+// mailbox: characters in byte 0 to 5, decimal points in byte 6
+#define DISPLAY_CHARS 6
+#define FRAME_POSTED  (1ULL << 56)
+// latency measurement: key number in the bits 57 to 63 of the mailbox
+#define LATENCY_TAG_SHIFT 57
+#define LATENCY_TAG_MASK  0x7F
+
+static uint64_t display_mailbox;
+static int display_running = TRUE;
+
+// LED sample period
+#define SAMPLE_PERIOD_NS 20000000L
+#define KEY_QUEUE 64
+
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int key_fd = -1;
+static int key_device = FALSE;
+static int key_queue[KEY_QUEUE];
+static unsigned int key_head = 0;
+static unsigned int key_tail = 0;
+static int sample_pending = FALSE;
+static uint64_t key_time[KEY_QUEUE];
+static uint64_t key_stamp = 0;
+static struct termios orig_term_attr;
+static volatile sig_atomic_t quit = FALSE;
+
+// latency measurement (-l)
+#define LATENCY_RECORDS 4096
+
+typedef enum {HEX_KEY, INPUT_KEY, PROTECT_KEY, MODE_KEY, OTHER_KEY,
+	      KEY_TYPES} key_type_t;
+
+typedef struct {
+  key_type_t type;
+  uint64_t event;	// kernel time stamp of the key event
+  uint64_t action;	// GPIO action done
+  uint64_t display;	// display update done
+} latency_t;
+
+static int latency_mode = FALSE;
+static latency_t latency[LATENCY_RECORDS];
+static unsigned int latency_count = 0;
+static unsigned int latency_displayed = 0;
+static uint64_t latency_tag = 0;
+
+// memory cache for LOAD mode
+#define CACHE_WINDOW  256
+#define CACHE_WINDOWS (0x10000 / CACHE_WINDOW)
+
+static uint8_t memory_cache[CACHE_WINDOWS][CACHE_WINDOW];
+static uint8_t window_valid[CACHE_WINDOWS];
+static uint16_t elf_adr = 0;
+
 // local prototypes
 
 void usage_exit(int err_number, const char *str);
-int getkey();
-int getkeyevent(int fd);
+void post_display(const char *text, uint8_t dp);
+void post_hex(uint8_t left, uint8_t middle, uint8_t right, uint8_t dp);
+void *display_thread(void *arg);
+int key_code(const struct input_event *ev);
+int init_keys(int fd);
+void restore_terminal(void);
+void read_keys(void);
+int next_key(void);
+void stop(int sig);
+uint64_t nanoseconds(void);
+key_type_t key_type(int key);
+void begin_latency(int key);
+void end_latency(void);
+int compare_u64(const void *a, const void *b);
+void print_latency(void);
 void inc_elf();
 void reset_elf();
+void seek_elf(uint16_t adr);
+uint8_t read_elf(uint16_t adr);
+void write_elf(uint8_t data);
+void clear_cache();
 void load_elf();
 void run_elf();
 
@@ -118,26 +221,32 @@ int main(int argc, char *argv[]) {
   uint8_t data = 0;
   elf_mode_t elf_mode;
   uint8_t memory_protect;
-  int key;
+  int key = EOF;
   uint8_t hi_nibble = TRUE;
   uint8_t hi_byte = TRUE;
   uint8_t nibble;
   uint8_t hexin = 0;
-  uint8_t in;
+  uint8_t in = 0;
   uint8_t sw;
-  int i;
-  int fd;
+  int fd = -1;
+  int message_loops = 0;
+  pthread_t display;
   
   uint8_t verbose_mode = FALSE;
   uint8_t input_device = FALSE;
+  int clock_id = CLOCK_MONOTONIC;
+  struct sigaction sa;
   int opt;
   
   // parse command line options
-  while ((opt = getopt(argc, argv, "v")) != -1) {
+  while ((opt = getopt(argc, argv, "vl")) != -1) {
     switch (opt) {
     case 'v':
       verbose_mode = TRUE;
       break;
+    case 'l':
+      latency_mode = TRUE;
+      break;
     default:
       usage_exit(EXIT_FAILURE, argv[0]);
       break;
@@ -157,6 +266,10 @@ int main(int argc, char *argv[]) {
 	perror("can not set GRAB mode.");
 	exit (1);
       }
+      if (latency_mode && ioctl(fd, EVIOCSCLOCKID, &clock_id) != 0) {
+	perror("can not set the event clock.");
+	exit (1);
+      }
       input_device = TRUE;
     }
   } else {
@@ -179,47 +292,55 @@ int main(int argc, char *argv[]) {
   clear_display();
   
   // clear display
-  if (write_hex_digits(0xCD, TRUE, 0, 0) < 0) {
-    // can't open I2C
-    fprintf(stderr, "can't open I2C\n");
-    exit(EXIT_FAILURE);
-  }
-  if (write_hex_digits(0x18, 0, 0, 2) < 0) {
-    // can't open I2C
-    fprintf(stderr, "can't open I2C\n");
-    exit(EXIT_FAILURE);
-  }
-  if (write_hex_digits(0x02, 0, 0, 1) < 0) {
+  if (write_text("1802CD", 0x02) < 0) {
     // can't open I2C
     fprintf(stderr, "can't open I2C\n");
     exit(EXIT_FAILURE);
   }
     
+  pthread_create(&display, NULL, display_thread, NULL);
+
   // load mode
   elf_mode = LOAD;
   load_elf();
   reset_elf();
     
-  // read
+  // read, the memory is read through the cache
   digitalWrite(WRITE_N, 1);
   memory_protect = TRUE;
-
-  // get first byte
-  inc_elf();
   
   usleep(1000);
+
+  if (init_keys(fd) != 0) {
+    perror("can not wait for keys");
+    exit(EXIT_FAILURE);
+  }
+
+  // Ctrl-C and SIGTERM leave the loop like Q
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
      
   while(key != 'Q') {
-    if (input_device) {
-      // get key from event device
-      key = toupper(getkeyevent(fd));
-      if (key == ' ') {
-        printf("wrong key\n");
-      }
-    } else {
-      // get key from stdin
-      usleep(20000);
-      key = toupper(getkey());
+    // all keys queued, EOF every sample period
+    key = toupper(next_key());
+    if (input_device && key == ' ') {
+      printf("wrong key\n");
+      post_display("  KEY?", 0);
+      message_loops = MESSAGE_LOOPS;
+      continue;
+    }
+
+    if (key == EOF && message_loops > 0) {
+      // the message stays for a while
+      message_loops--;
+      continue;
+    }
+    message_loops = 0;
+
+    if (latency_mode && key != EOF && key != 'Q') {
+      begin_latency(key);
     }
 
     // read hex keys
@@ -262,8 +383,13 @@ int main(int argc, char *argv[]) {
       }
     }
 
-    if (elf_mode != SWITCH) {
+    if (elf_mode == RUN || elf_mode == WAIT) {
       in = read_byte();
+    } else if ((elf_mode == LOAD || elf_mode == ADDRESS) && memory_protect) {
+      // the address input shows the byte at the address typed so far
+      in = read_elf(adr);
+    }
+    if (elf_mode != SWITCH) {
       sw = read_switches();
     }
     
@@ -273,17 +399,27 @@ int main(int argc, char *argv[]) {
       switch (key) {
       case EOF:
 	// no key pressed
-	write_hex_digits(memory_protect?in:data, TRUE, memory_protect, 0);
-	write_hex_digits(adr & 0x00FF, FALSE, FALSE, 1);
-	write_hex_digits(adr >> 8, TRUE, FALSE, 2);             
+	post_hex(adr >> 8, adr & 0x00FF, memory_protect?in:data,
+		 0x22 | memory_protect);
 	break;
       case '\n':
       case 'I':
 	// INPUT key
+	if (!memory_protect) {
+	  write_elf(data);
+	}
 	adr++;
 	hi_nibble = TRUE;
-	inc_elf();
 	break; 
+      case 'P':
+	// previous address
+	adr--;
+	hi_nibble = TRUE;
+	if (!memory_protect) {
+	  seek_elf(adr);
+	  digitalWrite(WRITE_N, 0);
+	}
+	break;
       case '-':
       case 'W':
       case 'M':
@@ -292,18 +428,12 @@ int main(int argc, char *argv[]) {
 	  // disable memory protect (write)
 	  memory_protect = FALSE;	
 	  // set address
-	  reset_elf();
-	  // count up to adr
-	  for (i=0; i<adr; i++) {
-	    inc_elf();
-	  }
+	  seek_elf(adr);
 	  digitalWrite(WRITE_N, 0);
 	} else {
 	  // memory protect for LOAD (read)
 	  memory_protect = TRUE;
 	  digitalWrite(WRITE_N, 1);
-	  // get first byte
-	  inc_elf(); 
 	}
 	hi_nibble = TRUE;
 	break;
@@ -316,6 +446,8 @@ int main(int argc, char *argv[]) {
 	memory_protect = FALSE;	
 	digitalWrite(WRITE_N, 0);
 	run_elf();
+	post_display("   RUN", 0);
+	message_loops = MESSAGE_LOOPS;
 	break;
       case '+':
       case 'L':
@@ -324,6 +456,8 @@ int main(int argc, char *argv[]) {
 	hi_nibble = TRUE;
 	hi_byte = TRUE;
 	hexin = adr >> 8;
+	post_display("  ADDR", 0);
+	message_loops = MESSAGE_LOOPS;
 	break;
       case 0x08: // backspace
       case 'K':
@@ -335,15 +469,13 @@ int main(int argc, char *argv[]) {
 	// read (the switch on EMC can override)
 	digitalWrite(WRITE_N, 1);	
 	elf_mode = SWITCH;
-	clear_display();
+	post_display("", 0);
       }
       break;
     case RUN:
       switch (key) {
       case EOF:
-	write_hex_digits(sw, TRUE, memory_protect, 0);
-	write_hex_digits(in, FALSE, FALSE, 1);
-	write_hex_digits(0, FALSE, TRUE, 2);
+	post_hex(0, in, sw, 0x12 | memory_protect);
 	break;
       case '-':
       case 'W':
@@ -364,6 +496,8 @@ int main(int argc, char *argv[]) {
 	digitalWrite(WAIT_N, 0);
 	elf_mode = WAIT;
 	hi_nibble = TRUE;
+	post_display("  WAIT", 0);
+	message_loops = MESSAGE_LOOPS;
 	break;
       case '+':
       case 'L':
@@ -374,9 +508,9 @@ int main(int argc, char *argv[]) {
 	memory_protect = TRUE;
 	digitalWrite(WRITE_N, 1);
 	elf_mode = LOAD;
-	// get first byte
-	inc_elf();
 	hi_nibble = TRUE;
+	post_display("  LOAD", 0);
+	message_loops = MESSAGE_LOOPS;
 	break;
       case 0x08: // backspace
       case 'K':
@@ -388,15 +522,13 @@ int main(int argc, char *argv[]) {
 	// read (the switch on EMC can override)
 	digitalWrite(WRITE_N, 1);	
 	elf_mode = SWITCH;
-	clear_display();
+	post_display("", 0);
       }
       break;
     case WAIT:
       switch (key) {
       case EOF:
-	write_hex_digits(sw, TRUE, memory_protect, 0);
-	write_hex_digits(in, TRUE, FALSE, 1);
-	write_hex_digits(0, FALSE, FALSE, 2);
+	post_hex(0, in, sw, 0x0A | memory_protect);
 	break;
       case '-':
       case 'W':
@@ -416,6 +548,8 @@ int main(int argc, char *argv[]) {
 	elf_mode = RUN;
 	hi_nibble = TRUE;
 	run_elf();
+	post_display("   RUN", 0);
+	message_loops = MESSAGE_LOOPS;
 	break;
       case '+':
       case 'L':
@@ -426,9 +560,9 @@ int main(int argc, char *argv[]) {
 	memory_protect = TRUE;
 	digitalWrite(WRITE_N, 1);
 	elf_mode = LOAD;
-	// get first byte
-	inc_elf();
 	hi_nibble = TRUE;
+	post_display("  LOAD", 0);
+	message_loops = MESSAGE_LOOPS;
 	break;
       case 0x08: // backspace
       case 'K':
@@ -440,32 +574,23 @@ int main(int argc, char *argv[]) {
 	// read (the switch on EMC can override)
 	digitalWrite(WRITE_N, 1);	
 	elf_mode = SWITCH;
-	clear_display();
+	post_display("", 0);
       }
       break;
     case ADDRESS:
       switch (key) {
       case EOF:
 	// no key pressed
-	// write_hex_digits(read_switches(), TRUE, memory_protect, 0);
-	write_hex_digits(adr & 0x00FF, FALSE, TRUE, 1);
-	write_hex_digits(adr >> 8, TRUE, FALSE, 2);             
+	post_hex(adr >> 8, adr & 0x00FF, memory_protect?in:data, 0x24);
 	break;
       case '+':
       case 'L':
       case 'I':
       case '\n':
 	// address input completed
-	reset_elf();
-	// count up to adr
-	digitalWrite(WRITE_N, 1);
-	for (i=0; i<adr; i++) {
-	  inc_elf();
-	}
-	if (memory_protect) {
-	  // get first byte
-	  inc_elf();
-	} else {
+	if (!memory_protect) {
+	  // set address
+	  seek_elf(adr);
 	  digitalWrite(WRITE_N, 0);
 	}
 	elf_mode = LOAD;
@@ -485,180 +610,547 @@ int main(int argc, char *argv[]) {
 	memory_protect = TRUE;
 	digitalWrite(WRITE_N, 1);
 	adr = 0;
-	// get first byte
-	inc_elf();
+	// the switches may have changed the memory
+	clear_cache();
 	elf_mode = LOAD;
 	hi_nibble = TRUE;
+	post_display("  LOAD", 0);
+	message_loops = MESSAGE_LOOPS;
 	break;
       }
       break;
     }
-        
+
+    if (latency_mode && key != EOF && key != 'Q') {
+      end_latency();
+    }
   } 
     
+  __atomic_store_n(&display_running, FALSE, __ATOMIC_RELEASE);
+  pthread_join(display, NULL);
+  close_display();
+  if (latency_mode) {
+    print_latency();
+  }
   exit(0);   
 }
 
 void usage_exit(int err_number, const char *str) {
   fprintf(stderr, "\
-Usage: %s [-v] [<device-filename>]\n\
+Usage: %s [-v] [-l] [<device-filename>]\n\
 -v verbose\n\
+-l key latency measurement\n\
 \n",
 	  str);
   exit(err_number);
 }
 
-int getkeyevent(int fd) {
-  int k;
-  size_t rb;
-  struct input_event ev;
-  fd_set rfds;
-  struct timeval tv;
-
-  /* Watch fd to see when it has input. */
-  FD_ZERO(&rfds);
-  FD_SET(fd, &rfds);
-  tv.tv_sec = 0;
-  tv.tv_usec = 20000;
-  
-  int retval = select(fd+1, &rfds, NULL, NULL, &tv);
-
-  if (retval == -1) {
-    perror("select()");
-    k = EOF;
-  } else if (retval) {
-    // Data is available now
-    rb=read(fd, &ev, sizeof(struct input_event));
-
-    if (rb < (int) sizeof(struct input_event)) {
-      perror("evtest: short read");
-      k = EOF;
-    }
+/*
+ ** ===================================================================
+ **  Method      :  post_display
+ */
+/**
+ *  @brief
+ *      Posts the next frame to the display thread, replaces a frame which
+ *      is not shown yet
+ *  @param
+ *      text    up to six characters, left to right
+ *  @param
+ *      dp      decimal points, bit 0 is the rightmost character
+ */
+/* ===================================================================*/
+void post_display(const char *text, uint8_t dp) {
+  uint64_t frame = FRAME_POSTED | (uint64_t) dp << (8 * DISPLAY_CHARS) |
+    latency_tag;
+  int i;
+
+  for (i = 0; i < DISPLAY_CHARS && text[i]; i++) {
+    frame |= (uint64_t) (uint8_t) text[i] << (8 * i);
+  }
+  __atomic_store_n(&display_mailbox, frame, __ATOMIC_RELEASE);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  post_hex
+ */
+/**
+ *  @brief
+ *      Posts three bytes as hex digits
+ *  @param
+ *      left    left module
+ *  @param
+ *      middle  middle module
+ *  @param
+ *      right   right module
+ *  @param
+ *      dp      decimal points, bit 0 is the rightmost digit
+ */
+/* ===================================================================*/
+void post_hex(uint8_t left, uint8_t middle, uint8_t right, uint8_t dp) {
+  char text[DISPLAY_CHARS + 1];
 
-    if (EV_KEY == ev.type) {
-      // key event
-      if (ev.value == 0 || ev.value == 2) {
-	// key pressed or key repeat
-	switch (ev.code) {
-	case 1:
-	  // escape
-	  k = 'd';
-	  break;
-	case 29:
-	  // Ctrl
-	  k = 'e';
-	  break;
-	case 56:
-	  // Alt
-	  k = 'f';
-	  break;
-	case 14:
-	  // CLR
-	  k = 8;
-	  break;
-	case 69:
-	  // NumLock
-	  k = 'a';
-	  break;
-	case 98:
-	  // /
-	  k = 'b';
-	  break;
-	case 55:
-	  // *
-	  k = 'c';
-	  break;
-	case 74:
-	  // -
-	  k = '-';
-	  break;
-	case 71:
-	  // 7
-	  k = '7';
-	  break;
-	case 72:
-	  // 8
-	  k = '8';
-	  break;
-	case 73:
-	  // 9
-	  k = '9';
-	  break;
-	case 75:
-	  // 4
-	  k = '4';
-	  break;
-	case 76:
-	  // 5
-	  k = '5';
-	  break;
-	case 77:
-	  // 6
-	  k = '6';
-	  break;
-	case 78:
-	  // +
-	  k = '+';
-	  break;
-	case 79:
-	  // 1
-	  k = '1';
-	  break;
-	case 80:
-	  // 2
-	  k = '2';
-	  break;
-	case 81:
-	  // 3
-	  k = '3';
-	  break;
-	case 82:
-	  // 0
-	  k = '0';
-	  break;
-	case 83:
-	  // .
-	  k = '.';
-	  break;
-	case 96:
-	  // Enter
-	  k = '\n';
-	  break;
-	default:
-	  k = ' ';
-	  break;
+  snprintf(text, sizeof(text), "%02X%02X%02X", left, middle, right);
+  post_display(text, dp);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  display_thread
+ */
+/**
+ *  @brief
+ *      Shows the latest posted frame every refresh period. Unchanged
+ *      frames are skipped by the display driver.
+ *  @param
+ *      arg     not used
+ *  @return
+ *      void*   NULL
+ */
+/* ===================================================================*/
+void *display_thread(void *arg) {
+  struct timespec next;
+  uint64_t frame;
+  uint64_t shown = 0;
+  char text[DISPLAY_CHARS + 1];
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while (__atomic_load_n(&display_running, __ATOMIC_ACQUIRE)) {
+    frame = __atomic_load_n(&display_mailbox, __ATOMIC_ACQUIRE);
+    if ((frame & FRAME_POSTED) && frame != shown) {
+      for (i = 0; i < DISPLAY_CHARS; i++) {
+	text[i] = frame >> (8 * i);
+      }
+      text[DISPLAY_CHARS] = '\0';
+      if (write_text(text, frame >> (8 * DISPLAY_CHARS)) == 0) {
+	shown = frame;
+      }
+      if (latency_mode) {
+	// the keys up to the tag are on the display now
+	while ((latency_displayed & LATENCY_TAG_MASK) !=
+	       frame >> LATENCY_TAG_SHIFT) {
+	  latency[latency_displayed++].display = nanoseconds();
 	}
       }
     }
-  } else {
-    // timeout
-    k = EOF;
+    next.tv_nsec += DISPLAY_PERIOD_NS;
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+  return NULL;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  key_code
+ */
+/**
+ *  @brief
+ *      Translates an event of the keypad
+ *  @param
+ *      ev      input event
+ *  @return
+ *      int     key, ' ' unknown key, EOF no key (other event or key down)
+ */
+/* ===================================================================*/
+int key_code(const struct input_event *ev) {
+  int k = EOF;
+
+  if (EV_KEY == ev->type) {
+    // key event
+    if (ev->value == 0 || ev->value == 2) {
+      // key pressed or key repeat
+      switch (ev->code) {
+      case 1:
+	// escape
+	k = 'd';
+	break;
+      case 29:
+	// Ctrl
+	k = 'e';
+	break;
+      case 56:
+	// Alt
+	k = 'f';
+	break;
+      case 14:
+	// CLR
+	k = 8;
+	break;
+      case 69:
+	// NumLock
+	k = 'a';
+	break;
+      case 98:
+	// /
+	k = 'b';
+	break;
+      case 55:
+	// *
+	k = 'c';
+	break;
+      case 74:
+	// -
+	k = '-';
+	break;
+      case 71:
+	// 7
+	k = '7';
+	break;
+      case 72:
+	// 8
+	k = '8';
+	break;
+      case 73:
+	// 9
+	k = '9';
+	break;
+      case 75:
+	// 4
+	k = '4';
+	break;
+      case 76:
+	// 5
+	k = '5';
+	break;
+      case 77:
+	// 6
+	k = '6';
+	break;
+      case 78:
+	// +
+	k = '+';
+	break;
+      case 79:
+	// 1
+	k = '1';
+	break;
+      case 80:
+	// 2
+	k = '2';
+	break;
+      case 81:
+	// 3
+	k = '3';
+	break;
+      case 82:
+	// 0
+	k = '0';
+	break;
+      case 83:
+	// .
+	k = '.';
+	break;
+      case 96:
+	// Enter
+	k = '\n';
+	break;
+      default:
+	k = ' ';
+	break;
+      }
+    }
   }
   return (k);
 }
 
-int getkey() {
-  int character;
-  struct termios orig_term_attr;
+/*
+ ** ===================================================================
+ **  Method      :  init_keys
+ */
+/**
+ *  @brief
+ *      Waits for the keys (keypad or stdin) and the LED sample timer
+ *      with epoll. The terminal is switched to raw mode once.
+ *  @param
+ *      fd              keypad event device, -1 stdin
+ *  @return
+ *      int             0 ok, -1 error
+ */
+/* ===================================================================*/
+int init_keys(int fd) {
+  struct itimerspec period;
+  struct epoll_event ev;
   struct termios new_term_attr;
 
-  /* set the terminal to raw mode */
-  tcgetattr(fileno(stdin), &orig_term_attr);
-  memcpy(&new_term_attr, &orig_term_attr, sizeof(struct termios));
-  new_term_attr.c_lflag &= ~(ECHO|ICANON);
-  //new_term_attr.c_lflag &= ~(ICANON);
-  new_term_attr.c_cc[VTIME] = 0;
-  new_term_attr.c_cc[VMIN] = 0;
-  tcsetattr(fileno(stdin), TCSANOW, &new_term_attr);
+  if (fd < 0) {
+    fd = fileno(stdin);
+    if (isatty(fd) && tcgetattr(fd, &orig_term_attr) == 0) {
+      // set the terminal to raw mode, restored at exit
+      memcpy(&new_term_attr, &orig_term_attr, sizeof(struct termios));
+      new_term_attr.c_lflag &= ~(ECHO|ICANON);
+      new_term_attr.c_cc[VTIME] = 0;
+      new_term_attr.c_cc[VMIN] = 0;
+      tcsetattr(fd, TCSANOW, &new_term_attr);
+      atexit(restore_terminal);
+    }
+  } else {
+    key_device = TRUE;
+  }
+  key_fd = fd;
+  fcntl(key_fd, F_SETFL, fcntl(key_fd, F_GETFL) | O_NONBLOCK);
 
-  /* read a character from the stdin stream without blocking */
-  /*   returns EOF (-1) if no character is available */
-  character = fgetc(stdin);
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+  epoll_fd = epoll_create(2);
+  if (timer_fd < 0 || epoll_fd < 0) {
+    return (-1);
+  }
+  period.it_interval.tv_sec = 0;
+  period.it_interval.tv_nsec = SAMPLE_PERIOD_NS;
+  period.it_value = period.it_interval;
+  timerfd_settime(timer_fd, 0, &period, NULL);
 
-  /* restore the original terminal attributes */
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = timer_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) != 0) {
+    return (-1);
+  }
+  ev.data.fd = key_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, key_fd, &ev) != 0) {
+    return (-1);
+  }
+  return (0);
+}
+
+void restore_terminal(void) {
   tcsetattr(fileno(stdin), TCSANOW, &orig_term_attr);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  read_keys
+ */
+/**
+ *  @brief
+ *      Reads all pending keys into the key queue
+ */
+/* ===================================================================*/
+void read_keys(void) {
+  struct input_event ev[KEY_QUEUE];
+  unsigned char c[KEY_QUEUE];
+  ssize_t rb;
+  int k;
+  int i;
+
+  while (key_tail - key_head < KEY_QUEUE) {
+    if (key_device) {
+      rb = read(key_fd, ev, sizeof(ev[0]) * (KEY_QUEUE - (key_tail - key_head)));
+      for (i = 0; i < rb / (ssize_t) sizeof(ev[0]); i++) {
+	k = key_code(&ev[i]);
+	if (k != EOF) {
+	  key_time[key_tail % KEY_QUEUE] =
+	    ev[i].time.tv_sec * 1000000000ULL + ev[i].time.tv_usec * 1000ULL;
+	  key_queue[key_tail++ % KEY_QUEUE] = k;
+	}
+      }
+    } else {
+      rb = read(key_fd, c, KEY_QUEUE - (key_tail - key_head));
+      for (i = 0; i < rb; i++) {
+	// no event time from stdin
+	key_time[key_tail % KEY_QUEUE] = nanoseconds();
+	key_queue[key_tail++ % KEY_QUEUE] = c[i];
+      }
+    }
+    if (rb == 0) {
+      // end of file, no more keys
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, key_fd, NULL);
+      break;
+    }
+    if (rb < 0) {
+      // all read (EAGAIN)
+      break;
+    }
+  }
+}
 
-  return character;
+/*
+ ** ===================================================================
+ **  Method      :  next_key
+ */
+/**
+ *  @brief
+ *      Returns the next key, waits for a key or the LED sample timer
+ *  @return
+ *      int     key, EOF sample the LEDs and refresh the display
+ */
+/* ===================================================================*/
+int next_key(void) {
+  struct epoll_event ev[2];
+  uint64_t expirations;
+  int n;
+  int i;
+
+  while (key_head == key_tail) {
+    if (sample_pending) {
+      sample_pending = FALSE;
+      return (EOF);
+    }
+    n = epoll_wait(epoll_fd, ev, 2, -1);
+    if (quit) {
+      return ('Q');
+    }
+    for (i = 0; i < n; i++) {
+      if (ev[i].data.fd == timer_fd) {
+	if (read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+	  sample_pending = TRUE;
+	}
+      } else {
+	read_keys();
+      }
+    }
+  }
+  key_stamp = key_time[key_head % KEY_QUEUE];
+  return (key_queue[key_head++ % KEY_QUEUE]);
+}
+
+void stop(int sig) {
+  quit = TRUE;
+}
+
+uint64_t nanoseconds(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+key_type_t key_type(int key) {
+  if ((key >= '0' && key <= '9') || (key >= 'A' && key <= 'F')) {
+    return (HEX_KEY);
+  }
+  switch (key) {
+  case '\n':
+  case 'I':
+  case 'P':
+    return (INPUT_KEY);
+  case '-':
+  case 'W':
+  case 'M':
+    return (PROTECT_KEY);
+  case '.':
+  case 'R':
+  case '+':
+  case 'L':
+  case 0x08:
+  case 'K':
+  case 'S':
+    return (MODE_KEY);
+  default:
+    return (OTHER_KEY);
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  begin_latency
+ */
+/**
+ *  @brief
+ *      Records the event time of a key. The frames posted from now on
+ *      carry the key number, the display thread adds the time when the
+ *      frame is shown.
+ *  @param
+ *      key     key to handle
+ */
+/* ===================================================================*/
+void begin_latency(int key) {
+  if (latency_count >= LATENCY_RECORDS - 1) {
+    // full
+    return;
+  }
+  latency[latency_count].type = key_type(key);
+  latency[latency_count].event = key_stamp;
+  latency[latency_count].action = 0;
+  latency_count++;
+  latency_tag = (uint64_t) (latency_count & LATENCY_TAG_MASK)
+    << LATENCY_TAG_SHIFT;
+}
+
+void end_latency(void) {
+  // GPIO action of the last key done
+  if (latency_count > 0 && latency[latency_count - 1].action == 0) {
+    latency[latency_count - 1].action = nanoseconds();
+  }
+}
+
+int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  print_latency
+ */
+/**
+ *  @brief
+ *      Prints p50, p95 and p99 of the key to action and the key to
+ *      display latency and a histogram of the display latency per key
+ *      type
+ */
+/* ===================================================================*/
+void print_latency(void) {
+  static const char *type_name[KEY_TYPES] = {"hex", "input", "protect",
+					     "mode", "other"};
+  static const uint64_t bucket_ms[] = {1, 2, 5, 10, 20, 50, 100};
+  static uint64_t action[LATENCY_RECORDS];
+  static uint64_t display[LATENCY_RECORDS];
+  unsigned int histogram[sizeof(bucket_ms) / sizeof(bucket_ms[0]) + 1];
+  unsigned int buckets = sizeof(bucket_ms) / sizeof(bucket_ms[0]);
+  unsigned int n, d;
+  unsigned int i, b;
+  int t;
+
+  printf("%u keys, latency in ms    action: p50    p95    p99"
+	 "   display: p50    p95    p99\n", latency_count);
+  for (t = 0; t < KEY_TYPES; t++) {
+    n = 0;
+    d = 0;
+    memset(histogram, 0, sizeof(histogram));
+    for (i = 0; i < latency_count; i++) {
+      if (latency[i].type != t) {
+	continue;
+      }
+      action[n++] = latency[i].action - latency[i].event;
+      if (i < latency_displayed) {
+	display[d] = latency[i].display - latency[i].event;
+	for (b = 0; b < buckets && display[d] >= bucket_ms[b] * 1000000; b++);
+	histogram[b]++;
+	d++;
+      }
+    }
+    if (n == 0) {
+      continue;
+    }
+    qsort(action, n, sizeof(action[0]), compare_u64);
+    qsort(display, d, sizeof(display[0]), compare_u64);
+    printf("%-8s %5u keys         %7.3f %6.3f %6.3f", type_name[t], n,
+	   action[n / 2] / 1e6, action[n * 95 / 100] / 1e6,
+	   action[n * 99 / 100] / 1e6);
+    if (d > 0) {
+      printf("        %7.3f %6.3f %6.3f\n", display[d / 2] / 1e6,
+	     display[d * 95 / 100] / 1e6, display[d * 99 / 100] / 1e6);
+      printf("         display histogram:");
+      for (b = 0; b <= buckets; b++) {
+	if (b < buckets) {
+	  printf(" <%llu:%u", (unsigned long long) bucket_ms[b], histogram[b]);
+	} else {
+	  printf(" >=%llu:%u", (unsigned long long) bucket_ms[b - 1],
+		 histogram[b]);
+	}
+      }
+      printf("\n");
+    } else {
+      printf("        (not displayed)\n");
+    }
+  }
 }
 
 void inc_elf() {
@@ -673,6 +1165,85 @@ void reset_elf() {
   usleep(100);
   digitalWrite(WAIT_N, 0);
   usleep(100);
+  elf_adr = 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  seek_elf
+ */
+/**
+ *  @brief
+ *      Sets the address (R0) of the Elf in LOAD mode, counts up from 
+ *      the current address or after a reset. WRITE_N is left high.
+ *  @param
+ *      adr     address
+ */
+/* ===================================================================*/
+void seek_elf(uint16_t adr) {
+  if (adr < elf_adr) {
+    reset_elf();
+  }
+  digitalWrite(WRITE_N, 1);
+  while (elf_adr != adr) {
+    inc_elf();
+    elf_adr++;
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  read_elf
+ */
+/**
+ *  @brief
+ *      Reads a byte from the cache, a missing window is read from the
+ *      Elf in one sweep (LOAD mode with memory protect)
+ *  @param
+ *      adr         address
+ *  @return
+ *      uint8_t     data
+ */
+/* ===================================================================*/
+uint8_t read_elf(uint16_t adr) {
+  uint8_t *window = memory_cache[adr / CACHE_WINDOW];
+  int i;
+
+  if (!window_valid[adr / CACHE_WINDOW]) {
+    seek_elf(adr - adr % CACHE_WINDOW);
+    for (i=0; i<CACHE_WINDOW; i++) {
+      // the Elf shows the byte at R0 and increments R0
+      inc_elf();
+      elf_adr++;
+      window[i] = read_byte();
+    }
+    window_valid[adr / CACHE_WINDOW] = TRUE;
+  }
+  return (window[adr % CACHE_WINDOW]);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  write_elf
+ */
+/**
+ *  @brief
+ *      Writes the data on the switches to the current address (LOAD 
+ *      mode without memory protect) and into the cache
+ *  @param
+ *      data    data on the switches
+ */
+/* ===================================================================*/
+void write_elf(uint8_t data) {
+  inc_elf();
+  if (window_valid[elf_adr / CACHE_WINDOW]) {
+    memory_cache[elf_adr / CACHE_WINDOW][elf_adr % CACHE_WINDOW] = data;
+  }
+  elf_adr++;
+}
+
+void clear_cache() {
+  memset(window_valid, 0, sizeof(window_valid));
 }
 
 void load_elf() {
@@ -682,6 +1253,8 @@ void load_elf() {
 }
 
 void run_elf() {
+  // the program may change the memory
+  clear_cache();
   digitalWrite(WAIT_N, 1);
   digitalWrite(CLEAR_N, 1);
 }
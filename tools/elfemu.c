@@ -0,0 +1,404 @@
+/**
+ *  @brief
+ *      Runs an 1802 program without a board: an Elf (Membership Card)
+ *      with the CDP1802 emulator (cdp1802.c) and 64 KiB memory.
+ *
+ *      The program (Intel HEX, e.g. chase.hex, or a binary) is loaded
+ *      and started at 0 after a reset. OUT 4 writes the LEDs, INP 4 reads
+ *      the data switches. Q is the Q LED, EF4 is the IN button. The
+ *      program runs as fast as possible or paced to the clock of the
+ *      Elf (-t). The run ends with IDL, the instruction limit or Ctrl-C.
+ *      The summary on stderr has the instructions, the emulated time
+ *      and the instructions/s, as a benchmark of the emulator.
+ *
+ *   	synopsis
+ *       $ elfemu [-a <hexadr>] [-S <hexdata>] [-i] [-n <count>] [-c <Hz>]
+ *                [-t] [-l] <filename>
+ *
+ *     -a adr
+ *        load address of a binary file in hex (0 is default)
+ *     -S data
+ *        data switches in hex (00 is default)
+ *     -i
+ *        the IN button is pressed (EF4)
+ *     -n count
+ *        stops after count instructions
+ *     -c Hz
+ *        clock of the Elf (1789773 is default)
+ *     -t
+ *        real time, the program runs at the clock of the Elf
+ *     -l
+ *        logs the changes of the LEDs and Q to stdout, the time is the
+ *        emulated time (as elfscope -v)
+ *
+ *      The file is Intel HEX if its name ends with .hex.
+ *  @file
+ *      elfemu.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include "cdp1802.h"
+
+#define ELF_CLOCK       1789773     // Hz
+#define LED_PORT        4
+#define EF_IN           0x08        // EF4
+#define SLICE_US        1000        // run time between the checks
+#define MAX_LINE_LENGTH 600
+
+void usage_exit(int err_number, const char *str);
+void stop_run(int sig);
+uint64_t nanoseconds(void);
+int load_hex(const char *fn, uint8_t *memory);
+int load_bin(const char *fn, uint8_t *memory, uint16_t adr);
+void out_port(cdp1802_t *cpu, int port, uint8_t data);
+uint8_t in_port(cdp1802_t *cpu, int port);
+void q_changed(cdp1802_t *cpu, int q);
+
+static uint8_t memory[CDP1802_MEMORY_SIZE];
+static volatile sig_atomic_t running = true;
+static uint8_t leds = 0;
+static uint8_t switches = 0;
+static uint8_t log_mode = false;
+static long clock_hz = ELF_CLOCK;
+
+int main(int argc, char *argv[]) {
+  cdp1802_t cpu;
+  cdp1802_state_t state = CDP1802_RUN;
+  struct timespec ts;
+  uint16_t load_adr = 0;
+  uint64_t limit = 0;
+  uint64_t start;
+  uint64_t target;
+  uint64_t wall;
+  uint32_t slice;
+  double emulated;
+  size_t len;
+  int bytes;
+  int opt;
+
+  uint8_t in_button = false;
+  uint8_t realtime_mode = false;
+
+  // parse command line options
+  while ((opt = getopt(argc, argv, "a:S:in:c:tl")) != -1) {
+    switch (opt) {
+    case 'a':
+      load_adr = strtol(optarg, NULL, 16);
+      break;
+    case 'S':
+      switches = strtol(optarg, NULL, 16);
+      break;
+    case 'i':
+      in_button = true;
+      break;
+    case 'n':
+      limit = strtoull(optarg, NULL, 10);
+      break;
+    case 'c':
+      clock_hz = strtol(optarg, NULL, 10);
+      break;
+    case 't':
+      realtime_mode = true;
+      break;
+    case 'l':
+      log_mode = true;
+      break;
+    default:
+      usage_exit(EXIT_FAILURE, argv[0]);
+      break;
+    }
+  }
+  if (optind >= argc || clock_hz <= 0) {
+    usage_exit(EXIT_FAILURE, argv[0]);
+  }
+
+  len = strlen(argv[optind]);
+  if (len > 4 && strcmp(argv[optind] + len - 4, ".hex") == 0) {
+    bytes = load_hex(argv[optind], memory);
+  } else {
+    bytes = load_bin(argv[optind], memory, load_adr);
+  }
+  if (bytes < 0) {
+    exit(EXIT_FAILURE);
+  }
+
+  cdp1802_init(&cpu, memory);
+  cpu.out = out_port;
+  cpu.in = in_port;
+  cpu.q_changed = q_changed;
+  cpu.ef = in_button ? EF_IN : 0;
+
+  signal(SIGINT, stop_run);
+  // an instruction is 2 machine cycles (16 clocks) mostly
+  slice = (uint64_t) clock_hz * SLICE_US / 16000000;
+  if (slice == 0) {
+    slice = 1;
+  }
+  start = nanoseconds();
+  while (running && state == CDP1802_RUN) {
+    if (limit != 0 && limit - cpu.instructions < slice) {
+      slice = limit - cpu.instructions;
+    }
+    state = cdp1802_run(&cpu, slice);
+    if (limit != 0 && cpu.instructions >= limit) {
+      break;
+    }
+    if (realtime_mode) {
+      // wait for the time of the emulated cycles
+      target = start + (uint64_t) ((double) cpu.cycles * CDP1802_CLOCKS *
+				   1e9 / clock_hz);
+      if (target > nanoseconds()) {
+	ts.tv_sec = target / 1000000000;
+	ts.tv_nsec = target % 1000000000;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+      }
+    }
+  }
+  wall = nanoseconds() - start;
+  emulated = (double) cpu.cycles * CDP1802_CLOCKS / clock_hz;
+
+  switch (state) {
+  case CDP1802_IDLE:
+    fprintf(stderr, "IDL at 0x%04x\n", (uint16_t) (cpu.r[cpu.p] - 1));
+    break;
+  case CDP1802_ILLEGAL:
+    fprintf(stderr, "illegal instruction 0x%02x at 0x%04x\n",
+	    memory[(uint16_t) (cpu.r[cpu.p] - 1)],
+	    (uint16_t) (cpu.r[cpu.p] - 1));
+    break;
+  default:
+    fprintf(stderr, "stopped at 0x%04x\n", cpu.r[cpu.p]);
+    break;
+  }
+  fprintf(stderr, "LED:%02x Q:%1x D:%02x DF:%1x P:%1x X:%1x\n",
+	  leds, cpu.q, cpu.d, cpu.df, cpu.p, cpu.x);
+  fprintf(stderr, "%llu instructions, %llu machine cycles, %.6f s at %ld Hz "
+	  "in %.6f s\n",
+	  (unsigned long long) cpu.instructions,
+	  (unsigned long long) cpu.cycles, emulated, clock_hz, wall / 1e9);
+  if (wall > 0) {
+    fprintf(stderr, "%.0f instructions/s, %.1f x real time\n",
+	    cpu.instructions * 1e9 / wall, emulated * 1e9 / wall);
+  }
+
+  exit(state == CDP1802_ILLEGAL ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+void usage_exit(int err_number, const char *str) {
+  fprintf(stderr, "\
+Usage: %s [-a <adr>] [-S <data>] [-i] [-n <count>] [-c <Hz>] [-t] [-l] <filename>\n\
+-a load address of a binary file in hex\n\
+-S data switches in hex\n\
+-i IN button pressed (EF4)\n\
+-n stop after count instructions\n\
+-c clock of the Elf in Hz\n\
+-t real time\n\
+-l log the LED and Q changes\n",
+	  str);
+  exit(err_number);
+}
+
+void stop_run(int sig) {
+  (void) sig;
+  running = false;
+}
+
+uint64_t nanoseconds(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  load_hex
+ */
+/**
+ *  @brief
+ *      Loads an Intel HEX file (data and end of file records)
+ *  @param
+ *      fn          file name
+ *  @param
+ *      memory      memory of the Elf
+ *  @return
+ *      int         number of bytes, -1 error (printed to stderr)
+ */
+/* ===================================================================*/
+int load_hex(const char *fn, uint8_t *memory) {
+  char line[MAX_LINE_LENGTH];
+  unsigned int byte[MAX_LINE_LENGTH / 2];
+  unsigned int count;
+  uint8_t sum;
+  int line_number = 0;
+  int bytes = 0;
+  int i;
+  FILE *fp;
+
+  fp = fopen(fn, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot open file \"%s\"\n", fn);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    line_number++;
+    if (line[0] != ':') {
+      continue;
+    }
+    // count, address (2 bytes), type, data and checksum
+    if (sscanf(line + 1, "%2x", &count) != 1 || count + 5 > MAX_LINE_LENGTH / 2) {
+      break;
+    }
+    sum = 0;
+    for (i = 0; i < (int) count + 5; i++) {
+      if (sscanf(line + 1 + 2 * i, "%2x", &byte[i]) != 1) {
+	break;
+      }
+      sum += byte[i];
+    }
+    if (i < (int) count + 5 || sum != 0) {
+      break;
+    }
+    if (byte[3] == 0x01) {
+      // end of file
+      fclose(fp);
+      return bytes;
+    }
+    if (byte[3] == 0x00) {
+      for (i = 0; i < (int) count; i++) {
+	memory[(uint16_t) ((byte[1] << 8) + byte[2] + i)] = byte[4 + i];
+      }
+      bytes += count;
+    }
+  }
+  fprintf(stderr, "%s:%d: wrong record\n", fn, line_number);
+  fclose(fp);
+  return -1;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  load_bin
+ */
+/**
+ *  @brief
+ *      Loads a binary file
+ *  @param
+ *      fn          file name
+ *  @param
+ *      memory      memory of the Elf
+ *  @param
+ *      adr         load address
+ *  @return
+ *      int         number of bytes, -1 error (printed to stderr)
+ */
+/* ===================================================================*/
+int load_bin(const char *fn, uint8_t *memory, uint16_t adr) {
+  size_t n;
+  FILE *fp;
+
+  fp = fopen(fn, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot open file \"%s\"\n", fn);
+    return -1;
+  }
+  n = fread(memory + adr, 1, CDP1802_MEMORY_SIZE - adr, fp);
+  fclose(fp);
+  return n;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  out_port
+ */
+/**
+ *  @brief
+ *      OUT of the emulator, port 4 are the LEDs
+ *  @param
+ *      cpu         emulator state
+ *  @param
+ *      port        1 to 7
+ *  @param
+ *      data        output byte
+ */
+/* ===================================================================*/
+void out_port(cdp1802_t *cpu, int port, uint8_t data) {
+  if (port != LED_PORT || data == leds) {
+    return;
+  }
+  leds = data;
+  if (log_mode) {
+    printf("%12.6f ms LED:%02x Q:%1x\n",
+	   cpu->cycles * CDP1802_CLOCKS * 1e3 / clock_hz, leds, cpu->q);
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  in_port
+ */
+/**
+ *  @brief
+ *      INP of the emulator, port 4 are the data switches
+ *  @param
+ *      cpu         emulator state
+ *  @param
+ *      port        1 to 7
+ *  @return
+ *      uint8_t     input byte, 0xff for the other ports
+ */
+/* ===================================================================*/
+uint8_t in_port(cdp1802_t *cpu, int port) {
+  (void) cpu;
+  return port == LED_PORT ? switches : 0xFF;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  q_changed
+ */
+/**
+ *  @brief
+ *      Q of the emulator (Q LED)
+ *  @param
+ *      cpu         emulator state
+ *  @param
+ *      q           0 or 1
+ */
+/* ===================================================================*/
+void q_changed(cdp1802_t *cpu, int q) {
+  if (log_mode) {
+    printf("%12.6f ms LED:%02x Q:%1x\n",
+	   cpu->cycles * CDP1802_CLOCKS * 1e3 / clock_hz, leds, q);
+  }
+}
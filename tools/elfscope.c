@@ -0,0 +1,463 @@
+/**
+ *  @brief
+ *      Logic analyzer for the Elf (Membership Card). Captures the LED port
+ *      (INPUT_0..7), Q and EF3 as fast as the GPIO can be read.
+ *
+ *      A sampler thread reads the lines in a tight loop and passes only the
+ *      transitions to the main thread over a lock-free ring (one producer,
+ *      one consumer). A transition is the new line state and the time in
+ *      ns since the previous transition (run length). The main thread stores
+ *      them in a preallocated buffer, at the end the capture is written as
+ *      VCD (e.g. for GTKWave) and a summary is printed: sample rate, Q
+ *      frequency and duty cycle and the sequence of the LED patterns.
+ *
+ *      The Elf is not touched, the ports are only read (init_port_read).
+ *
+ *      synopsis
+ *       $ elfscope [-t <ms>] [-b <transitions>] [-p <patterns>] [-o <file.vcd>] [-v]
+ *
+ *     -t ms
+ *         capture time in ms (1000 is default), Ctrl-C stops earlier
+ *     -b transitions
+ *         size of the capture buffer (1048576 is default)
+ *     -p patterns
+ *         number of LED patterns in the summary (16 is default)
+ *     -o file.vcd
+ *         VCD file, without the capture is not saved
+ *     -v
+ *         verbose, the transitions are printed out
+ *  @file
+ *      elfscope.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <wiringPi.h>
+#include "raspi_gpio.h"
+
+// sample bits: LED port in bit 0 to 7
+#define SAMPLE_Q    (1 << 8)
+#define SAMPLE_EF3  (1 << 9)
+
+// ring between sampler and writer, power of 2
+#define RING_SIZE   65536
+
+// shorter LED patterns are glitches (the port is read bit by bit)
+#define GLITCH_NS   10000
+
+typedef struct {
+  uint32_t delta;	// ns since the previous transition
+  uint16_t sample;	// line state
+} transition_t;
+
+static transition_t ring[RING_SIZE];
+static unsigned int ring_head = 0;	// written by the sampler
+static unsigned int ring_tail = 0;	// written by the writer
+static volatile sig_atomic_t capturing = TRUE;
+
+// sampler statistics
+static unsigned long samples = 0;
+static unsigned long ring_overruns = 0;
+static uint64_t max_gap = 0;
+
+// local prototypes
+
+void usage_exit(int err_number, const char *str);
+void stop_capture(int sig);
+uint16_t sample_lines(void);
+uint64_t nanoseconds(void);
+void *sampler_thread(void *arg);
+int write_vcd(const char *name, const transition_t *buf, unsigned long n);
+void print_summary(const transition_t *buf, unsigned long n,
+		   uint64_t duration, int patterns);
+
+
+int main(int argc, char *argv[]) {
+  int opt;
+  long capture_ms = 1000;
+  unsigned long buffer_size = 1048576;
+  int patterns = 16;
+  const char *vcd_name = NULL;
+  uint8_t verbose_mode = FALSE;
+  transition_t *buf;
+  unsigned long n = 0;
+  unsigned long lost = 0;
+  unsigned long i;
+  uint64_t start, now, t;
+  pthread_t sampler;
+
+  // parse command line options
+  while ((opt = getopt(argc, argv, "t:b:p:o:v")) != -1) {
+    switch (opt) {
+    case 't':
+      capture_ms = strtol(optarg, NULL, 10);
+      break;
+    case 'b':
+      buffer_size = strtoul(optarg, NULL, 10);
+      break;
+    case 'p':
+      patterns = strtol(optarg, NULL, 10);
+      break;
+    case 'o':
+      vcd_name = optarg;
+      break;
+    case 'v':
+      verbose_mode = TRUE;
+      break;
+    default:
+      usage_exit(EXIT_FAILURE, argv[0]);
+      break;
+    }
+  }
+  if (optind < argc || capture_ms <= 0 || buffer_size < 2) {
+    usage_exit(EXIT_FAILURE, argv[0]);
+  }
+
+  // preallocated and locked, no page faults while capturing
+  buf = malloc(buffer_size * sizeof(transition_t));
+  if (buf == NULL) {
+    fprintf(stderr, "no memory for %lu transitions\n", buffer_size);
+    exit(EXIT_FAILURE);
+  }
+  for (i=0; i<buffer_size; i++) {
+    buf[i].delta = 0;
+    buf[i].sample = 0;
+  }
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    perror("mlockall");
+  }
+
+  if (init_port_read() != 0) {
+    // can't init ports
+    fprintf(stderr, "can't init ports\n");
+    exit(EXIT_FAILURE);
+  }
+  pinMode(RX_Q, INPUT);
+  pinMode(TX_EF3, INPUT);
+
+  signal(SIGINT, stop_capture);
+  start = nanoseconds();
+  if (pthread_create(&sampler, NULL, sampler_thread, NULL) != 0) {
+    perror("can not start the sampler");
+    exit(EXIT_FAILURE);
+  }
+
+  do {
+    usleep(1000);
+    now = nanoseconds();
+    if (now - start >= (uint64_t) capture_ms * 1000000) {
+      capturing = FALSE;
+    }
+    // drain the ring
+    while (ring_tail != __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE)) {
+      if (n < buffer_size) {
+	buf[n++] = ring[ring_tail % RING_SIZE];
+      } else {
+	lost++;
+      }
+      __atomic_store_n(&ring_tail, ring_tail + 1, __ATOMIC_RELEASE);
+    }
+    if (n == buffer_size) {
+      // buffer full
+      capturing = FALSE;
+    }
+  } while (capturing || ring_tail != __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE));
+  pthread_join(sampler, NULL);
+  now = nanoseconds();
+
+  if (verbose_mode) {
+    for (i=0, t=0; i<n; i++) {
+      t += buf[i].delta;
+      printf("%12.6f ms LED:%02x Q:%1x EF3:%1x\n", t / 1e6,
+	     buf[i].sample & 0xFF, !!(buf[i].sample & SAMPLE_Q),
+	     !!(buf[i].sample & SAMPLE_EF3));
+    }
+  }
+  if (lost || ring_overruns) {
+    fprintf(stderr, "%lu transitions lost (buffer full %lu, ring full %lu)\n",
+	    lost + ring_overruns, lost, ring_overruns);
+  }
+  print_summary(buf, n, now - start, patterns);
+  if (vcd_name != NULL) {
+    if (write_vcd(vcd_name, buf, n) != 0) {
+      perror(vcd_name);
+      exit(EXIT_FAILURE);
+    }
+  }
+  free(buf);
+  exit(0);
+}
+
+void usage_exit(int err_number, const char *str) {
+  fprintf(stderr, "\
+Usage: %s [-t <ms>] [-b <transitions>] [-p <patterns>] [-o <file.vcd>] [-v]\n\
+-t capture time in ms (1000)\n\
+-b capture buffer size in transitions (1048576)\n\
+-p number of LED patterns in the summary (16)\n\
+-o VCD file\n\
+-v verbose, print the transitions\n",
+	  str);
+  exit(err_number);
+}
+
+void stop_capture(int sig) {
+  capturing = FALSE;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  sample_lines
+ */
+/**
+ *  @brief
+ *      Reads the LED port, Q and EF3
+ *  @return
+ *      uint16_t    LED in bit 0 to 7, SAMPLE_Q and SAMPLE_EF3
+ */
+/* ===================================================================*/
+uint16_t sample_lines(void) {
+  return (read_byte() | (digitalRead(RX_Q) ? SAMPLE_Q : 0) |
+	  (digitalRead(TX_EF3) ? SAMPLE_EF3 : 0));
+}
+
+uint64_t nanoseconds(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  sampler_thread
+ */
+/**
+ *  @brief
+ *      Samples the lines until the capture stops and puts the
+ *      transitions into the ring. The first entry is the state at the
+ *      start. A run longer than 4.29 s is split into two entries with
+ *      the same state.
+ *  @param
+ *      arg     not used
+ *  @return
+ *      NULL
+ */
+/* ===================================================================*/
+void *sampler_thread(void *arg) {
+  uint16_t last;
+  uint16_t sample;
+  uint64_t last_time;
+  uint64_t now;
+  uint64_t previous;
+  uint64_t gap = 0;
+  unsigned int head = ring_head;
+  unsigned long count = 0;
+
+  // real-time priority if possible (root)
+  piHiPri(99);
+
+  last = sample_lines();
+  last_time = nanoseconds();
+  now = last_time;
+  ring[head % RING_SIZE].delta = 0;
+  ring[head % RING_SIZE].sample = last;
+  __atomic_store_n(&ring_head, ++head, __ATOMIC_RELEASE);
+
+  while (capturing) {
+    sample = sample_lines();
+    previous = now;
+    now = nanoseconds();
+    count++;
+    if (now - previous > gap) {
+      // the sampler was interrupted
+      gap = now - previous;
+    }
+    if (sample == last && now - last_time <= UINT32_MAX) {
+      continue;
+    }
+    if (head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+      // ring full, the writer is too slow
+      ring_overruns++;
+    } else {
+      ring[head % RING_SIZE].delta = now - last_time;
+      ring[head % RING_SIZE].sample = sample;
+      __atomic_store_n(&ring_head, ++head, __ATOMIC_RELEASE);
+    }
+    last = sample;
+    last_time = now;
+  }
+  samples = count;
+  max_gap = gap;
+  return (NULL);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  write_vcd
+ */
+/**
+ *  @brief
+ *      Writes the capture as value change dump, time scale 1 ns
+ *  @param
+ *      name    file name
+ *  @param
+ *      buf     transitions
+ *  @param
+ *      n       number of transitions
+ *  @return
+ *      int     0 ok, -1 error
+ */
+/* ===================================================================*/
+int write_vcd(const char *name, const transition_t *buf, unsigned long n) {
+  FILE *fp;
+  unsigned long i;
+  uint64_t t = 0;
+  uint16_t changed;
+  int bit;
+
+  fp = fopen(name, "w");
+  if (fp == NULL) {
+    return (-1);
+  }
+  fprintf(fp, "$date\n  elfscope\n$end\n");
+  fprintf(fp, "$timescale 1ns $end\n");
+  fprintf(fp, "$scope module elf $end\n");
+  fprintf(fp, "$var wire 8 L led [7:0] $end\n");
+  fprintf(fp, "$var wire 1 Q q $end\n");
+  fprintf(fp, "$var wire 1 E ef3 $end\n");
+  fprintf(fp, "$upscope $end\n$enddefinitions $end\n");
+
+  for (i=0; i<n; i++) {
+    t += buf[i].delta;
+    changed = (i == 0) ? 0xFFFF : buf[i].sample ^ buf[i-1].sample;
+    if (!changed) {
+      // split run
+      continue;
+    }
+    fprintf(fp, "#%llu\n", (unsigned long long) t);
+    if (changed & 0xFF) {
+      fputc('b', fp);
+      for (bit=7; bit>=0; bit--) {
+	fputc(buf[i].sample & (1 << bit) ? '1' : '0', fp);
+      }
+      fprintf(fp, " L\n");
+    }
+    if (changed & SAMPLE_Q) {
+      fprintf(fp, "%cQ\n", buf[i].sample & SAMPLE_Q ? '1' : '0');
+    }
+    if (changed & SAMPLE_EF3) {
+      fprintf(fp, "%cE\n", buf[i].sample & SAMPLE_EF3 ? '1' : '0');
+    }
+  }
+  fprintf(fp, "#%llu\n", (unsigned long long) t);
+  return (fclose(fp) == 0 ? 0 : -1);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  print_summary
+ */
+/**
+ *  @brief
+ *      Prints the sample rate, the Q frequency and duty cycle and the
+ *      LED patterns with their duration
+ *  @param
+ *      buf         transitions
+ *  @param
+ *      n           number of transitions
+ *  @param
+ *      duration    capture time in ns
+ *  @param
+ *      patterns    number of LED patterns to print
+ */
+/* ===================================================================*/
+void print_summary(const transition_t *buf, unsigned long n,
+		   uint64_t duration, int patterns) {
+  unsigned long i;
+  uint64_t t = 0;
+  uint64_t q_high = 0;
+  uint64_t q_high_periods = 0;
+  uint64_t first_rise = 0;
+  uint64_t last_rise = 0;
+  unsigned long rises = 0;
+  uint64_t led_start = 0;
+  int printed = 0;
+
+  printf("%lu samples in %.3f s (%.0f samples/s), %lu transitions\n",
+	 samples, duration / 1e9, samples / (duration / 1e9), n);
+  printf("longest gap between samples %.3f ms\n", max_gap / 1e6);
+  if (n == 0) {
+    return;
+  }
+
+  printf("LED patterns:\n");
+  for (i=0; i<n; i++) {
+    if (i > 0) {
+      if (rises > 0 && (buf[i-1].sample & SAMPLE_Q)) {
+	q_high += buf[i].delta;
+      }
+      t += buf[i].delta;
+      if ((buf[i].sample & SAMPLE_Q) && !(buf[i-1].sample & SAMPLE_Q)) {
+	// rising edge of Q, whole periods from the first to the last
+	if (rises++ == 0) {
+	  first_rise = t;
+	}
+	last_rise = t;
+	q_high_periods = q_high;
+      }
+      if (((buf[i].sample ^ buf[i-1].sample) & 0xFF) &&
+	  (t - led_start >= GLITCH_NS || i == 1)) {
+	if (printed++ < patterns) {
+	  printf("  %02x %10.3f ms\n", buf[i-1].sample & 0xFF,
+		 (t - led_start) / 1e6);
+	}
+	led_start = t;
+      }
+    }
+  }
+  if (printed++ < patterns) {
+    printf("  %02x %10.3f ms (end of capture)\n", buf[n-1].sample & 0xFF,
+	   (duration > led_start ? duration - led_start : 0) / 1e6);
+  }
+  if (printed > patterns) {
+    printf("  ... %d patterns\n", printed);
+  }
+
+  if (rises >= 2) {
+    printf("Q: %lu rising edges, %.3f Hz, duty cycle %.1f %%\n", rises,
+	   (rises - 1) / ((last_rise - first_rise) / 1e9),
+	   100.0 * q_high_periods / (last_rise - first_rise));
+  } else {
+    printf("Q: %s, %lu rising edge(s)\n",
+	   buf[n-1].sample & SAMPLE_Q ? "high" : "low", rises);
+  }
+}
@@ -0,0 +1,596 @@
+/**
+ *  @brief
+ *      Serial terminal for the Elf (Membership Card) with a software UART
+ *      on Q and EF3, the 1802 software serial convention: the Elf sends
+ *      with Q (read on RX_Q) and receives with EF3 (written on TX_EF3).
+ *
+ *      The UART runs on its own thread with real-time priority (root). It
+ *      polls the lines in a busy loop and times every bit against the
+ *      absolute time of the start bit, so the bit timing does not drift
+ *      within a frame. A received start bit is checked in its middle and
+ *      the data bits are sampled in the middle of the bit. The terminal
+ *      passes the bytes through two lock-free rings.
+ *
+ *      The ports are set read only (init_port_read) except TX_EF3, a
+ *      running program on the Elf is not disturbed.
+ *
+ *      synopsis
+ *       $ elfterm [-b <baud>] [-s <stop bits>] [-i] [-x <file>] [-v]
+ *
+ *     -b baud
+ *         baud rate (9600 is default)
+ *     -s stop bits
+ *         stop bits sent (1 is default), more gives the Elf time between
+ *         the bytes
+ *     -i
+ *         inverted lines, idle (mark) is low
+ *     -x file
+ *         sends the file with XMODEM (checksum or CRC, the receiver
+ *         decides) to a monitor on the Elf and exits
+ *     -v
+ *         verbose, prints the UART statistics at exit
+ *
+ *     Ctrl-] exits the terminal.
+ *  @file
+ *      elfterm.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <wiringPi.h>
+#include "raspi_gpio.h"
+
+// ring size, power of 2
+#define RING_SIZE   1024
+
+// Ctrl-] exits the terminal
+#define ESCAPE_CHAR 0x1D
+
+// XMODEM
+#define SOH         0x01
+#define EOT         0x04
+#define ACK         0x06
+#define NAK         0x15
+#define CAN         0x18
+#define CRC_START   'C'
+#define PAD         0x1A
+#define BLOCK_SIZE  128
+#define RETRIES     10
+// the line is quiet this long before the first block (ms)
+#define QUIET_MS    100
+
+typedef struct {
+  uint8_t data[RING_SIZE];
+  unsigned int head;	// written by the producer
+  unsigned int tail;	// written by the consumer
+} ring_t;
+
+static ring_t rx_ring;
+static ring_t tx_ring;
+static int uart_running = TRUE;
+
+// line configuration
+static long baud = 9600;
+static int stop_bits = 1;
+static int invert = 0;
+
+// UART statistics
+static unsigned long rx_bytes = 0;
+static unsigned long tx_bytes = 0;
+static unsigned long framing_errors = 0;
+static unsigned long rx_overruns = 0;
+static uint64_t max_late = 0;
+
+static struct termios orig_term_attr;
+
+// local prototypes
+
+void usage_exit(int err_number, const char *str);
+uint64_t nanoseconds(void);
+int ring_put(ring_t *ring, uint8_t c);
+int ring_get(ring_t *ring);
+void *uart_thread(void *arg);
+void uart_putc(uint8_t c);
+int uart_getc(int timeout_ms);
+void uart_flush(void);
+int terminal(void);
+void restore_terminal(void);
+uint16_t crc16(const uint8_t *data, int len);
+int xmodem_send(FILE *fp);
+
+
+int main(int argc, char *argv[]) {
+  int opt;
+  const char *xmodem_file = NULL;
+  uint8_t verbose_mode = FALSE;
+  FILE *fp = NULL;
+  pthread_t uart;
+  int err;
+
+  // parse command line options
+  while ((opt = getopt(argc, argv, "b:s:ix:v")) != -1) {
+    switch (opt) {
+    case 'b':
+      baud = strtol(optarg, NULL, 10);
+      break;
+    case 's':
+      stop_bits = strtol(optarg, NULL, 10);
+      break;
+    case 'i':
+      invert = 1;
+      break;
+    case 'x':
+      xmodem_file = optarg;
+      break;
+    case 'v':
+      verbose_mode = TRUE;
+      break;
+    default:
+      usage_exit(EXIT_FAILURE, argv[0]);
+      break;
+    }
+  }
+  if (optind < argc || baud < 50 || baud > 115200 ||
+      stop_bits < 1 || stop_bits > 4) {
+    usage_exit(EXIT_FAILURE, argv[0]);
+  }
+  if (xmodem_file != NULL) {
+    fp = fopen(xmodem_file, "rb");
+    if (fp == NULL) {
+      perror(xmodem_file);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (init_port_read() != 0) {
+    // can't init ports
+    fprintf(stderr, "can't init ports\n");
+    exit(EXIT_FAILURE);
+  }
+  pinMode(RX_Q, INPUT);
+  // idle (mark)
+  digitalWrite(TX_EF3, !invert);
+  pinMode(TX_EF3, OUTPUT);
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    perror("mlockall");
+  }
+  if (pthread_create(&uart, NULL, uart_thread, NULL) != 0) {
+    perror("can not start the UART");
+    exit(EXIT_FAILURE);
+  }
+
+  if (fp != NULL) {
+    err = xmodem_send(fp);
+    fclose(fp);
+  } else {
+    err = terminal();
+  }
+
+  uart_flush();
+  __atomic_store_n(&uart_running, FALSE, __ATOMIC_RELEASE);
+  pthread_join(uart, NULL);
+  if (verbose_mode) {
+    fprintf(stderr, "%ld baud: %lu bytes received, %lu bytes sent, "
+	    "%lu framing errors, %lu overruns, bit edge max %.1f us late\n",
+	    baud, rx_bytes, tx_bytes, framing_errors, rx_overruns,
+	    max_late / 1e3);
+  }
+  exit(err == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void usage_exit(int err_number, const char *str) {
+  fprintf(stderr, "\
+Usage: %s [-b <baud>] [-s <stop bits>] [-i] [-x <file>] [-v]\n\
+-b baud rate (9600)\n\
+-s stop bits (1)\n\
+-i inverted lines\n\
+-x send the file with XMODEM\n\
+-v verbose, UART statistics\n\
+Ctrl-] exits the terminal\n",
+	  str);
+  exit(err_number);
+}
+
+uint64_t nanoseconds(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  ring_put
+ */
+/**
+ *  @brief
+ *      Puts a byte into a ring (one producer)
+ *  @param
+ *      ring    ring
+ *  @param
+ *      c       byte
+ *  @return
+ *      int     0 ok, -1 full
+ */
+/* ===================================================================*/
+int ring_put(ring_t *ring, uint8_t c) {
+  unsigned int head = ring->head;
+
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+    return (-1);
+  }
+  ring->data[head % RING_SIZE] = c;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  return (0);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  ring_get
+ */
+/**
+ *  @brief
+ *      Gets a byte from a ring (one consumer)
+ *  @param
+ *      ring    ring
+ *  @return
+ *      int     byte, EOF empty
+ */
+/* ===================================================================*/
+int ring_get(ring_t *ring) {
+  unsigned int tail = ring->tail;
+  uint8_t c;
+
+  if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+    return (EOF);
+  }
+  c = ring->data[tail % RING_SIZE];
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return (c);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  uart_thread
+ */
+/**
+ *  @brief
+ *      Software UART, 8 data bits, no parity, LSB first. Receives on
+ *      RX_Q and sends on TX_EF3 until uart_running is cleared.
+ *  @param
+ *      arg     not used
+ *  @return
+ *      NULL
+ */
+/* ===================================================================*/
+void *uart_thread(void *arg) {
+  uint64_t bit_ns = (1000000000 + baud / 2) / baud;
+  uint64_t now;
+  uint64_t rx_next = 0;
+  uint64_t tx_next = 0;
+  int rx_bits = -1;	// -1 idle, 0 start bit, 1 to 8 data, 9 stop
+  uint8_t rx_shift = 0;
+  int tx_bits = 0;
+  uint16_t tx_shift = 0;
+  int level;
+  int c;
+
+  // real-time priority if possible (root)
+  piHiPri(99);
+
+  while (__atomic_load_n(&uart_running, __ATOMIC_ACQUIRE)) {
+    now = nanoseconds();
+
+    // receiver
+    level = digitalRead(RX_Q) ^ invert;
+    if (rx_bits < 0) {
+      if (!level) {
+	// falling edge, check the start bit in its middle
+	rx_bits = 0;
+	rx_next = now + bit_ns / 2;
+      }
+    } else if (now >= rx_next) {
+      if (rx_bits == 0) {
+	if (level) {
+	  // glitch, no start bit
+	  rx_bits = -1;
+	} else {
+	  rx_bits = 1;
+	  rx_shift = 0;
+	  rx_next += bit_ns;
+	}
+      } else if (rx_bits <= 8) {
+	// data bits, LSB first
+	rx_shift >>= 1;
+	if (level) {
+	  rx_shift |= 0x80;
+	}
+	rx_bits++;
+	rx_next += bit_ns;
+      } else {
+	// stop bit, wait for the next start bit in its second half
+	if (!level) {
+	  framing_errors++;
+	} else if (ring_put(&rx_ring, rx_shift) != 0) {
+	  rx_overruns++;
+	} else {
+	  rx_bytes++;
+	}
+	rx_bits = -1;
+      }
+    }
+
+    // transmitter
+    if (now >= tx_next) {
+      if (tx_bits == 0 && (c = ring_get(&tx_ring)) != EOF) {
+	// start bit, data bits and stop bits
+	tx_shift = (c << 1) | (0xFFFF << 9);
+	tx_bits = 1 + 8 + stop_bits;
+	tx_next = now;
+	tx_bytes++;
+      }
+      if (tx_bits > 0) {
+	digitalWrite(TX_EF3, (tx_shift & 1) ^ invert);
+	if (now - tx_next > max_late) {
+	  max_late = now - tx_next;
+	}
+	tx_shift >>= 1;
+	tx_bits--;
+	tx_next += bit_ns;
+      }
+    }
+  }
+  return (NULL);
+}
+
+void uart_putc(uint8_t c) {
+  while (ring_put(&tx_ring, c) != 0) {
+    usleep(1000);
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  uart_getc
+ */
+/**
+ *  @brief
+ *      Gets a received byte
+ *  @param
+ *      timeout_ms  maximal waiting time in ms
+ *  @return
+ *      int         byte, EOF timeout
+ */
+/* ===================================================================*/
+int uart_getc(int timeout_ms) {
+  int c;
+
+  while ((c = ring_get(&rx_ring)) == EOF && timeout_ms-- > 0) {
+    usleep(1000);
+  }
+  return (c);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  uart_flush
+ */
+/**
+ *  @brief
+ *      Waits until all bytes are sent (stop bits included)
+ */
+/* ===================================================================*/
+void uart_flush(void) {
+  while (__atomic_load_n(&tx_ring.tail, __ATOMIC_ACQUIRE) != tx_ring.head) {
+    usleep(1000);
+  }
+  // the last frame
+  usleep((11 + stop_bits) * 1000000L / baud + 1000);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  terminal
+ */
+/**
+ *  @brief
+ *      Passes the keys to the Elf and the received bytes to stdout
+ *      until Ctrl-] or the end of stdin
+ *  @return
+ *      int     0
+ */
+/* ===================================================================*/
+int terminal(void) {
+  struct termios new_term_attr;
+  uint8_t buf[RING_SIZE];
+  ssize_t rb;
+  ssize_t i;
+  int c;
+  int received;
+
+  if (isatty(fileno(stdin)) && tcgetattr(fileno(stdin), &orig_term_attr) == 0) {
+    // raw terminal, restored at exit
+    memcpy(&new_term_attr, &orig_term_attr, sizeof(struct termios));
+    new_term_attr.c_lflag &= ~(ECHO|ICANON|ISIG);
+    new_term_attr.c_iflag &= ~(ICRNL|IXON);
+    new_term_attr.c_cc[VTIME] = 0;
+    new_term_attr.c_cc[VMIN] = 0;
+    tcsetattr(fileno(stdin), TCSANOW, &new_term_attr);
+    atexit(restore_terminal);
+    fprintf(stderr, "elfterm %ld baud, Ctrl-] exits\r\n", baud);
+  }
+  fcntl(fileno(stdin), F_SETFL, fcntl(fileno(stdin), F_GETFL) | O_NONBLOCK);
+
+  for (;;) {
+    rb = read(fileno(stdin), buf, sizeof(buf));
+    if (rb == 0) {
+      // end of stdin, show the answer to the last bytes
+      uart_flush();
+      while ((c = uart_getc(100)) != EOF) {
+	putchar(c);
+      }
+      fflush(stdout);
+      return (0);
+    }
+    for (i=0; i<rb; i++) {
+      if (buf[i] == ESCAPE_CHAR) {
+	return (0);
+      }
+      uart_putc(buf[i]);
+    }
+    received = FALSE;
+    while ((c = ring_get(&rx_ring)) != EOF) {
+      putchar(c);
+      received = TRUE;
+    }
+    if (received) {
+      fflush(stdout);
+    } else {
+      usleep(1000);
+    }
+  }
+}
+
+void restore_terminal(void) {
+  tcsetattr(fileno(stdin), TCSANOW, &orig_term_attr);
+}
+
+uint16_t crc16(const uint8_t *data, int len) {
+  uint16_t crc = 0;
+  int i;
+
+  while (len--) {
+    crc ^= *data++ << 8;
+    for (i=0; i<8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return (crc);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  xmodem_send
+ */
+/**
+ *  @brief
+ *      Sends a file with XMODEM, 128 byte blocks. The receiver starts
+ *      with NAK (checksum) or 'C' (CRC-16).
+ *  @param
+ *      fp      file
+ *  @return
+ *      int     0 ok, -1 error
+ */
+/* ===================================================================*/
+int xmodem_send(FILE *fp) {
+  uint8_t block[BLOCK_SIZE];
+  uint8_t block_number = 1;
+  uint8_t checksum;
+  uint16_t crc;
+  int crc_mode;
+  unsigned long blocks = 0;
+  size_t len;
+  int retries;
+  int c;
+  int i;
+
+  fprintf(stderr, "waiting for the receiver\n");
+  // the receiver asks every few seconds, wait a minute
+  do {
+    c = uart_getc(60000);
+  } while (c != EOF && c != NAK && c != CRC_START && c != CAN);
+  if (c != NAK && c != CRC_START) {
+    fprintf(stderr, "no receiver\n");
+    return (-1);
+  }
+  crc_mode = (c == CRC_START);
+  // the receiver repeats the request until the first block arrives, the
+  // requests in flight are stale
+  while (uart_getc(QUIET_MS) != EOF) {
+  }
+
+  while ((len = fread(block, 1, BLOCK_SIZE, fp)) > 0) {
+    memset(block + len, PAD, BLOCK_SIZE - len);
+    for (retries=0; retries<RETRIES; retries++) {
+      // the requests repeated while waiting are stale
+      while (ring_get(&rx_ring) != EOF) {
+      }
+      uart_putc(SOH);
+      uart_putc(block_number);
+      uart_putc(~block_number);
+      for (i=0; i<BLOCK_SIZE; i++) {
+	uart_putc(block[i]);
+      }
+      if (crc_mode) {
+	crc = crc16(block, BLOCK_SIZE);
+	uart_putc(crc >> 8);
+	uart_putc(crc & 0xFF);
+      } else {
+	for (i=0, checksum=0; i<BLOCK_SIZE; i++) {
+	  checksum += block[i];
+	}
+	uart_putc(checksum);
+      }
+      // a late 'C' is a stale request, a NAK asks for the block again
+      do {
+	c = uart_getc(10000);
+      } while (c == CRC_START);
+      if (c == ACK) {
+	break;
+      }
+      if (c == CAN) {
+	fprintf(stderr, "cancelled by the receiver\n");
+	return (-1);
+      }
+    }
+    if (retries == RETRIES) {
+      fprintf(stderr, "block %lu not acknowledged\n", blocks + 1);
+      return (-1);
+    }
+    block_number++;
+    blocks++;
+    fprintf(stderr, "\r%lu blocks", blocks);
+  }
+
+  for (retries=0; retries<RETRIES; retries++) {
+    uart_putc(EOT);
+    if (uart_getc(10000) == ACK) {
+      fprintf(stderr, "\r%lu blocks sent\n", blocks);
+      return (0);
+    }
+  }
+  fprintf(stderr, "\nEOT not acknowledged\n");
+  return (-1);
+}
@@ -0,0 +1,544 @@
+/**
+ *  @brief
+ *      Several Elfs (Membership Cards) on one Raspberry Pi, driven in
+ *      lockstep (farm mode of bin2elf and elf2bin).
+ *
+ *      The pins of all boards are collected into masks of the GPIO bank 0
+ *      (BCM 0 to 27): a mask per control line and the data and LED pins
+ *      of each board. A step is one write of GPSET0 and one of GPCLR0.
+ *
+ *  @file
+ *      farm_gpio.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#ifdef GPIO_SIM
+#include "gpio_sim.h"
+#else
+#include <wiringPi.h>
+#endif
+#include "raspi_gpio.h"
+#include "farm_gpio.h"
+
+#define PINS            28
+#define MAX_LINE_LENGTH 256
+#define GPIO_BLOCK_SIZE 4096
+
+// register offsets (32 bit words) of the GPIO block
+#define GPSET0          7
+#define GPCLR0          10
+#define GPLEV0          13
+
+// role of a pin, a pin can be shared by boards only in the same role
+#define ROLE_LINE       1
+#define ROLE_SWITCH     10
+#define ROLE_LED        20
+
+static const char *line_name[FARM_LINES] = {"in", "wait", "clear", "write"};
+
+static pin_map_t board[MAX_BOARDS];
+static int boards = 0;
+static uint32_t line_mask[FARM_LINES];
+static uint32_t switch_mask[MAX_BOARDS];
+static uint32_t led_mask;
+static volatile uint32_t *gpio = NULL;
+
+
+static const pin_map_t default_map = {
+  {IN_N, WAIT_N, CLEAR_N, WRITE_N},
+  {OUTPUT_0, OUTPUT_1, OUTPUT_2, OUTPUT_3,
+   OUTPUT_4, OUTPUT_5, OUTPUT_6, OUTPUT_7},
+  {INPUT_0, INPUT_1, INPUT_2, INPUT_3, INPUT_4, INPUT_5, INPUT_6, INPUT_7}
+};
+
+static int parse_pins(char *value, int *pins, int n) {
+  char *token;
+  char *end;
+  int i = 0;
+
+  if (strcmp(value, "none") == 0) {
+    for (i = 0; i < n; i++) {
+      pins[i] = NO_PIN;
+    }
+    return 0;
+  }
+  for (token = strtok(value, ","); token != NULL; token = strtok(NULL, ",")) {
+    if (i == n) {
+      return -1;
+    }
+    pins[i] = strtol(token, &end, 10);
+    if (*end != '\0' || pins[i] < 0 || pins[i] >= PINS) {
+      return -1;
+    }
+    i++;
+  }
+  return i == n ? 0 : -1;
+}
+
+static int set_role(int *role, int pin, int r) {
+  if (pin == NO_PIN) {
+    return 0;
+  }
+  if (role[pin] != 0 && role[pin] != r) {
+    return -1;
+  }
+  role[pin] = r;
+  return 0;
+}
+
+static int board_masks(int *role, int b) {
+  int pin;
+  int i;
+
+  switch_mask[b] = 0;
+  for (i = 0; i < FARM_LINES; i++) {
+    pin = board[b].line[i];
+    if (set_role(role, pin, ROLE_LINE + i) != 0) {
+      return pin;
+    }
+    line_mask[i] |= 1UL << pin;
+  }
+  for (i = 0; i < 8; i++) {
+    pin = board[b].switches[i];
+    if (set_role(role, pin, ROLE_SWITCH + i) != 0) {
+      return pin;
+    }
+    if (pin != NO_PIN) {
+      switch_mask[b] |= 1UL << pin;
+    }
+    pin = board[b].leds[i];
+    if (set_role(role, pin, ROLE_LED + i) != 0) {
+      return pin;
+    }
+    if (pin != NO_PIN) {
+      led_mask |= 1UL << pin;
+    }
+  }
+  return NO_PIN;
+}
+
+static void gpio_write(uint32_t set, uint32_t clear) {
+  int pin;
+
+  if (gpio != NULL) {
+    if (set) {
+      gpio[GPSET0] = set;
+    }
+    if (clear) {
+      gpio[GPCLR0] = clear;
+    }
+    return;
+  }
+  for (pin = 0; pin < PINS; pin++) {
+    if (set & (1UL << pin)) {
+      digitalWrite(pin, 1);
+    } else if (clear & (1UL << pin)) {
+      digitalWrite(pin, 0);
+    }
+  }
+}
+
+static uint32_t gpio_read(uint32_t mask) {
+  uint32_t levels = 0;
+  int pin;
+
+  if (gpio != NULL) {
+    return gpio[GPLEV0] & mask;
+  }
+  for (pin = 0; pin < PINS; pin++) {
+    if ((mask & (1UL << pin)) && digitalRead(pin)) {
+      levels |= 1UL << pin;
+    }
+  }
+  return levels;
+}
+
+static void gpio_map(void) {
+#ifndef GPIO_SIM
+  void *map;
+  int fd;
+
+  fd = open("/dev/gpiomem", O_RDWR | O_SYNC);
+  if (fd < 0) {
+    // the pins are written one by one
+    return;
+  }
+  map = mmap(NULL, GPIO_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map != MAP_FAILED) {
+    gpio = map;
+  }
+#endif
+}
+
+static void release_pins(void) {
+  int b;
+  int i;
+
+  for (b = 0; b < boards; b++) {
+    for (i = 0; i < FARM_LINES; i++) {
+      pinMode(board[b].line[i], INPUT);
+    }
+    for (i = 0; i < 8; i++) {
+      if (board[b].switches[i] != NO_PIN) {
+	pinMode(board[b].switches[i], INPUT);
+      }
+    }
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_load_map
+ */
+/**
+ *  @brief
+ *      Reads the pin map file and checks the pins
+ *  @param
+ *      fn          file name of the pin map
+ *  @return
+ *      int         number of boards, -1 error (printed to stderr)
+ */
+/* ===================================================================*/
+int farm_load_map(const char *fn) {
+  char line[MAX_LINE_LENGTH];
+  char *token;
+  char *value;
+  char *save;
+  int role[PINS];
+  int line_number = 0;
+  int pin;
+  int b;
+  int i;
+  FILE *fp;
+
+  fp = fopen(fn, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot open pin map \"%s\"\n", fn);
+    return -1;
+  }
+  boards = 0;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    line_number++;
+    if ((token = strchr(line, '#')) != NULL) {
+      *token = '\0';
+    }
+    token = strtok_r(line, " \t\r\n", &save);
+    if (token == NULL) {
+      // empty line or comment
+      continue;
+    }
+    if (strcmp(token, "board") != 0 || boards == MAX_BOARDS) {
+      fprintf(stderr, "%s:%d: board expected (max %d)\n", fn, line_number,
+	      MAX_BOARDS);
+      fclose(fp);
+      return -1;
+    }
+    board[boards] = default_map;
+    while ((token = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+      value = strchr(token, '=');
+      if (value == NULL) {
+	break;
+      }
+      *value++ = '\0';
+      for (i = 0; i < FARM_LINES; i++) {
+	if (strcmp(token, line_name[i]) == 0) {
+	  break;
+	}
+      }
+      if (i < FARM_LINES) {
+	if (parse_pins(value, &board[boards].line[i], 1) != 0 ||
+	    board[boards].line[i] == NO_PIN) {
+	  break;
+	}
+      } else if (strcmp(token, "switches") == 0) {
+	if (parse_pins(value, board[boards].switches, 8) != 0) {
+	  break;
+	}
+      } else if (strcmp(token, "leds") == 0) {
+	if (parse_pins(value, board[boards].leds, 8) != 0) {
+	  break;
+	}
+      } else {
+	break;
+      }
+    }
+    if (token != NULL) {
+      fprintf(stderr, "%s:%d: wrong pins \"%s\"\n", fn, line_number, token);
+      fclose(fp);
+      return -1;
+    }
+    boards++;
+  }
+  fclose(fp);
+  if (boards == 0) {
+    fprintf(stderr, "%s: no board\n", fn);
+    return -1;
+  }
+
+  // a pin has one role, the masks of the steps
+  memset(role, 0, sizeof(role));
+  memset(line_mask, 0, sizeof(line_mask));
+  led_mask = 0;
+  for (b = 0; b < boards; b++) {
+    pin = board_masks(role, b);
+    if (pin != NO_PIN) {
+      fprintf(stderr, "%s: board %d, pin %d has two functions\n", fn, b, pin);
+      return -1;
+    }
+  }
+  return boards;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_board
+ */
+/**
+ *  @brief
+ *      Pins of a board
+ *  @param
+ *      board       board number
+ *  @return
+ *      pin_map_t   pins of the board
+ */
+/* ===================================================================*/
+const pin_map_t *farm_board(int b) {
+  return &board[b];
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_init
+ */
+/**
+ *  @brief
+ *      Initialises the pins of all boards (direction, pullups) and sets
+ *      the boards to LOAD mode, like init_port_mode and init_port_level
+ *  @return
+ *      int         error number -1 wiringPi, -2 any switch to ground
+ *                  (board number on stderr)
+ */
+/* ===================================================================*/
+int farm_init(void) {
+  uint32_t all_switches = 0;
+  uint32_t levels;
+  int b;
+  int i;
+
+  if (wiringPiSetupGpio() == -1) {
+    return -1;
+  }
+  gpio_map();
+
+  for (b = 0; b < boards; b++) {
+    for (i = 0; i < FARM_LINES; i++) {
+      pinMode(board[b].line[i], OUTPUT);
+    }
+    for (i = 0; i < 8; i++) {
+      if (board[b].switches[i] != NO_PIN) {
+	pinMode(board[b].switches[i], OUTPUT);
+      }
+      if (board[b].leds[i] != NO_PIN) {
+	pinMode(board[b].leds[i], INPUT);
+	pullUpDnControl(board[b].leds[i], PUD_UP);
+      }
+    }
+    all_switches |= switch_mask[b];
+  }
+
+  // write mode, run, in disable
+  gpio_write(line_mask[FARM_WAIT] | line_mask[FARM_CLEAR] |
+	     line_mask[FARM_IN], line_mask[FARM_WRITE]);
+  levels = gpio_read(line_mask[FARM_WAIT] | line_mask[FARM_CLEAR] |
+		     line_mask[FARM_IN]);
+  for (b = 0; b < boards; b++) {
+    if (!(levels & (1UL << board[b].line[FARM_WAIT])) ||
+	!(levels & (1UL << board[b].line[FARM_CLEAR])) ||
+	!(levels & (1UL << board[b].line[FARM_IN]))) {
+      // any of the mode pins is low -> switch in wrong position
+      fprintf(stderr, "board %d: mode switch in wrong position\n", b);
+      release_pins();
+      return -2;
+    }
+  }
+
+  // reset, load
+  gpio_write(0, line_mask[FARM_CLEAR]);
+  gpio_write(0, line_mask[FARM_WAIT]);
+
+  // all outputs are high
+  gpio_write(all_switches, 0);
+  levels = gpio_read(all_switches);
+  for (b = 0; b < boards; b++) {
+    if ((levels & switch_mask[b]) != switch_mask[b]) {
+      // any of the data out pins is low -> switch in wrong position
+      fprintf(stderr, "board %d: data switch in wrong position\n", b);
+      release_pins();
+      return -2;
+    }
+  }
+  return 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_line
+ */
+/**
+ *  @brief
+ *      Sets a control line of all boards (one write)
+ *  @param
+ *      line        FARM_IN, FARM_WAIT, FARM_CLEAR or FARM_WRITE
+ *  @param
+ *      level       0 or 1
+ */
+/* ===================================================================*/
+void farm_line(farm_line_t line, int level) {
+  if (level) {
+    gpio_write(line_mask[line], 0);
+  } else {
+    gpio_write(0, line_mask[line]);
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_board_line
+ */
+/**
+ *  @brief
+ *      Sets a control line of one board, shared lines change for the
+ *      other boards too
+ *  @param
+ *      board       board number
+ *  @param
+ *      line        FARM_IN, FARM_WAIT, FARM_CLEAR or FARM_WRITE
+ *  @param
+ *      level       0 or 1
+ */
+/* ===================================================================*/
+void farm_board_line(int b, farm_line_t line, int level) {
+  uint32_t mask = 1UL << board[b].line[line];
+
+  if (level) {
+    gpio_write(mask, 0);
+  } else {
+    gpio_write(0, mask);
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_in
+ */
+/**
+ *  @brief
+ *      Sets the IN line of all boards, for in_clock (stats_in_line)
+ *  @param
+ *      level       0 or 1
+ */
+/* ===================================================================*/
+void farm_in(int level) {
+  farm_line(FARM_IN, level);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_write_bytes
+ */
+/**
+ *  @brief
+ *      Writes the data switches of the boards (one write)
+ *  @param
+ *      data        a byte per board
+ *  @param
+ *      mask        boards to write (bit 0 board 0), the others keep
+ *                  their data switches (e.g. at the end of their file)
+ *  @return
+ *      int         0, -1 boards which share data lines get different data
+ */
+/* ===================================================================*/
+int farm_write_bytes(const uint8_t *data, uint32_t mask) {
+  uint32_t set = 0;
+  uint32_t clear = 0;
+  int b;
+  int i;
+
+  for (b = 0; b < boards; b++) {
+    if (!(mask & (1UL << b))) {
+      continue;
+    }
+    for (i = 0; i < 8; i++) {
+      if (board[b].switches[i] == NO_PIN) {
+	continue;
+      }
+      if (data[b] & (1 << i)) {
+	set |= 1UL << board[b].switches[i];
+      } else {
+	clear |= 1UL << board[b].switches[i];
+      }
+    }
+  }
+  if (set & clear) {
+    return -1;
+  }
+  gpio_write(set, clear);
+  return 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_read_bytes
+ */
+/**
+ *  @brief
+ *      Reads the LED ports of all boards (one read)
+ *  @param
+ *      data        a byte per board, 0xFF for a board without leds
+ */
+/* ===================================================================*/
+void farm_read_bytes(uint8_t *data) {
+  uint32_t levels = gpio_read(led_mask);
+  int b;
+  int i;
+
+  for (b = 0; b < boards; b++) {
+    data[b] = 0;
+    for (i = 0; i < 8; i++) {
+      if (board[b].leds[i] == NO_PIN ||
+	  (levels & (1UL << board[b].leds[i]))) {
+	data[b] |= 1 << i;
+      }
+    }
+  }
+}
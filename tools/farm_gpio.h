@@ -0,0 +1,197 @@
+/**
+ *  @brief
+ *      Several Elfs (Membership Cards) on one Raspberry Pi, driven in
+ *      lockstep (farm mode of bin2elf and elf2bin).
+ *
+ *      The pins of the boards are read from a pin map file at runtime,
+ *      one line per board. Keys which are missing take the pins of
+ *      raspi_gpio.h, so an empty "board" line is the standard wiring:
+ *
+ *      # shared IN, WAIT, CLEAR and WRITE, separate data lines
+ *      board
+ *      board switches=0,1,2,3,20,21,14,15 leds=none
+ *
+ *      in=, wait=, clear=, write= are the control lines, switches= the
+ *      8 data outputs (bit 0 first) and leds= the 8 LED port inputs, none
+ *      if the board is not connected (e.g. bin2elf only). Boards may
+ *      share the control lines or have their own, a pin has one role.
+ *
+ *      All pins of a step (e.g. the data of all boards, the IN strobe of
+ *      all boards) are written at once with a GPSET0 and a GPCLR0 write
+ *      (/dev/gpiomem), the LED ports are read with one GPLEV0 read. N
+ *      boards take the same time as one. Without /dev/gpiomem (or with
+ *      GPIO_SIM) the pins are written one by one with wiringPi.
+ *
+ *  @file
+ *      farm_gpio.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FARM_GPIO_H_
+#define FARM_GPIO_H_
+
+#include <stdint.h>
+
+#define MAX_BOARDS  8
+#define NO_PIN      (-1)
+
+// control lines of a board
+typedef enum {
+  FARM_IN,
+  FARM_WAIT,
+  FARM_CLEAR,
+  FARM_WRITE,
+  FARM_LINES
+} farm_line_t;
+
+typedef struct {
+  int line[FARM_LINES];
+  int switches[8];
+  int leds[8];
+} pin_map_t;
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_load_map
+ */
+/**
+ *  @brief
+ *      Reads the pin map file and checks the pins
+ *  @param
+ *      fn          file name of the pin map
+ *  @return
+ *      int         number of boards, -1 error (printed to stderr)
+ */
+/* ===================================================================*/
+int farm_load_map(const char *fn);
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_board
+ */
+/**
+ *  @brief
+ *      Pins of a board
+ *  @param
+ *      board       board number
+ *  @return
+ *      pin_map_t   pins of the board
+ */
+/* ===================================================================*/
+const pin_map_t *farm_board(int board);
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_init
+ */
+/**
+ *  @brief
+ *      Initialises the pins of all boards (direction, pullups) and sets
+ *      the boards to LOAD mode, like init_port_mode and init_port_level
+ *  @return
+ *      int         error number -1 wiringPi, -2 any switch to ground
+ *                  (board number on stderr)
+ */
+/* ===================================================================*/
+int farm_init(void);
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_line
+ */
+/**
+ *  @brief
+ *      Sets a control line of all boards (one write)
+ *  @param
+ *      line        FARM_IN, FARM_WAIT, FARM_CLEAR or FARM_WRITE
+ *  @param
+ *      level       0 or 1
+ */
+/* ===================================================================*/
+void farm_line(farm_line_t line, int level);
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_board_line
+ */
+/**
+ *  @brief
+ *      Sets a control line of one board, shared lines change for the
+ *      other boards too
+ *  @param
+ *      board       board number
+ *  @param
+ *      line        FARM_IN, FARM_WAIT, FARM_CLEAR or FARM_WRITE
+ *  @param
+ *      level       0 or 1
+ */
+/* ===================================================================*/
+void farm_board_line(int board, farm_line_t line, int level);
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_in
+ */
+/**
+ *  @brief
+ *      Sets the IN line of all boards, for in_clock (stats_in_line)
+ *  @param
+ *      level       0 or 1
+ */
+/* ===================================================================*/
+void farm_in(int level);
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_write_bytes
+ */
+/**
+ *  @brief
+ *      Writes the data switches of the boards (one write)
+ *  @param
+ *      data        a byte per board
+ *  @param
+ *      mask        boards to write (bit 0 board 0), the others keep
+ *                  their data switches (e.g. at the end of their file)
+ *  @return
+ *      int         0, -1 boards which share data lines get different data
+ */
+/* ===================================================================*/
+int farm_write_bytes(const uint8_t *data, uint32_t mask);
+
+/*
+ ** ===================================================================
+ **  Method      :  farm_read_bytes
+ */
+/**
+ *  @brief
+ *      Reads the LED ports of all boards (one read)
+ *  @param
+ *      data        a byte per board, 0xFF for a board without leds
+ */
+/* ===================================================================*/
+void farm_read_bytes(uint8_t *data);
+
+#endif /* FARM_GPIO_H_ */
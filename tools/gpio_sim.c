@@ -0,0 +1,287 @@
+/**
+ *  @brief
+ *      Software stand-in for the wiringPi GPIO layer with an Elf
+ *      (Membership Card) behind the parallel port.
+ *
+ *      The Elf acts on the writes of the control lines: the rising edge
+ *      of IN is the DMA cycle in LOAD mode, a reset clears R0. The LED
+ *      port shows the last byte of the DMA cycle.
+ *
+ *  @file
+ *      gpio_sim.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gpio_sim.h"
+#include "raspi_gpio.h"
+#include "sim_bench.h"
+
+#define PINS            28
+#define MEMORY_SIZE     0x10000
+
+static const int led_pin[8] = {
+  INPUT_0, INPUT_1, INPUT_2, INPUT_3, INPUT_4, INPUT_5, INPUT_6, INPUT_7
+};
+static const int switch_pin[8] = {
+  OUTPUT_0, OUTPUT_1, OUTPUT_2, OUTPUT_3,
+  OUTPUT_4, OUTPUT_5, OUTPUT_6, OUTPUT_7
+};
+
+static uint8_t level[PINS];
+static uint8_t *memory = NULL;
+static uint16_t r0 = 0;
+static uint8_t led = 0;
+static int print_stats = FALSE;
+static long expected_r0 = -1;
+static sim_bench_t *bench = NULL;
+static uint64_t strobe_time = 0;
+// statistics
+static unsigned long strobes = 0;
+static unsigned long reads = 0;
+static unsigned long writes = 0;
+static unsigned long resets = 0;
+
+
+static void exit_stats(void) {
+  if (print_stats) {
+    fprintf(stderr,
+	    "gpio_sim: %lu strobes, %lu reads, %lu writes, %lu resets, "
+	    "R0 0x%04x\n", strobes, reads, writes, resets, r0);
+  }
+  if (expected_r0 >= 0 && r0 != expected_r0) {
+    fprintf(stderr, "gpio_sim: R0 0x%04x, expected 0x%04lx\n",
+	    r0, expected_r0);
+    fflush(NULL);
+    _exit(EXIT_FAILURE);
+  }
+}
+
+static int load_mode(void) {
+  return !level[WAIT_N] && !level[CLEAR_N];
+}
+
+static int reset_mode(void) {
+  return level[WAIT_N] && !level[CLEAR_N];
+}
+
+static uint8_t switches(void) {
+  uint8_t data = 0;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    data |= level[switch_pin[i]] << i;
+  }
+  return data;
+}
+
+static void in_strobe(void) {
+  uint64_t now;
+  int dma = load_mode();
+
+  strobes++;
+  if (dma) {
+    if (!level[WRITE_N]) {
+      memory[r0] = switches();
+      writes++;
+    } else {
+      reads++;
+    }
+    led = memory[r0];
+    r0++;
+  }
+  if (bench != NULL) {
+    now = sim_bench_now();
+    sim_bench_op(bench, now - strobe_time, dma ? 1 : 0);
+    strobe_time = now;
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiSetupGpio
+ */
+/**
+ *  @brief
+ *      Initialises the simulated Elf (memory, pins)
+ *  @return
+ *      int         0, -1 on error (image file)
+ */
+/* ===================================================================*/
+int wiringPiSetupGpio(void) {
+  const char *env;
+  struct stat st;
+  int fd;
+
+  if (memory != NULL) {
+    return 0;
+  }
+  memset(level, 1, sizeof(level));
+
+  env = getenv("GPIO_SIM_IMAGE");
+  if (env != NULL) {
+    fd = open(env, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+      perror(env);
+      return -1;
+    }
+    if (st.st_size < MEMORY_SIZE && ftruncate(fd, MEMORY_SIZE) < 0) {
+      perror(env);
+      close(fd);
+      return -1;
+    }
+    memory = mmap(NULL, MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+		  fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+      memory = NULL;
+      perror(env);
+      return -1;
+    }
+  } else {
+    memory = calloc(MEMORY_SIZE, 1);
+    if (memory == NULL) {
+      return -1;
+    }
+  }
+
+  print_stats = getenv("GPIO_SIM_STATS") != NULL;
+  env = getenv("GPIO_SIM_R0");
+  if (env != NULL) {
+    expected_r0 = strtol(env, NULL, 16);
+  }
+  bench = sim_bench_open("gpio");
+  atexit(exit_stats);
+  return 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  pinMode
+ */
+/**
+ *  @brief
+ *      Sets the direction of a pin, ignored (the level is kept)
+ *  @param
+ *      pin         BCM number
+ *  @param
+ *      mode        INPUT or OUTPUT
+ */
+/* ===================================================================*/
+void pinMode(int pin, int mode) {
+  (void) pin;
+  (void) mode;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  pullUpDnControl
+ */
+/**
+ *  @brief
+ *      Pull up or down, ignored (the Elf lines are pulled up)
+ *  @param
+ *      pin         BCM number
+ *  @param
+ *      pud         PUD_OFF, PUD_DOWN or PUD_UP
+ */
+/* ===================================================================*/
+void pullUpDnControl(int pin, int pud) {
+  (void) pin;
+  (void) pud;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  digitalWrite
+ */
+/**
+ *  @brief
+ *      Sets a pin, the Elf reacts on IN, WAIT and CLEAR
+ *  @param
+ *      pin         BCM number
+ *  @param
+ *      value       0 or 1
+ */
+/* ===================================================================*/
+void digitalWrite(int pin, int value) {
+  uint8_t old;
+  int was_reset;
+
+  if (pin < 0 || pin >= PINS) {
+    return;
+  }
+  old = level[pin];
+  was_reset = reset_mode();
+  level[pin] = value != 0;
+
+  if (pin == IN_N) {
+    if (!old && level[pin]) {
+      in_strobe();
+    } else if (old && !level[pin] && bench != NULL && strobe_time == 0) {
+      // the first strobe is measured from its falling edge
+      strobe_time = sim_bench_now();
+    }
+  } else if ((pin == WAIT_N || pin == CLEAR_N) && reset_mode()) {
+    if (!was_reset) {
+      resets++;
+    }
+    r0 = 0;
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  digitalRead
+ */
+/**
+ *  @brief
+ *      Gets a pin, the LED port pins are driven by the Elf
+ *  @param
+ *      pin         BCM number
+ *  @return
+ *      int         0 or 1
+ */
+/* ===================================================================*/
+int digitalRead(int pin) {
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    if (pin == led_pin[i]) {
+      return (led >> i) & 1;
+    }
+  }
+  if (pin < 0 || pin >= PINS) {
+    return 0;
+  }
+  return level[pin];
+}
@@ -0,0 +1,139 @@
+/**
+ *  @brief
+ *      Software stand-in for the wiringPi GPIO layer with an Elf
+ *      (Membership Card) behind the parallel port.
+ *
+ *      Compile raspi_gpio.c and the tools with -DGPIO_SIM and link
+ *      gpio_sim.o instead of -lwiringPi to run elf, elf2bin, bin2elf and
+ *      elfdisplay on any Linux machine. The Elf is emulated in LOAD mode:
+ *      WAIT and CLEAR low, each IN strobe (rising edge) stores the data
+ *      switches (WRITE low) or reads the memory at R0 to the LED port and
+ *      increments R0. CLEAR low with WAIT high resets R0. The pins start
+ *      high (pull ups). The simulator is configured with environment
+ *      variables:
+ *
+ *      GPIO_SIM_IMAGE      memory image file (64 KiB, created if missing),
+ *                          without the memory is empty at each start
+ *      GPIO_SIM_STATS      print the statistics to stderr at exit: IN
+ *                          strobes, memory reads and writes, resets
+ *      GPIO_SIM_R0         expected R0 at exit in hex, the exit status is
+ *                          1 if R0 differs (e.g. a seek benchmark)
+ *
+ *      With SIM_BENCH set (see sim_bench.h) each IN strobe is recorded
+ *      as operation "gpio", the latency is the time since the last strobe.
+ *
+ *  @file
+ *      gpio_sim.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GPIO_SIM_H_
+#define GPIO_SIM_H_
+
+#ifndef TRUE
+#define TRUE    (1==1)
+#define FALSE   (!TRUE)
+#endif
+
+#define INPUT       0
+#define OUTPUT      1
+#define PUD_OFF     0
+#define PUD_DOWN    1
+#define PUD_UP      2
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiSetupGpio
+ */
+/**
+ *  @brief
+ *      Initialises the simulated Elf (memory, pins)
+ *  @return
+ *      int         0, -1 on error (image file)
+ */
+/* ===================================================================*/
+int wiringPiSetupGpio(void);
+
+/*
+ ** ===================================================================
+ **  Method      :  pinMode
+ */
+/**
+ *  @brief
+ *      Sets the direction of a pin, ignored (the level is kept)
+ *  @param
+ *      pin         BCM number
+ *  @param
+ *      mode        INPUT or OUTPUT
+ */
+/* ===================================================================*/
+void pinMode(int pin, int mode);
+
+/*
+ ** ===================================================================
+ **  Method      :  pullUpDnControl
+ */
+/**
+ *  @brief
+ *      Pull up or down, ignored (the Elf lines are pulled up)
+ *  @param
+ *      pin         BCM number
+ *  @param
+ *      pud         PUD_OFF, PUD_DOWN or PUD_UP
+ */
+/* ===================================================================*/
+void pullUpDnControl(int pin, int pud);
+
+/*
+ ** ===================================================================
+ **  Method      :  digitalWrite
+ */
+/**
+ *  @brief
+ *      Sets a pin, the Elf reacts on IN, WAIT and CLEAR
+ *  @param
+ *      pin         BCM number
+ *  @param
+ *      value       0 or 1
+ */
+/* ===================================================================*/
+void digitalWrite(int pin, int value);
+
+/*
+ ** ===================================================================
+ **  Method      :  digitalRead
+ */
+/**
+ *  @brief
+ *      Gets a pin, the LED port pins are driven by the Elf
+ *  @param
+ *      pin         BCM number
+ *  @return
+ *      int         0 or 1
+ */
+/* ===================================================================*/
+int digitalRead(int pin);
+
+#endif /* GPIO_SIM_H_ */
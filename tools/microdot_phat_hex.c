@@ -2,10 +2,19 @@
  *  @brief
  *      Interface to the Microdot pHAT Display.
  *
- *      It displays uint8 as two hex digits. 
- *      The font looks like TIL311.
+ *      It displays uint8 as two hex digits or a text of six characters.
+ *      The font looks like TIL311. The register values of both matrix
+ *      orientations are in a glyph atlas computed at compile time, a 
+ *      frame is a table copy.
  * 
- *      The wiringPi library is used to control the I2C. 
+ *      The wiringPi library is used to control the I2C. Compiled with 
+ *      -DMICRODOT_SIM the display is simulated (see microdot_sim.h).
+ *
+ *      Each IS31FL3730 is opened once and the fd is kept. A shadow copy
+ *      of both matrices is kept per display: only the changed rows are 
+ *      sent as one auto-increment block write per matrix, together with
+ *      the update column register in one I2C_RDWR transaction. An 
+ *      unchanged frame is not sent at all.
  *
  *  @file
  *      microdot_phat_hex.c
@@ -38,15 +47,24 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#ifdef MICRODOT_SIM
+#include "microdot_sim.h"
+#else
 #include <wiringPi.h>
 #include <wiringPiI2C.h>
+#endif
 
 #include "microdot_phat_hex.h"
 
-#define debug       0
-
 #define DRIVER_BASE (0x61)
+#define DISPLAYS    (3)
+#define MATRICES    (2)
+#define MATRIX_ROWS (8)
 
 
 #define CONFIGURATION_REGISTER      0x00 // Set operation mode of IS31FL3730 
@@ -62,196 +80,692 @@
 #define AUDIO_INPUT_ENABLE          0x04
 #define DOT_MATRIX_8x8              0x00
 
-  
-static const uint8_t font_til311[16][7]={
-  {   // 0 
+static int display_fd[DISPLAYS] = {-1, -1, -1};
+static uint8_t shadow[DISPLAYS][MATRICES][MATRIX_ROWS];
+static uint8_t shadow_valid[DISPLAYS];
+
+// ASCII ' ' to '_', lower case letters are shown as upper case
+#define FIRST_GLYPH ' '
+#define LAST_GLYPH  '_'
+#define GLYPHS      (LAST_GLYPH - FIRST_GLYPH + 1)
+
+// glyph rows are 5 bit wide, bit 4 is the left column
+// matrix 1: a row per register, mirrored (bit 0 is the left column)
+#define M1(r)       ((((r) & 0x01) << 4) | (((r) & 0x02) << 2) | ((r) & 0x04) | \
+		     (((r) & 0x08) >> 2) | (((r) & 0x10) >> 4))
+// matrix 2: a column per register, bit n is row n
+#define M2_BIT(c, r, n) ((((r) >> (4 - (c))) & 0x01) << (n))
+#define M2(c, r0, r1, r2, r3, r4, r5, r6) \
+  (M2_BIT(c, r0, 0) | M2_BIT(c, r1, 1) | M2_BIT(c, r2, 2) | M2_BIT(c, r3, 3) | \
+   M2_BIT(c, r4, 4) | M2_BIT(c, r5, 5) | M2_BIT(c, r6, 6))
+#define GLYPH(r0, r1, r2, r3, r4, r5, r6) {				\
+    {M1(r0), M1(r1), M1(r2), M1(r3), M1(r4), M1(r5), M1(r6), 0},	\
+    {M2(0, r0, r1, r2, r3, r4, r5, r6), M2(1, r0, r1, r2, r3, r4, r5, r6), \
+     M2(2, r0, r1, r2, r3, r4, r5, r6), M2(3, r0, r1, r2, r3, r4, r5, r6), \
+     M2(4, r0, r1, r2, r3, r4, r5, r6), 0, 0, 0}			\
+  }
+
+/*
+ * Register values of both matrices for each character, computed by the
+ * compiler. The hex digits look like TIL311.
+ */
+static const uint8_t font_atlas[GLYPHS][MATRICES][MATRIX_ROWS] = {
+  GLYPH(   // space
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000),
+  GLYPH(   // !
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00000,
+    0b00100),
+  GLYPH(   // "
+    0b01010,
+    0b01010,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000),
+  GLYPH(   // #
+    0b01010,
+    0b01010,
+    0b11111,
+    0b01010,
+    0b11111,
+    0b01010,
+    0b01010),
+  GLYPH(   // $
+    0b00100,
+    0b01111,
+    0b10100,
+    0b01110,
+    0b00101,
+    0b11110,
+    0b00100),
+  GLYPH(   // %
+    0b11001,
+    0b11010,
+    0b00010,
+    0b00100,
+    0b01000,
+    0b01011,
+    0b10011),
+  GLYPH(   // &
+    0b01100,
+    0b10010,
+    0b10100,
+    0b01000,
+    0b10101,
+    0b10010,
+    0b01101),
+  GLYPH(   // apostrophe
+    0b00100,
+    0b00100,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000),
+  GLYPH(   // (
+    0b00010,
+    0b00100,
+    0b01000,
+    0b01000,
+    0b01000,
+    0b00100,
+    0b00010),
+  GLYPH(   // )
+    0b01000,
+    0b00100,
+    0b00010,
+    0b00010,
+    0b00010,
+    0b00100,
+    0b01000),
+  GLYPH(   // *
+    0b00000,
+    0b00100,
+    0b10101,
+    0b01110,
+    0b10101,
+    0b00100,
+    0b00000),
+  GLYPH(   // +
+    0b00000,
+    0b00100,
+    0b00100,
+    0b11111,
+    0b00100,
+    0b00100,
+    0b00000),
+  GLYPH(   // ,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00100,
+    0b00100,
+    0b01000),
+  GLYPH(   // -
+    0b0000,
+    0b0000,
+    0b0000,
+    0b1111,
+    0b0000,
+    0b0000,
+    0b0000),
+  GLYPH(   // .
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00100),
+  GLYPH(   // /
+    0b00001,
+    0b00001,
+    0b00010,
+    0b00100,
+    0b01000,
+    0b10000,
+    0b10000),
+  GLYPH(   // 0
     0b0110,
     0b1001,
     0b1001,
     0b1001,
     0b1001,
     0b1001,
-    0b0110
-  },
-  {   // 1
+    0b0110),
+  GLYPH(   // 1
     0b0001,
     0b0001,
     0b0001,
     0b0001,
     0b0001,
     0b0001,
-    0b0001
-  },
-  {   // 2 
+    0b0001),
+  GLYPH(   // 2
     0b1110,
     0b0001,
     0b0001,
     0b0110,
     0b1000,
     0b1000,
-    0b1111
-  },
-  {   // 3 
+    0b1111),
+  GLYPH(   // 3
     0b1110,
     0b0001,
     0b0001,
     0b0110,
     0b0001,
     0b0001,
-    0b1110
-  },
-  {   // 4 
+    0b1110),
+  GLYPH(   // 4
     0b1000,
     0b1001,
     0b1001,
     0b1111,
     0b0001,
     0b0001,
-    0b0001
-  },
-  {   // 5
+    0b0001),
+  GLYPH(   // 5
     0b1111,
     0b1000,
     0b1000,
     0b1110,
     0b0001,
     0b0001,
-    0b1110
-  },
-  {   // 6 
+    0b1110),
+  GLYPH(   // 6
     0b0110,
     0b1000,
     0b1000,
     0b1110,
     0b1001,
     0b1001,
-    0b0110
-  },
-  {   // 7
+    0b0110),
+  GLYPH(   // 7
     0b1111,
     0b0001,
     0b0001,
     0b0001,
     0b0001,
     0b0001,
-    0b0001
-  },
-  {   // 8
+    0b0001),
+  GLYPH(   // 8
     0b0110,
     0b1001,
     0b1001,
     0b0110,
     0b1001,
     0b1001,
-    0b0110
-  },
-  {   // 9
+    0b0110),
+  GLYPH(   // 9
     0b0110,
     0b1001,
     0b1001,
     0b0111,
     0b0001,
     0b0001,
-    0b0110
-  },
-  {   // A
+    0b0110),
+  GLYPH(   // :
+    0b00000,
+    0b00100,
+    0b00100,
+    0b00000,
+    0b00100,
+    0b00100,
+    0b00000),
+  GLYPH(   // ;
+    0b00000,
+    0b00100,
+    0b00100,
+    0b00000,
+    0b00100,
+    0b00100,
+    0b01000),
+  GLYPH(   // <
+    0b00010,
+    0b00100,
+    0b01000,
+    0b10000,
+    0b01000,
+    0b00100,
+    0b00010),
+  GLYPH(   // =
+    0b0000,
+    0b0000,
+    0b1111,
+    0b0000,
+    0b1111,
+    0b0000,
+    0b0000),
+  GLYPH(   // >
+    0b01000,
+    0b00100,
+    0b00010,
+    0b00001,
+    0b00010,
+    0b00100,
+    0b01000),
+  GLYPH(   // ?
+    0b0110,
+    0b1001,
+    0b0001,
+    0b0010,
+    0b0100,
+    0b0000,
+    0b0100),
+  GLYPH(   // @
+    0b01110,
+    0b10001,
+    0b10111,
+    0b10101,
+    0b10111,
+    0b10000,
+    0b01111),
+  GLYPH(   // A
     0b0110,
     0b1001,
     0b1001,
     0b1111,
     0b1001,
     0b1001,
-    0b1001
-  },
-  {   // B
+    0b1001),
+  GLYPH(   // B
     0b1110,
     0b1001,
     0b1001,
     0b1110,
     0b1001,
     0b1001,
-    0b1110
-  },
-  {   // C
+    0b1110),
+  GLYPH(   // C
     0b0111,
     0b1000,
     0b1000,
     0b1000,
     0b1000,
     0b1000,
-    0b0111
-  },
-  {   // D
+    0b0111),
+  GLYPH(   // D
     0b1110,
     0b1001,
     0b1001,
     0b1001,
     0b1001,
     0b1001,
-    0b1110
-  },
-  {   // E
+    0b1110),
+  GLYPH(   // E
     0b1111,
     0b1000,
     0b1000,
     0b1111,
     0b1000,
     0b1000,
-    0b1111
-  },
-  {   // F
+    0b1111),
+  GLYPH(   // F
     0b1111,
     0b1000,
     0b1000,
     0b1110,
     0b1000,
     0b1000,
-    0b1000
-  }
+    0b1000),
+  GLYPH(   // G
+    0b0111,
+    0b1000,
+    0b1000,
+    0b1011,
+    0b1001,
+    0b1001,
+    0b0111),
+  GLYPH(   // H
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1111,
+    0b1001,
+    0b1001,
+    0b1001),
+  GLYPH(   // I
+    0b0111,
+    0b0010,
+    0b0010,
+    0b0010,
+    0b0010,
+    0b0010,
+    0b0111),
+  GLYPH(   // J
+    0b0001,
+    0b0001,
+    0b0001,
+    0b0001,
+    0b0001,
+    0b1001,
+    0b0110),
+  GLYPH(   // K
+    0b1001,
+    0b1010,
+    0b1100,
+    0b1000,
+    0b1100,
+    0b1010,
+    0b1001),
+  GLYPH(   // L
+    0b1000,
+    0b1000,
+    0b1000,
+    0b1000,
+    0b1000,
+    0b1000,
+    0b1111),
+  GLYPH(   // M
+    0b10001,
+    0b11011,
+    0b10101,
+    0b10101,
+    0b10001,
+    0b10001,
+    0b10001),
+  GLYPH(   // N
+    0b1001,
+    0b1001,
+    0b1101,
+    0b1011,
+    0b1001,
+    0b1001,
+    0b1001),
+  GLYPH(   // O
+    0b0110,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b0110),
+  GLYPH(   // P
+    0b1110,
+    0b1001,
+    0b1001,
+    0b1110,
+    0b1000,
+    0b1000,
+    0b1000),
+  GLYPH(   // Q
+    0b0110,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1010,
+    0b0101),
+  GLYPH(   // R
+    0b1110,
+    0b1001,
+    0b1001,
+    0b1110,
+    0b1100,
+    0b1010,
+    0b1001),
+  GLYPH(   // S
+    0b0111,
+    0b1000,
+    0b1000,
+    0b0110,
+    0b0001,
+    0b0001,
+    0b1110),
+  GLYPH(   // T
+    0b11111,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100),
+  GLYPH(   // U
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b1001,
+    0b0110),
+  GLYPH(   // V
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10001,
+    0b01010,
+    0b01010,
+    0b00100),
+  GLYPH(   // W
+    0b10001,
+    0b10001,
+    0b10001,
+    0b10101,
+    0b10101,
+    0b11011,
+    0b10001),
+  GLYPH(   // X
+    0b10001,
+    0b10001,
+    0b01010,
+    0b00100,
+    0b01010,
+    0b10001,
+    0b10001),
+  GLYPH(   // Y
+    0b10001,
+    0b10001,
+    0b01010,
+    0b00100,
+    0b00100,
+    0b00100,
+    0b00100),
+  GLYPH(   // Z
+    0b1111,
+    0b0001,
+    0b0010,
+    0b0110,
+    0b0100,
+    0b1000,
+    0b1111),
+  GLYPH(   // [
+    0b01110,
+    0b01000,
+    0b01000,
+    0b01000,
+    0b01000,
+    0b01000,
+    0b01110),
+  GLYPH(   // backslash
+    0b10000,
+    0b10000,
+    0b01000,
+    0b00100,
+    0b00010,
+    0b00001,
+    0b00001),
+  GLYPH(   // ]
+    0b01110,
+    0b00010,
+    0b00010,
+    0b00010,
+    0b00010,
+    0b00010,
+    0b01110),
+  GLYPH(   // ^
+    0b00100,
+    0b01010,
+    0b10001,
+    0b00000,
+    0b00000,
+    0b00000,
+    0b00000),
+  GLYPH(   // _
+    0b0000,
+    0b0000,
+    0b0000,
+    0b0000,
+    0b0000,
+    0b0000,
+    0b1111)
 };
 
-#if debug == 1
-static void print_dot(uint8_t row) {
+static const char hex_char[16] = {
+  '0', '1', '2', '3', '4', '5', '6', '7',
+  '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
 
-  int i;
-  printf("%2x", row);
-  for (i=7; i>=0; i--) {
-    if ((row >> i) & 0x01) {
-      printf("*");
-    } else {
-      printf("-");
-    }
+static int open_display(uint8_t position) {
+  if (display_fd[position] < 0) {
+    display_fd[position] = wiringPiI2CSetup(DRIVER_BASE + position);
   }
-  printf("\n");
+  return display_fd[position];
 }
+
+/*
+ ** ===================================================================
+ **  Method      :  send_frame
+ */
+/**
+ *  @brief
+ *      Sends the rows of both matrices that differ from the shadow copy.
+ *      The changed range of each matrix is one block write (the register
+ *      address is incremented by the IS31FL3730), the update column 
+ *      register follows in the same transaction.
+ *  @param
+ *      position[in]        position: 0 right, 1 middle, 2 left
+ *  @param
+ *      frame[in]           rows of matrix 1 and matrix 2
+ *
+ *  @return
+ *      int     error number: -1 I2C
+ */
+/* ===================================================================*/
+static int send_frame(uint8_t position, 
+		      const uint8_t frame[MATRICES][MATRIX_ROWS]) {
+  static const uint8_t base[MATRICES] = {
+    MATRIX_1_DATA_REGISTER, MATRIX_2_DATA_REGISTER
+  };
+  struct i2c_msg msg[MATRICES + 1];
+  struct i2c_rdwr_ioctl_data rdwr;
+  uint8_t buf[MATRICES][MATRIX_ROWS + 1];
+  uint8_t update[2] = {UPDATE_COLUMN_REGISTER, 0};
+  int fd;
+  int m;
+  int first;
+  int last;
+  int n = 0;
+
+  fd = open_display(position);
+  if (fd < 0) {
+    // can't open I2C device
+    return (-1);
+  }
+
+  for (m = 0; m < MATRICES; m++) {
+    first = 0;
+    last = MATRIX_ROWS - 1;
+    if (shadow_valid[position]) {
+      // changed rows only
+      while (first < MATRIX_ROWS && 
+	     frame[m][first] == shadow[position][m][first]) {
+	first++;
+      }
+      if (first == MATRIX_ROWS) {
+	continue;
+      }
+      while (frame[m][last] == shadow[position][m][last]) {
+	last--;
+      }
+    }
+    buf[m][0] = base[m] + first;
+    memcpy(&buf[m][1], &frame[m][first], last - first + 1);
+    msg[n].addr = DRIVER_BASE + position;
+    msg[n].flags = 0;
+    msg[n].len = last - first + 2;
+    msg[n].buf = buf[m];
+    n++;
+  }
+  if (n == 0) {
+    // unchanged frame
+    return (0);
+  }
+  msg[n].addr = DRIVER_BASE + position;
+  msg[n].flags = 0;
+  msg[n].len = sizeof(update);
+  msg[n].buf = update;
+  n++;
+
+  rdwr.msgs = msg;
+  rdwr.nmsgs = n;
+#ifdef MICRODOT_SIM
+  if (microdot_sim_rdwr(fd, &rdwr) < 0) {
+#else
+  if (ioctl(fd, I2C_RDWR, &rdwr) < 0) {
 #endif
+    // unknown state, send the whole frame next time
+    shadow_valid[position] = FALSE;
+    return (-1);
+  }
+  memcpy(shadow[position], frame, sizeof(shadow[position]));
+  shadow_valid[position] = TRUE;
+  return (0);
+}
 
-static uint8_t mirror_5bit(uint8_t input) {
-  uint8_t returnval = 0;
-  int i;
-  for (i = 0; i < 5; ++i) {
-    returnval |= (input & 0x01);
-    input >>= 1;
-    returnval <<= 1;
+/*
+ ** ===================================================================
+ **  Method      :  glyph
+ */
+/**
+ *  @brief
+ *      Atlas entry of a character, unknown characters are blank
+ *  @param
+ *      c[in]               character
+ *
+ *  @return
+ *      register values of matrix 1 and matrix 2
+ */
+/* ===================================================================*/
+static const uint8_t (*glyph(char c))[MATRIX_ROWS] {
+  if (c >= 'a' && c <= 'z') {
+    c -= 'a' - 'A';
+  }
+  if (c < FIRST_GLYPH || c > LAST_GLYPH) {
+    c = ' ';
   }
-  return returnval;
+  return font_atlas[c - FIRST_GLYPH];
 }
 
 
 /*
  ** ===================================================================
- **  Method      :  write_hex_digits
+ **  Method      :  write_chars
  */
 /**
  *  @brief
- *      It displays uint8 as two hex digits. 
- *      The font looks like TIL311.
+ *      Displays two characters on one module
  *  @param
- *      data[in]            data to display
+ *      hi[in]              left character (matrix 2)
  *  @param
- *      hi_nibble_dp[in]    high nibble decimal point (0 off)
+ *      low[in]             right character (matrix 1)
  *  @param
- *      low_nibble_dp[in]   low nibble decimal point (0 off)
+ *      hi_dp[in]           left decimal point (0 off)
+ *  @param
+ *      low_dp[in]          right decimal point (0 off)
  *  @param
  *      position[in]        position: 0 right, 1 middle, 2 left
  *
@@ -259,77 +773,100 @@ static uint8_t mirror_5bit(uint8_t input) {
  *      int     error number: -1 wiringPi, -2 parameter
  */
 /* ===================================================================*/
-int write_hex_digits(uint8_t data, uint8_t hi_nibble_dp, 
-                     uint8_t low_nibble_dp, uint8_t position) {
+int write_chars(char hi, char low, uint8_t hi_dp, uint8_t low_dp,
+                uint8_t position) {
 
-  int fd;
-  uint8_t matrix[2][8];
-  int c;
+  uint8_t frame[MATRICES][MATRIX_ROWS];
   int row;
-  int column;
-  uint8_t font_x_y[7];
-  uint8_t low_dp = 0;
-  uint8_t hi_dp = 0;
 
-  if (position >= 0 && position < 3) {
-    fd = wiringPiI2CSetup(DRIVER_BASE + position);
-    if (fd < 0) {
-      // can't open I2C device
-      return (-1);
-    }
-  } else {
+  if (position >= DISPLAYS) {
     // invalid position
     return (-2);
   }
 
-  if (low_nibble_dp) {
+  memcpy(frame[0], glyph(low)[0], MATRIX_ROWS);
+  memcpy(frame[1], glyph(hi)[1], MATRIX_ROWS);
+  if (low_dp) {
     // notice low nibble decimal point
-    low_dp = 0x80;
+    for (row=0; row<7; row++) {
+      frame[0][row] |= 0x80;
+    }
   }
-
-  if (hi_nibble_dp) {
+  if (hi_dp) {
     // notice high nibble decimal point
-    hi_dp = 0xFF;
+    frame[1][7] = 0xFF;
   }
 
-  // low nibble
-  c = data & 0x0F;
-  for (row=0; row<7; row++) { 
-#if debug == 1  
-    print_dot(font_til311[c][row]);
-#endif
-    wiringPiI2CWriteReg8 (fd, MATRIX_1_DATA_REGISTER+row, (mirror_5bit(font_til311[c][row]) >> 1) | low_dp);
-  }
+  return send_frame(position, frame);
+}
 
-#if debug == 1
-  printf("\n");
-#endif
 
-  // high nibble
-  c = data >> 4;
-  for (column=0; column<7; column++) {
-    font_x_y[column] = 0;   
-    for (row=0; row<7; row++) {
-      if (font_til311[c][row] & (0x10 >> column)) {
-	font_x_y[column] |= (0x01 << row);
-      }   
-    }
-  }
-  for (row=0; row<7; row++) { 
-#if debug == 1
-    print_dot(font_x_y[row]);
-#endif
-    wiringPiI2CWriteReg8 (fd, MATRIX_2_DATA_REGISTER+row, font_x_y[row]);
-  }
-  wiringPiI2CWriteReg8 (fd, MATRIX_2_DATA_REGISTER+7, hi_dp);
+/*
+ ** ===================================================================
+ **  Method      :  write_hex_digits
+ */
+/**
+ *  @brief
+ *      It displays uint8 as two hex digits.
+ *      The font looks like TIL311.
+ *  @param
+ *      data[in]            data to display
+ *  @param
+ *      hi_nibble_dp[in]    high nibble decimal point (0 off)
+ *  @param
+ *      low_nibble_dp[in]   low nibble decimal point (0 off)
+ *  @param
+ *      position[in]        position: 0 right, 1 middle, 2 left
+ *
+ *  @return
+ *      int     error number: -1 wiringPi, -2 parameter
+ */
+/* ===================================================================*/
+int write_hex_digits(uint8_t data, uint8_t hi_nibble_dp,
+                     uint8_t low_nibble_dp, uint8_t position) {
 
-#if debug == 1
-  printf("\n");
-#endif
+  return write_chars(hex_char[data >> 4], hex_char[data & 0x0F],
+                     hi_nibble_dp, low_nibble_dp, position);
+}
+
+
+/*
+ ** ===================================================================
+ **  Method      :  write_text
+ */
+/**
+ *  @brief
+ *      Displays up to six characters from left to right, a shorter
+ *      text is filled with blanks
+ *  @param
+ *      text[in]            text
+ *  @param
+ *      dp[in]              decimal points, bit 0 is the rightmost
+ *                          character
+ *
+ *  @return
+ *      int     error number: -1 wiringPi
+ */
+/* ===================================================================*/
+int write_text(const char *text, uint8_t dp) {
 
-  wiringPiI2CWriteReg8 (fd, UPDATE_COLUMN_REGISTER, 0) ;
+  char c[2 * DISPLAYS];
+  int i;
+  int err;
 
-  close(fd);
+  for (i=0; i<2*DISPLAYS; i++) {
+    c[i] = *text ? *text++ : ' ';
+  }
+  for (i=0; i<DISPLAYS; i++) {
+    // the left module is position 2
+    err = write_chars(c[2 * i], c[2 * i + 1],
+                      dp & (0x20 >> (2 * i)), dp & (0x10 >> (2 * i)),
+                      DISPLAYS - 1 - i);
+    if (err < 0) {
+      return (err);
+    }
+  }
+  return (0);
 }
 
 
@@ -347,11 +884,10 @@ int write_hex_digits(uint8_t data, uint8_t hi_nibble_dp,
 int clear_display(void) {
 
   int fd;
-  uint8_t row;
   uint8_t position;
 
-  for (position=0; position<3; position++) {
-    fd = wiringPiI2CSetup(DRIVER_BASE + position);
+  for (position=0; position<DISPLAYS; position++) {
+    fd = open_display(position);
     if (fd < 0) {
       // can't open I2C device
       return (-1);
@@ -359,9 +895,33 @@ int clear_display(void) {
 
     wiringPiI2CWriteReg8 (fd, RESET_REGISTER, 0) ;
     wiringPiI2CWriteReg8 (fd, CONFIGURATION_REGISTER, MATRIX1_AND_MATRIX2 | DOT_MATRIX_8x8) ;
+    // all data registers are 0 after the reset
+    memset(shadow[position], 0, sizeof(shadow[position]));
+    shadow_valid[position] = TRUE;
   }
   
-  close(fd);
+  return (0);
 }
 
 
+/*
+ ** ===================================================================
+ **  Method      :  close_display
+ */
+/**
+ *  @brief
+ *      Closes the I2C devices of the displays
+ */
+/* ===================================================================*/
+void close_display(void) {
+
+  uint8_t position;
+
+  for (position=0; position<DISPLAYS; position++) {
+    if (display_fd[position] >= 0) {
+      close(display_fd[position]);
+      display_fd[position] = -1;
+    }
+    shadow_valid[position] = FALSE;
+  }
+}
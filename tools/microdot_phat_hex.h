@@ -2,7 +2,7 @@
  *  @brief
  *      Interface to the Microdot pHAT Display.
  *
- * 	It displays uint8 as two hex digits. 
+ * 	It displays uint8 as two hex digits or a text of six characters.
  * 	The font looks like TIL311.
  * 
  * 	The wiringPi library is used to control the I2C. 
@@ -60,6 +60,53 @@
 /* ===================================================================*/
 int write_hex_digits(uint8_t data, uint8_t hi_nibble_dp, 
 		     uint8_t low_nibble_dp, uint8_t position);
+
+/*
+ ** ===================================================================
+ **  Method      :  write_chars
+ */
+/**
+ *  @brief
+ * 		Displays two characters on one module. The characters
+ * 		' ' to '_' are known, lower case letters are shown as
+ * 		upper case, others are blank.
+ * 	@param
+ * 		hi[in]			left character
+ * 	@param
+ * 		low[in]			right character
+ * 	@param
+ * 		hi_dp[in]		left decimal point (0 off)
+ * 	@param
+ * 		low_dp[in]		right decimal point (0 off)
+ * 	@param
+ * 		position[in]	        position: 0 right, 1 middle, 2 left
+ *
+ *  @return
+ *      int	        error number: -1 wiringPi, -2 parameter
+ */
+/* ===================================================================*/
+int write_chars(char hi, char low, uint8_t hi_dp, uint8_t low_dp,
+		uint8_t position);
+
+/*
+ ** ===================================================================
+ **  Method      :  write_text
+ */
+/**
+ *  @brief
+ * 		Displays up to six characters from left to right, a
+ * 		shorter text is filled with blanks (e.g. "LOAD", "RUN")
+ * 	@param
+ * 		text[in]		text
+ * 	@param
+ * 		dp[in]			decimal points, bit 0 is the rightmost
+ * 					character
+ *
+ *  @return
+ *      int	        error number: -1 wiringPi
+ */
+/* ===================================================================*/
+int write_text(const char *text, uint8_t dp);
 				     
 /*
  ** ===================================================================
@@ -74,5 +121,16 @@ int write_hex_digits(uint8_t data, uint8_t hi_nibble_dp,
 /* ===================================================================*/
 int clear_display(void);
 
+/*
+ ** ===================================================================
+ **  Method      :  close_display
+ */
+/**
+ *  @brief
+ *      Closes the I2C devices of the displays
+ */
+/* ===================================================================*/
+void close_display(void);
+
 
 #endif /* MICRODOT_PHAT_HEX_H_ */
@@ -0,0 +1,425 @@
+/**
+ *  @brief
+ *      Software stand-in for the I2C layer of the Micro Dot pHAT with
+ *      three IS31FL3730 behind it.
+ *
+ *      Keeps the registers of each driver. Writing the update column
+ *      register latches matrix 1 (a row per register) and matrix 2 (a
+ *      column per register) and shows the six digits with the decimal
+ *      points. The time on the bus is simulated with the I2C clock.
+ *
+ *  @file
+ *      microdot_sim.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "microdot_sim.h"
+#include "sim_bench.h"
+
+#define DRIVER_BASE     (0x61)
+#define DISPLAYS        (3)
+#define REGISTERS       (0x100)
+#define MATRIX_ROWS     (8)
+#define DIGIT_ROWS      (7)
+#define DIGIT_COLUMNS   (5)
+#define DEFAULT_SPEED   (100000)
+
+#define MATRIX_1_DATA_REGISTER      0x01
+#define MATRIX_2_DATA_REGISTER      0x0E
+#define UPDATE_COLUMN_REGISTER      0x0C
+#define RESET_REGISTER              0xFF
+
+typedef struct {
+  int fd;
+  uint8_t reg[REGISTERS];
+  // latched matrix 1 (rows) and matrix 2 (columns)
+  uint8_t matrix_1[MATRIX_ROWS];
+  uint8_t matrix_2[MATRIX_ROWS];
+  // statistics
+  unsigned long frames;
+  unsigned long transfers;
+  unsigned long bytes;
+  long long latency_ns;
+  long long max_latency_ns;
+} sim_driver_t;
+
+static sim_driver_t driver[DISPLAYS];
+static FILE *frame_log = NULL;
+static long speed = DEFAULT_SPEED;
+static int print_stats = FALSE;
+static int configured = FALSE;
+static unsigned long frames = 0;
+static struct timespec start_time;
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_bench_t *bench = NULL;
+
+
+static long long ns_since(const struct timespec *t) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - t->tv_sec) * 1000000000LL + (now.tv_nsec - t->tv_nsec);
+}
+
+static void exit_stats(void) {
+  int i;
+
+  if (frame_log != NULL) {
+    fclose(frame_log);
+  }
+  if (!print_stats) {
+    return;
+  }
+  for (i = 0; i < DISPLAYS; i++) {
+    if (driver[i].fd < 0) {
+      continue;
+    }
+    fprintf(stderr,
+	    "microdot_sim 0x%02x: %lu frames, %lu transfers, %lu bytes, "
+	    "latency %.0f us avg, %.0f us max, %.3f s\n",
+	    DRIVER_BASE + i, driver[i].frames, driver[i].transfers,
+	    driver[i].bytes,
+	    driver[i].frames ? driver[i].latency_ns / 1e3 / driver[i].frames
+			     : 0.0,
+	    driver[i].max_latency_ns / 1e3, ns_since(&start_time) / 1e9);
+  }
+}
+
+static void configure(void) {
+  const char *env;
+  int i;
+
+  for (i = 0; i < DISPLAYS; i++) {
+    // not opened
+    driver[i].fd = -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  if ((env = getenv("MICRODOT_SIM_SPEED")) != NULL) {
+    speed = strtol(env, NULL, 10);
+  }
+  print_stats = getenv("MICRODOT_SIM_STATS") != NULL;
+  if ((env = getenv("MICRODOT_SIM_LOG")) != NULL) {
+    frame_log = fopen(env, "a");
+    if (frame_log == NULL) {
+      perror(env);
+    }
+  }
+  atexit(exit_stats);
+  bench = sim_bench_open("i2c");
+  configured = TRUE;
+}
+
+static sim_driver_t *find_driver(int fd) {
+  int i;
+
+  for (i = 0; configured && i < DISPLAYS; i++) {
+    if (driver[i].fd >= 0 && driver[i].fd == fd) {
+      return &driver[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  pixel
+ */
+/**
+ *  @brief
+ *      Latched pixel of a digit, the left digit of a module is matrix 2,
+ *      the right digit is matrix 1. Column DIGIT_COLUMNS is the decimal
+ *      point (row 6 only).
+ */
+/* ===================================================================*/
+static int pixel(const sim_driver_t *d, int left, int row, int column) {
+  if (column == DIGIT_COLUMNS) {
+    if (row != DIGIT_ROWS - 1) {
+      return FALSE;
+    }
+    return left ? (d->matrix_2[7] & 0x40) != 0 : (d->matrix_1[6] & 0x80) != 0;
+  }
+  if (left) {
+    return (d->matrix_2[column] >> row) & 0x01;
+  }
+  return (d->matrix_1[row] >> column) & 0x01;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  show
+ */
+/**
+ *  @brief
+ *      Draws the latched matrices of all drivers (left module first) to
+ *      the frame log or the top lines of the terminal
+ */
+/* ===================================================================*/
+static void show(void) {
+  FILE *out = frame_log != NULL ? frame_log : stderr;
+  int row;
+  int i;
+  int left;
+  int column;
+  int on;
+
+  if (frame_log != NULL) {
+    fprintf(out, "frame %lu %.6f s\n", frames, ns_since(&start_time) / 1e9);
+  } else {
+    // save the cursor, home
+    fprintf(out, "\0337\033[1;1H");
+  }
+  for (row = 0; row < DIGIT_ROWS; row++) {
+    for (i = DISPLAYS - 1; i >= 0; i--) {
+      for (left = TRUE; left >= FALSE; left--) {
+	for (column = 0; column <= DIGIT_COLUMNS; column++) {
+	  on = pixel(&driver[i], left, row, column);
+	  if (frame_log != NULL) {
+	    fputc(on ? '#' : '.', out);
+	  } else {
+	    fputs(on ? "\033[31m█\033[0m" : " ", out);
+	  }
+	}
+      }
+      fputc(' ', out);
+    }
+    if (frame_log == NULL) {
+      // clear to the end of the line
+      fputs("\033[K", out);
+    }
+    fputc('\n', out);
+  }
+  if (frame_log == NULL) {
+    // restore the cursor
+    fputs("\0338", out);
+  }
+  fflush(out);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  write_register
+ */
+/**
+ *  @brief
+ *      Register write, the update column register latches the matrices
+ */
+/* ===================================================================*/
+static void write_register(sim_driver_t *d, uint8_t reg, uint8_t data) {
+  d->reg[reg] = data;
+  switch (reg) {
+  case UPDATE_COLUMN_REGISTER:
+    memcpy(d->matrix_1, &d->reg[MATRIX_1_DATA_REGISTER], MATRIX_ROWS);
+    memcpy(d->matrix_2, &d->reg[MATRIX_2_DATA_REGISTER], MATRIX_ROWS);
+    d->frames++;
+    frames++;
+    show();
+    break;
+  case RESET_REGISTER:
+    memset(d->reg, 0, sizeof(d->reg));
+    memset(d->matrix_1, 0, sizeof(d->matrix_1));
+    memset(d->matrix_2, 0, sizeof(d->matrix_2));
+    show();
+    break;
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  bus_time
+ */
+/**
+ *  @brief
+ *      Waits for the time on the bus: start, 9 clocks per byte, stop
+ */
+/* ===================================================================*/
+static void bus_time(unsigned long bytes, int messages) {
+  struct timespec t;
+  long long ns;
+
+  if (speed <= 0) {
+    return;
+  }
+  ns = (bytes * 9 + messages * 2) * 1000000000LL / speed;
+  t.tv_sec = ns / 1000000000LL;
+  t.tv_nsec = ns % 1000000000LL;
+  nanosleep(&t, NULL);
+}
+
+static void frame_latency(sim_driver_t *d, const struct timespec *t,
+			  unsigned long bytes) {
+  long long ns = ns_since(t);
+
+  sim_bench_op(bench, ns, bytes);
+
+  d->latency_ns += ns;
+  if (ns > d->max_latency_ns) {
+    d->max_latency_ns = ns;
+  }
+}
+
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiI2CSetup
+ */
+/**
+ *  @brief
+ *      Opens a simulated IS31FL3730
+ *  @param
+ *      devId       I2C address (0x61 to 0x63)
+ *  @return
+ *      int         file descriptor, -1 on error
+ */
+/* ===================================================================*/
+int wiringPiI2CSetup(int devId) {
+  sim_driver_t *d;
+
+  if (devId < DRIVER_BASE || devId >= DRIVER_BASE + DISPLAYS) {
+    return -1;
+  }
+  pthread_mutex_lock(&bus_lock);
+  if (!configured) {
+    configure();
+  }
+  d = &driver[devId - DRIVER_BASE];
+  if (d->fd < 0 || fcntl(d->fd, F_GETFD) < 0) {
+    // a descriptor that can be closed like the real one
+    d->fd = open("/dev/null", O_RDWR);
+  }
+  pthread_mutex_unlock(&bus_lock);
+  return d->fd;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiI2CWriteReg8
+ */
+/**
+ *  @brief
+ *      Writes one register
+ *  @param
+ *      fd          file descriptor from wiringPiI2CSetup
+ *  @param
+ *      reg         register
+ *  @param
+ *      data        value
+ *  @return
+ *      int         0, -1 on error
+ */
+/* ===================================================================*/
+int wiringPiI2CWriteReg8(int fd, int reg, int data) {
+  sim_driver_t *d;
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  pthread_mutex_lock(&bus_lock);
+  d = find_driver(fd);
+  if (d == NULL) {
+    pthread_mutex_unlock(&bus_lock);
+    return -1;
+  }
+  d->transfers++;
+  d->bytes += 3;
+  bus_time(3, 1);
+  write_register(d, reg, data);
+  if (reg == UPDATE_COLUMN_REGISTER) {
+    frame_latency(d, &t, 3);
+  }
+  pthread_mutex_unlock(&bus_lock);
+  return 0;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  microdot_sim_rdwr
+ */
+/**
+ *  @brief
+ *      Combined write transfer like ioctl(fd, I2C_RDWR, rdwr), each
+ *      message is a register address followed by data (auto-increment)
+ *  @param
+ *      fd          file descriptor from wiringPiI2CSetup
+ *  @param
+ *      rdwr        messages
+ *  @return
+ *      int         number of messages, -1 on error
+ */
+/* ===================================================================*/
+int microdot_sim_rdwr(int fd, struct i2c_rdwr_ioctl_data *rdwr) {
+  sim_driver_t *d;
+  struct i2c_msg *msg;
+  struct timespec t;
+  unsigned long bytes = 0;
+  int update = FALSE;
+  unsigned int i;
+  int j;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  pthread_mutex_lock(&bus_lock);
+  d = find_driver(fd);
+  if (d == NULL) {
+    pthread_mutex_unlock(&bus_lock);
+    return -1;
+  }
+  for (i = 0; i < rdwr->nmsgs; i++) {
+    msg = &rdwr->msgs[i];
+    if (msg->addr != DRIVER_BASE + (d - driver) || (msg->flags & I2C_M_RD) ||
+	msg->len == 0) {
+      // no answer from the address, the driver is write only
+      pthread_mutex_unlock(&bus_lock);
+      return -1;
+    }
+    // address byte, register, data
+    bytes += 1 + msg->len;
+  }
+  d->transfers++;
+  d->bytes += bytes;
+  bus_time(bytes, rdwr->nmsgs);
+  for (i = 0; i < rdwr->nmsgs; i++) {
+    msg = &rdwr->msgs[i];
+    for (j = 1; j < msg->len; j++) {
+      write_register(d, (msg->buf[0] + j - 1) & 0xFF, msg->buf[j]);
+      if (((msg->buf[0] + j - 1) & 0xFF) == UPDATE_COLUMN_REGISTER) {
+	update = TRUE;
+      }
+    }
+  }
+  if (update) {
+    frame_latency(d, &t, bytes);
+  }
+  pthread_mutex_unlock(&bus_lock);
+  return rdwr->nmsgs;
+}
@@ -0,0 +1,114 @@
+/**
+ *  @brief
+ *      Software stand-in for the I2C layer of the Micro Dot pHAT with
+ *      three IS31FL3730 behind it.
+ *
+ *      Compile microdot_phat_hex.c and the tools with -DMICRODOT_SIM and
+ *      link microdot_sim.o to run elfdisplay without the pHAT. The data
+ *      registers are shown when the update column register is written,
+ *      like the real driver does. The simulator is configured with
+ *      environment variables:
+ *
+ *      MICRODOT_SIM_LOG    frame log file name, each frame is appended
+ *                          as text with a time stamp. Without a log the
+ *                          display is drawn with ANSI blocks in the top
+ *                          lines of the terminal (stderr).
+ *      MICRODOT_SIM_SPEED  I2C clock in Hz (100000 is default), used for
+ *                          the transfer timing, 0 no delay
+ *      MICRODOT_SIM_STATS  print the statistics to stderr at exit: frames,
+ *                          transfers, bytes on the bus (address byte
+ *                          included) and the latency per frame
+ *
+ *      With SIM_BENCH set (see sim_bench.h) each frame (update of one
+ *      driver) is recorded as operation "i2c" with its latency.
+ *
+ *  @file
+ *      microdot_sim.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MICRODOT_SIM_H_
+#define MICRODOT_SIM_H_
+
+#ifndef TRUE
+#define TRUE    (1==1)
+#define FALSE   (!TRUE)
+#endif
+
+struct i2c_rdwr_ioctl_data;
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiI2CSetup
+ */
+/**
+ *  @brief
+ *      Opens a simulated IS31FL3730
+ *  @param
+ *      devId       I2C address (0x61 to 0x63)
+ *  @return
+ *      int         file descriptor, -1 on error
+ */
+/* ===================================================================*/
+int wiringPiI2CSetup(int devId);
+
+/*
+ ** ===================================================================
+ **  Method      :  wiringPiI2CWriteReg8
+ */
+/**
+ *  @brief
+ *      Writes one register
+ *  @param
+ *      fd          file descriptor from wiringPiI2CSetup
+ *  @param
+ *      reg         register
+ *  @param
+ *      data        value
+ *  @return
+ *      int         0, -1 on error
+ */
+/* ===================================================================*/
+int wiringPiI2CWriteReg8(int fd, int reg, int data);
+
+/*
+ ** ===================================================================
+ **  Method      :  microdot_sim_rdwr
+ */
+/**
+ *  @brief
+ *      Combined write transfer like ioctl(fd, I2C_RDWR, rdwr), each
+ *      message is a register address followed by data (auto-increment)
+ *  @param
+ *      fd          file descriptor from wiringPiI2CSetup
+ *  @param
+ *      rdwr        messages
+ *  @return
+ *      int         number of messages, -1 on error
+ */
+/* ===================================================================*/
+int microdot_sim_rdwr(int fd, struct i2c_rdwr_ioctl_data *rdwr);
+
+#endif /* MICRODOT_SIM_H_ */
@@ -36,7 +36,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#ifdef GPIO_SIM
+#include "gpio_sim.h"
+#else
 #include <wiringPi.h>
+#endif
 #include "raspi_gpio.h"
 
 
@@ -0,0 +1,210 @@
+/**
+ *  @brief
+ *      Operation recorder of the stand-ins for the benchmarks.
+ *
+ *      The latencies are stored (32 bit ns) in an array which grows as
+ *      needed. The percentiles are taken from the sorted array at exit,
+ *      the time of the run is from the start of the first to the end of
+ *      the last operation.
+ *
+ *  @file
+ *      sim_bench.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "sim_bench.h"
+
+#define RECORDERS       4
+#define FIRST_CAPACITY  4096
+
+struct sim_bench {
+  const char *name;
+  uint32_t *latency;
+  uint32_t ops;
+  uint32_t capacity;
+  uint64_t bytes;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  pthread_mutex_t lock;
+};
+
+static sim_bench_t recorder[RECORDERS];
+static int recorders = 0;
+static const char *bench_file = NULL;
+static pthread_mutex_t open_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static int compare_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *) a;
+  uint32_t y = *(const uint32_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+static void write_results(void) {
+  sim_bench_t *b;
+  FILE *fp;
+  double seconds;
+  int i;
+
+  fp = fopen(bench_file, "a");
+  if (fp == NULL) {
+    perror(bench_file);
+    return;
+  }
+  for (i = 0; i < recorders; i++) {
+    b = &recorder[i];
+    pthread_mutex_lock(&b->lock);
+    seconds = b->ops ? (b->end_ns - b->start_ns) / 1e9 : 0.0;
+    fprintf(fp, "{\"sim\": \"%s\", \"ops\": %u, \"bytes\": %llu, "
+	    "\"seconds\": %.6f, \"ops_per_s\": %.1f, \"bytes_per_s\": %.1f",
+	    b->name, b->ops, (unsigned long long) b->bytes, seconds,
+	    seconds > 0 ? b->ops / seconds : 0.0,
+	    seconds > 0 ? b->bytes / seconds : 0.0);
+    if (b->ops > 0) {
+      qsort(b->latency, b->ops, sizeof(b->latency[0]), compare_u32);
+      fprintf(fp, ", \"latency_us\": {\"p50\": %.1f, \"p95\": %.1f, "
+	      "\"p99\": %.1f, \"max\": %.1f}",
+	      b->latency[b->ops / 2] / 1e3,
+	      b->latency[(uint64_t) b->ops * 95 / 100] / 1e3,
+	      b->latency[(uint64_t) b->ops * 99 / 100] / 1e3,
+	      b->latency[b->ops - 1] / 1e3);
+    }
+    fprintf(fp, "}\n");
+    pthread_mutex_unlock(&b->lock);
+  }
+  fclose(fp);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  sim_bench_open
+ */
+/**
+ *  @brief
+ *      Opens a recorder if SIM_BENCH is set
+ *  @param
+ *      name        name of the stand-in ("gpio", "i2c" or "spi")
+ *  @return
+ *      sim_bench_t recorder, NULL if the benchmark is off
+ */
+/* ===================================================================*/
+sim_bench_t *sim_bench_open(const char *name) {
+  sim_bench_t *b = NULL;
+  int i;
+
+  pthread_mutex_lock(&open_lock);
+  if (recorders == 0) {
+    bench_file = getenv("SIM_BENCH");
+  }
+  if (bench_file == NULL) {
+    pthread_mutex_unlock(&open_lock);
+    return NULL;
+  }
+  for (i = 0; i < recorders; i++) {
+    if (strcmp(recorder[i].name, name) == 0) {
+      // opened again (e.g. a second chip select)
+      b = &recorder[i];
+    }
+  }
+  if (b == NULL && recorders < RECORDERS) {
+    if (recorders == 0) {
+      atexit(write_results);
+    }
+    b = &recorder[recorders++];
+    b->name = name;
+    pthread_mutex_init(&b->lock, NULL);
+  }
+  pthread_mutex_unlock(&open_lock);
+  return b;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  sim_bench_now
+ */
+/**
+ *  @brief
+ *      Monotonic time for the latency of an operation
+ *  @return
+ *      uint64_t    time in ns
+ */
+/* ===================================================================*/
+uint64_t sim_bench_now(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  sim_bench_op
+ */
+/**
+ *  @brief
+ *      Records an operation which ends now, thread safe
+ *  @param
+ *      bench       recorder, NULL nothing is recorded
+ *  @param
+ *      latency_ns  latency of the operation
+ *  @param
+ *      bytes       number of data bytes
+ */
+/* ===================================================================*/
+void sim_bench_op(sim_bench_t *bench, uint64_t latency_ns, uint32_t bytes) {
+  uint32_t *latency;
+  uint64_t now;
+
+  if (bench == NULL) {
+    return;
+  }
+  now = sim_bench_now();
+  pthread_mutex_lock(&bench->lock);
+  if (bench->ops == bench->capacity) {
+    latency = realloc(bench->latency, (bench->capacity ? 2 * bench->capacity
+				       : FIRST_CAPACITY) * sizeof(*latency));
+    if (latency == NULL) {
+      pthread_mutex_unlock(&bench->lock);
+      return;
+    }
+    bench->latency = latency;
+    bench->capacity = bench->capacity ? 2 * bench->capacity : FIRST_CAPACITY;
+  }
+  if (bench->ops == 0) {
+    bench->start_ns = now - latency_ns;
+  }
+  bench->latency[bench->ops++] = latency_ns > UINT32_MAX ? UINT32_MAX
+					     : latency_ns;
+  bench->bytes += bytes;
+  bench->end_ns = now;
+  pthread_mutex_unlock(&bench->lock);
+}
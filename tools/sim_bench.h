@@ -0,0 +1,98 @@
+/**
+ *  @brief
+ *      Operation recorder of the stand-ins (gpio_sim, microdot_sim and
+ *      spi_sim) for the benchmarks.
+ *
+ *      A stand-in opens a recorder and records each operation (IN strobe,
+ *      display frame or SPI data transfer) with its latency and the number
+ *      of data bytes. Only if the environment variable SIM_BENCH names a
+ *      file, otherwise the recorder is NULL and nothing is recorded. At
+ *      exit one JSON object per recorder is appended to the file:
+ *
+ *      {"sim": "gpio", "ops": 4096, "bytes": 4096, "seconds": 1.363,
+ *       "ops_per_s": 3005.1, "bytes_per_s": 3005.1,
+ *       "latency_us": {"p50": 321.3, "p95": 378.9, "p99": 641.0,
+ *       "max": 5102.7}}
+ *
+ *      bench runs a tool with SIM_BENCH set and collects the objects.
+ *
+ *  @file
+ *      sim_bench.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIM_BENCH_H_
+#define SIM_BENCH_H_
+
+#include <stdint.h>
+
+typedef struct sim_bench sim_bench_t;
+
+/*
+ ** ===================================================================
+ **  Method      :  sim_bench_open
+ */
+/**
+ *  @brief
+ *      Opens a recorder if SIM_BENCH is set
+ *  @param
+ *      name        name of the stand-in ("gpio", "i2c" or "spi")
+ *  @return
+ *      sim_bench_t recorder, NULL if the benchmark is off
+ */
+/* ===================================================================*/
+sim_bench_t *sim_bench_open(const char *name);
+
+/*
+ ** ===================================================================
+ **  Method      :  sim_bench_now
+ */
+/**
+ *  @brief
+ *      Monotonic time for the latency of an operation
+ *  @return
+ *      uint64_t    time in ns
+ */
+/* ===================================================================*/
+uint64_t sim_bench_now(void);
+
+/*
+ ** ===================================================================
+ **  Method      :  sim_bench_op
+ */
+/**
+ *  @brief
+ *      Records an operation which ends now, thread safe
+ *  @param
+ *      bench       recorder, NULL nothing is recorded
+ *  @param
+ *      latency_ns  latency of the operation
+ *  @param
+ *      bytes       number of data bytes
+ */
+/* ===================================================================*/
+void sim_bench_op(sim_bench_t *bench, uint64_t latency_ns, uint32_t bytes);
+
+#endif /* SIM_BENCH_H_ */
@@ -0,0 +1,258 @@
+/**
+ *  @brief
+ *      Measures the key latency of elfdisplay with a virtual keypad.
+ *
+ *      A keypad device is created with uinput, elfdisplay is started with
+ *      -l on its event device and a key sequence is typed. The sequence
+ *      stays in LOAD mode: data input, INPUT, memory protect toggle and
+ *      address input. At the end elfdisplay is stopped (SIGTERM) and
+ *      prints the latency percentiles per key type.
+ *
+ *   	synopsis
+ *       $ test-latency [-n <keys>] [-d <ms>] [-v] [<elfdisplay>]
+ *
+ *     -n keys
+ *        number of keys (200 is default)
+ *     -d ms
+ *        delay between the keys in ms (50 is default)
+ *     -v
+ *        verbose, the keys are printed out
+ *     elfdisplay
+ *        program to start (./elfdisplay is default, e.g. ./elfdisplay-sim)
+ *  @file
+ *      test-latency.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <dirent.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+
+#define MAX_FN_LENGTH PATH_MAX
+
+// keypad codes as mapped by elfdisplay
+#define KP_0      82
+#define KP_1      79
+#define KP_2      80
+#define KP_3      81
+#define KP_4      75
+#define KP_MINUS  74
+#define KP_PLUS   78
+#define KP_ENTER  96
+
+// LOAD mode: data, INPUT, write, data, INPUT, read, address 0010
+static const int sequence[] = {
+  KP_1, KP_2, KP_ENTER,
+  KP_MINUS, KP_3, KP_4, KP_ENTER, KP_MINUS,
+  KP_PLUS, KP_0, KP_0, KP_1, KP_0, KP_ENTER
+};
+
+void usage_exit(int err_number, const char *str);
+int emit(int fd, int type, int code, int value);
+int create_keypad(char *fn);
+
+int main(int argc, char *argv[]) {
+  char fn[MAX_FN_LENGTH];
+  const char *program = "./elfdisplay";
+  int keys = 200;
+  int delay_ms = 50;
+  int fd;
+  int i;
+  int code;
+  int status;
+  pid_t pid;
+
+  uint8_t verbose_mode = false;
+  int opt;
+
+  // parse command line options
+  while ((opt = getopt(argc, argv, "n:d:v")) != -1) {
+    switch (opt) {
+    case 'n':
+      keys = strtol(optarg, NULL, 10);
+      break;
+    case 'd':
+      delay_ms = strtol(optarg, NULL, 10);
+      break;
+    case 'v':
+      verbose_mode = true;
+      break;
+    default:
+      usage_exit(EXIT_FAILURE, argv[0]);
+      break;
+    }
+  }
+
+  // parse command
+  if (argc - optind == 1) {
+    program = argv[optind];
+  } else if (argc - optind > 1) {
+    // too many parameters
+    usage_exit(EXIT_FAILURE, argv[0]);
+  }
+
+  fd = create_keypad(fn);
+  if (fd < 0) {
+    perror("can not create the keypad (uinput)");
+    exit(1);
+  }
+  // udev needs a moment for the device
+  sleep(1);
+
+  pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(1);
+  }
+  if (pid == 0) {
+    execl(program, program, "-l", fn, (char *) NULL);
+    perror(program);
+    _exit(1);
+  }
+  // elfdisplay starts up
+  sleep(1);
+
+  for (i = 0; i < keys; i++) {
+    code = sequence[i % (sizeof(sequence) / sizeof(sequence[0]))];
+    if (verbose_mode) {
+      printf("Code: %d\n", code);
+    }
+    // elfdisplay acts on the release
+    if (emit(fd, EV_KEY, code, 1) < 0 || emit(fd, EV_SYN, SYN_REPORT, 0) < 0 ||
+	emit(fd, EV_KEY, code, 0) < 0 || emit(fd, EV_SYN, SYN_REPORT, 0) < 0) {
+      perror("can not send the key");
+      break;
+    }
+    usleep(delay_ms * 1000);
+  }
+
+  // the last frames
+  usleep(500000);
+  kill(pid, SIGTERM);
+  waitpid(pid, &status, 0);
+
+  ioctl(fd, UI_DEV_DESTROY);
+  close(fd);
+  exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+}
+
+void usage_exit(int err_number, const char *str) {
+  fprintf(stderr, "\
+Usage: %s [-n <keys>] [-d <ms>] [-v] [<elfdisplay>]\n\
+-n number of keys (200)\n\
+-d delay between the keys in ms (50)\n\
+-v verbose\n\
+\n",
+	  str);
+  exit(err_number);
+}
+
+int emit(int fd, int type, int code, int value) {
+  struct input_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.type = type;
+  ev.code = code;
+  ev.value = value;
+  return (write(fd, &ev, sizeof(ev)) == sizeof(ev) ? 0 : -1);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  create_keypad
+ */
+/**
+ *  @brief
+ *      Creates a keypad with uinput
+ *  @param
+ *      fn      file name of the event device (/dev/input/eventX)
+ *  @return
+ *      int     uinput file descriptor, -1 error
+ */
+/* ===================================================================*/
+int create_keypad(char *fn) {
+  struct uinput_setup setup;
+  char sysname[64];
+  char dn[MAX_FN_LENGTH];
+  struct dirent *entry;
+  DIR *dir;
+  int fd;
+  unsigned int i;
+
+  fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+  if (fd < 0) {
+    return (-1);
+  }
+  ioctl(fd, UI_SET_EVBIT, EV_KEY);
+  for (i = 0; i < sizeof(sequence) / sizeof(sequence[0]); i++) {
+    ioctl(fd, UI_SET_KEYBIT, sequence[i]);
+  }
+
+  memset(&setup, 0, sizeof(setup));
+  setup.id.bustype = BUS_VIRTUAL;
+  strcpy(setup.name, "RaspiElf test keypad");
+  if (ioctl(fd, UI_DEV_SETUP, &setup) != 0 || ioctl(fd, UI_DEV_CREATE) != 0) {
+    close(fd);
+    return (-1);
+  }
+
+  // find the event device: /sys/devices/virtual/input/inputN/eventX
+  if (ioctl(fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) {
+    close(fd);
+    return (-1);
+  }
+  snprintf(dn, sizeof(dn), "/sys/devices/virtual/input/%s", sysname);
+  dir = opendir(dn);
+  if (dir == NULL) {
+    close(fd);
+    return (-1);
+  }
+  fn[0] = '\0';
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, "event", 5) == 0) {
+      snprintf(fn, MAX_FN_LENGTH, "/dev/input/%s", entry->d_name);
+      break;
+    }
+  }
+  closedir(dir);
+  if (fn[0] == '\0') {
+    close(fd);
+    return (-1);
+  }
+  return (fd);
+}
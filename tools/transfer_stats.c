@@ -0,0 +1,318 @@
+/**
+ *  @brief
+ *      Transfer statistics for elf2bin and bin2elf (--stats).
+ *
+ *      The IN strobe is done here (in_clock), so the low and high times
+ *      of the strobe can be measured as they are on the pin: from the
+ *      return of the falling write to the return of the rising one
+ *      and back. The times go into a histogram with fixed buckets around
+ *      the nominal STROBE_US. The calls of the tools are measured with
+ *      stats_time/stats_add and summed up per phase (GPIO, sleep, file
+ *      I/O). The rest of the wall time is reported as other.
+ *
+ *  @file
+ *      transfer_stats.c
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef GPIO_SIM
+#include "gpio_sim.h"
+#else
+#include <wiringPi.h>
+#endif
+#include "raspi_gpio.h"
+#include "transfer_stats.h"
+
+// progress line update
+#define PROGRESS_STROBES    256
+#define PROGRESS_NS         200000000ULL
+
+// upper bucket limits in us, the last bucket is open
+static const uint32_t bucket_us[] = {
+  50, 90, 100, 110, 125, 150, 200, 300, 500, 1000, 2000, 5000, 10000
+};
+#define BUCKETS     (sizeof(bucket_us) / sizeof(bucket_us[0]) + 1)
+
+typedef struct {
+  uint32_t count[BUCKETS];
+  uint64_t sum_ns;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  uint32_t n;
+} histogram_t;
+
+static const char *phase_name[STATS_PHASES] = {"gpio", "sleep", "file"};
+
+static int enabled = FALSE;
+static int progress = FALSE;
+static uint32_t total_strobes;
+static uint32_t strobes;
+static uint64_t start_time;
+static uint64_t progress_time;
+static uint64_t rise_time;
+static uint64_t phase_ns[STATS_PHASES];
+static void in_pin(int level);
+static void (*in_line)(int level) = in_pin;
+static histogram_t low;
+static histogram_t high;
+
+
+static uint64_t nanoseconds(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void histogram_add(histogram_t *h, uint64_t ns) {
+  unsigned int i;
+
+  for (i = 0; i < BUCKETS - 1; i++) {
+    if (ns < bucket_us[i] * 1000ULL) {
+      break;
+    }
+  }
+  h->count[i]++;
+  h->sum_ns += ns;
+  if (h->n == 0 || ns < h->min_ns) {
+    h->min_ns = ns;
+  }
+  if (ns > h->max_ns) {
+    h->max_ns = ns;
+  }
+  h->n++;
+}
+
+static void print_progress(uint64_t now) {
+  double seconds = (now - start_time) / 1e9;
+  double rate = seconds > 0 ? strobes / seconds : 0;
+  int eta;
+
+  if (total_strobes != 0 && rate > 0) {
+    eta = (int) ((total_strobes - strobes) / rate + 0.5);
+    fprintf(stderr, "\r0x%04x/0x%04x %5.1f %%  %6.0f strobes/s  ETA %d:%02d ",
+	    strobes, total_strobes, 100.0 * strobes / total_strobes, rate,
+	    eta / 60, eta % 60);
+  } else {
+    fprintf(stderr, "\r0x%04x  %6.0f strobes/s ", strobes, rate);
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_init
+ */
+/**
+ *  @brief
+ *      Enables the statistics and starts the transfer clock
+ *  @param
+ *      total       expected number of IN strobes, 0 unknown (no ETA)
+ */
+/* ===================================================================*/
+void stats_init(uint32_t total) {
+  enabled = TRUE;
+  // the progress line only on a terminal (not in a log file)
+  progress = isatty(STDERR_FILENO);
+  total_strobes = total;
+  start_time = nanoseconds();
+  progress_time = start_time;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_time
+ */
+/**
+ *  @brief
+ *      Start time of a measured call
+ *  @return
+ *      uint64_t    monotonic time in ns, 0 if the statistics are off
+ */
+/* ===================================================================*/
+uint64_t stats_time(void) {
+  if (!enabled) {
+    return 0;
+  }
+  return nanoseconds();
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_add
+ */
+/**
+ *  @brief
+ *      Adds the time since start to a phase
+ *  @param
+ *      phase       STATS_GPIO, STATS_SLEEP or STATS_FILE
+ *  @param
+ *      start       time from stats_time
+ *  @return
+ *      uint64_t    current time, start of the next measured call
+ */
+/* ===================================================================*/
+uint64_t stats_add(stats_phase_t phase, uint64_t start) {
+  uint64_t now;
+
+  if (!enabled) {
+    return 0;
+  }
+  now = nanoseconds();
+  phase_ns[phase] += now - start;
+  return now;
+}
+
+static void in_pin(int level) {
+  digitalWrite(IN_N, level);
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_in_line
+ */
+/**
+ *  @brief
+ *      Sets the function which drives the IN line of in_clock (e.g.
+ *      farm_in for all boards of a farm), IN_N is default
+ *  @param
+ *      in          function which sets the IN line to the level
+ */
+/* ===================================================================*/
+void stats_in_line(void (*in)(int level)) {
+  in_line = in;
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  in_clock
+ */
+/**
+ *  @brief
+ *      IN strobe (low and high for STROBE_US), increments R0 of the Elf
+ *      in load mode. Measures the strobe and updates the progress line.
+ */
+/* ===================================================================*/
+void in_clock(void) {
+  uint64_t t;
+  uint64_t fall;
+
+  if (!enabled) {
+    in_line(0);
+    usleep(STROBE_US);
+    in_line(1);
+    usleep(STROBE_US);
+    return;
+  }
+
+  t = nanoseconds();
+  in_line(0);
+  fall = stats_add(STATS_GPIO, t);
+  if (rise_time != 0) {
+    // high since the last strobe, includes the work between the strobes
+    histogram_add(&high, fall - rise_time);
+  }
+  usleep(STROBE_US);
+  t = stats_add(STATS_SLEEP, fall);
+  in_line(1);
+  rise_time = stats_add(STATS_GPIO, t);
+  histogram_add(&low, rise_time - fall);
+  usleep(STROBE_US);
+  t = stats_add(STATS_SLEEP, rise_time);
+
+  strobes++;
+  if (progress && strobes % PROGRESS_STROBES == 0 &&
+      t - progress_time >= PROGRESS_NS) {
+    progress_time = t;
+    print_progress(t);
+  }
+}
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_print
+ */
+/**
+ *  @brief
+ *      Ends the progress line and prints the summary to stderr
+ *  @param
+ *      bytes       number of data bytes transferred
+ */
+/* ===================================================================*/
+void stats_print(uint32_t bytes) {
+  uint64_t total_ns;
+  uint64_t other_ns;
+  double seconds;
+  unsigned int i;
+
+  if (!enabled) {
+    return;
+  }
+  total_ns = nanoseconds() - start_time;
+  seconds = total_ns / 1e9;
+  if (progress) {
+    print_progress(start_time + total_ns);
+    fputc('\n', stderr);
+  }
+
+  fprintf(stderr, "%u bytes, %u strobes in %.3f s, %.0f bytes/s\n",
+	  bytes, strobes, seconds, seconds > 0 ? bytes / seconds : 0.0);
+  other_ns = total_ns;
+  for (i = 0; i < STATS_PHASES; i++) {
+    fprintf(stderr, "%-6s %9.3f s %5.1f %%\n", phase_name[i],
+	    phase_ns[i] / 1e9,
+	    total_ns ? 100.0 * phase_ns[i] / total_ns : 0.0);
+    other_ns = other_ns > phase_ns[i] ? other_ns - phase_ns[i] : 0;
+  }
+  fprintf(stderr, "%-6s %9.3f s %5.1f %%\n", "other", other_ns / 1e9,
+	  total_ns ? 100.0 * other_ns / total_ns : 0.0);
+  if (strobes != 0) {
+    // usleep overshoot against the nominal strobe
+    fprintf(stderr, "usleep %9.1f us per call (%d us nominal)\n",
+	    phase_ns[STATS_SLEEP] / 1e3 / (2.0 * strobes), STROBE_US);
+  }
+  if (low.n == 0) {
+    return;
+  }
+
+  fprintf(stderr, "IN strobe     low     high\n");
+  for (i = 0; i < BUCKETS; i++) {
+    if (i < BUCKETS - 1) {
+      fprintf(stderr, "< %5u us", bucket_us[i]);
+    } else {
+      fprintf(stderr, ">=%5u us", bucket_us[i - 1]);
+    }
+    fprintf(stderr, " %8u %8u\n", low.count[i], high.count[i]);
+  }
+  fprintf(stderr, "min    us %8.1f %8.1f\n", low.min_ns / 1e3,
+	  high.n ? high.min_ns / 1e3 : 0.0);
+  fprintf(stderr, "avg    us %8.1f %8.1f\n", low.sum_ns / 1e3 / low.n,
+	  high.n ? high.sum_ns / 1e3 / high.n : 0.0);
+  fprintf(stderr, "max    us %8.1f %8.1f\n", low.max_ns / 1e3,
+	  high.max_ns / 1e3);
+}
@@ -0,0 +1,135 @@
+/**
+ *  @brief
+ *      Transfer statistics for elf2bin and bin2elf (--stats).
+ *
+ *      Records the IN strobe low and high times in a histogram, the time
+ *      spent in GPIO calls, sleeps and file I/O and the throughput. During
+ *      the transfer a progress line with ETA is shown on stderr (terminal
+ *      only), at the end a summary is printed. Without --stats the calls
+ *      only test a flag.
+ *
+ *  @file
+ *      transfer_stats.h
+ *  @author
+ *      Peter Schmid, peter@spyr.ch
+ *  @date
+ *      2026-10-18
+ *  @remark
+ *      Language: gcc version 4.9.2 on Raspberry Pi 3, Raspbian
+ *  @copyright
+ *      Peter Schmid, Switzerland
+ *
+ *      This file is part of "RaspiElf" software.
+ *
+ *      "RaspiElf" software is free software: you can redistribute it
+ *      and/or modify it under the terms of the GNU General Public License as
+ *      published by the Free Software Foundation, either version 3 of the
+ *      License, or (at your option) any later version.
+ *
+ *      "RaspiElf" is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with "RaspiElf". If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSFER_STATS_H_
+#define TRANSFER_STATS_H_
+
+#include <stdint.h>
+
+// IN strobe phase length in us (low and high)
+#define STROBE_US   100
+
+typedef enum {
+  STATS_GPIO,
+  STATS_SLEEP,
+  STATS_FILE,
+  STATS_PHASES
+} stats_phase_t;
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_init
+ */
+/**
+ *  @brief
+ *      Enables the statistics and starts the transfer clock
+ *  @param
+ *      total       expected number of IN strobes, 0 unknown (no ETA)
+ */
+/* ===================================================================*/
+void stats_init(uint32_t total);
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_time
+ */
+/**
+ *  @brief
+ *      Start time of a measured call
+ *  @return
+ *      uint64_t    monotonic time in ns, 0 if the statistics are off
+ */
+/* ===================================================================*/
+uint64_t stats_time(void);
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_add
+ */
+/**
+ *  @brief
+ *      Adds the time since start to a phase
+ *  @param
+ *      phase       STATS_GPIO, STATS_SLEEP or STATS_FILE
+ *  @param
+ *      start       time from stats_time
+ *  @return
+ *      uint64_t    current time, start of the next measured call
+ */
+/* ===================================================================*/
+uint64_t stats_add(stats_phase_t phase, uint64_t start);
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_in_line
+ */
+/**
+ *  @brief
+ *      Sets the function which drives the IN line of in_clock (e.g.
+ *      farm_in for all boards of a farm), IN_N is default
+ *  @param
+ *      in          function which sets the IN line to the level
+ */
+/* ===================================================================*/
+void stats_in_line(void (*in)(int level));
+
+/*
+ ** ===================================================================
+ **  Method      :  in_clock
+ */
+/**
+ *  @brief
+ *      IN strobe (low and high for STROBE_US), increments R0 of the Elf
+ *      in load mode. Measures the strobe and updates the progress line.
+ */
+/* ===================================================================*/
+void in_clock(void);
+
+/*
+ ** ===================================================================
+ **  Method      :  stats_print
+ */
+/**
+ *  @brief
+ *      Ends the progress line and prints the summary to stderr
+ *  @param
+ *      bytes       number of data bytes transferred
+ */
+/* ===================================================================*/
+void stats_print(uint32_t bytes);
+
+#endif /* TRANSFER_STATS_H_ */